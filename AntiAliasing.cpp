@@ -0,0 +1,105 @@
+#include "AntiAliasing.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <stdexcept>
+
+namespace {
+    // Integer hash of a sample, the jitter has to be the same whenever a pixel is rendered again
+    uint32_t hash(uint32_t x, uint32_t y, uint32_t k) {
+        uint32_t h = x * 0x9e3779b1u ^ y * 0x85ebca77u ^ k * 0xc2b2ae3du;
+        h ^= h >> 16;
+        h *= 0x7feb352du;
+        h ^= h >> 15;
+        h *= 0x846ca68bu;
+        h ^= h >> 16;
+        return h;
+    }
+
+    float unit(uint32_t h) {
+        return static_cast<float>(h >> 8) * (1.0f / 16777216.0f);
+    }
+
+    int gridSize(const AntiAliasing& antiAliasing) {
+        return static_cast<int>(std::lround(std::sqrt(static_cast<double>(antiAliasing.samples))));
+    }
+} // namespace
+
+namespace AntiAliasings {
+
+void validate(const AntiAliasing& antiAliasing) {
+    const int n = gridSize(antiAliasing);
+    if (antiAliasing.samples < 1 || n * n != antiAliasing.samples)
+        throw std::invalid_argument("Samples per pixel must be a square number: " + std::to_string(antiAliasing.samples));
+    if (!(antiAliasing.threshold >= 0.0f))
+        throw std::invalid_argument("Anti-aliasing threshold must not be negative");
+}
+
+const char* patternName(SamplePattern pattern) {
+    return pattern == SamplePattern::Stratified ? "stratified" : "jittered";
+}
+
+SamplePattern parsePattern(const std::string& name) {
+    if (name == "stratified")
+        return SamplePattern::Stratified;
+    if (name == "jittered")
+        return SamplePattern::Jittered;
+    throw std::invalid_argument("Unknown sample pattern " + name);
+}
+
+Eigen::Vector2f samplePosition(const AntiAliasing& antiAliasing, const Eigen::Vector2i& pixel, int k) {
+    const int n = gridSize(antiAliasing);
+    Eigen::Vector2f inCell(0.5f, 0.5f);
+    if (antiAliasing.pattern == SamplePattern::Jittered) {
+        const uint32_t h = hash(static_cast<uint32_t>(pixel[0]), static_cast<uint32_t>(pixel[1]), static_cast<uint32_t>(k));
+        inCell = {unit(h), unit(hash(h, 0x68e31da4u, 0))};
+    }
+    // The kernel samples pixel x at x, so the pixel covers [x - 0.5, x + 0.5)
+    const Eigen::Vector2f cell(static_cast<float>(k % n), static_cast<float>(k / n));
+    return pixel.cast<float>() + (cell + inCell) / static_cast<float>(n) - Eigen::Vector2f(0.5f, 0.5f);
+}
+
+std::vector<int> firstSamples(const AntiAliasing& antiAliasing) {
+    const int n = gridSize(antiAliasing);
+    if (n < 4) {
+        std::vector<int> all(static_cast<size_t>(antiAliasing.samples));
+        for (int k = 0; k < antiAliasing.samples; ++k)
+            all[static_cast<size_t>(k)] = k;
+        return all;
+    }
+    return {0, n - 1, n * (n - 1), n * n - 1};
+}
+
+bool uniform(const AntiAliasing& antiAliasing, float center, const float* values, size_t count,
+             unsigned long maxIterations) {
+    const float limit = static_cast<float>(maxIterations);
+    const float threshold = antiAliasing.threshold * limit;
+    return std::all_of(values, values + count, [&](float value) {
+        return (value >= limit) == (center >= limit) && std::abs(value - center) <= threshold;
+    });
+}
+
+void detect(const AntiAliasing& antiAliasing, const float* values, const Eigen::Vector2i& size, size_t valuesPerRow,
+            unsigned long maxIterations, const Eigen::Vector2i& innerOrigin, const Eigen::Vector2i& innerSize,
+            std::vector<Eigen::Vector2i>& pixels) {
+    pixels.clear();
+    const float limit = static_cast<float>(maxIterations);
+    const float threshold = antiAliasing.threshold * limit;
+    auto differs = [&](float a, float b) {
+        return (a >= limit) != (b >= limit) || std::abs(a - b) > threshold;
+    };
+    for (int y = innerOrigin[1]; y < innerOrigin[1] + innerSize[1]; ++y) {
+        const float* row = values + y * valuesPerRow;
+        const float* above = y > 0 ? row - valuesPerRow : nullptr;
+        const float* below = y + 1 < size[1] ? row + valuesPerRow : nullptr;
+        for (int x = innerOrigin[0]; x < innerOrigin[0] + innerSize[0]; ++x) {
+            const float value = row[x];
+            if ((x > 0 && differs(value, row[x - 1])) || (x + 1 < size[0] && differs(value, row[x + 1])) ||
+                (above != nullptr && differs(value, above[x])) || (below != nullptr && differs(value, below[x])))
+                pixels.emplace_back(x, y);
+        }
+    }
+}
+
+} // namespace AntiAliasings
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+
+// Where the samples of a supersampled pixel go: the centers of a regular n x n grid of
+// cells, or a random point in each cell, which trades the grid's moire for noise
+enum class SamplePattern {
+    Stratified,
+    Jittered
+};
+
+// Adaptive supersampling: every pixel is computed once, only the ones whose neighbours differ
+// by more than `threshold` of the iteration limit get `samples` samples and the mean of their colors.
+// Grids of 4x4 and more start with the corner samples, the rest is computed only if they differ.
+struct AntiAliasing {
+    int samples = 1; // per supersampled pixel, a square number; 1 turns it off
+    SamplePattern pattern = SamplePattern::Jittered;
+    float threshold = 1.0f / 256.0f;
+
+    bool enabled() const { return samples > 1; }
+    bool operator==(const AntiAliasing&) const = default;
+};
+
+namespace AntiAliasings {
+
+// Throws unless samples is a square number
+void validate(const AntiAliasing& antiAliasing);
+const char* patternName(SamplePattern pattern);
+SamplePattern parsePattern(const std::string& name);
+// Position of sample k of image pixel `pixel`, in pixels. Jitter depends on the pixel only,
+// so bands and tiles of one image get the same samples.
+Eigen::Vector2f samplePosition(const AntiAliasing& antiAliasing, const Eigen::Vector2i& pixel, int k);
+// Indices of the samples computed first, all of them for grids below 4x4
+std::vector<int> firstSamples(const AntiAliasing& antiAliasing);
+// Values within the threshold of `center`, the pixel needs no more samples
+bool uniform(const AntiAliasing& antiAliasing, float center, const float* values, size_t count,
+             unsigned long maxIterations);
+// Pixels of the inner rectangle, given in coordinates of `values`, which differ from one of their
+// 4 neighbours inside `values` by more than the threshold, or are interior next to escaped ones
+void detect(const AntiAliasing& antiAliasing, const float* values, const Eigen::Vector2i& size, size_t valuesPerRow,
+            unsigned long maxIterations, const Eigen::Vector2i& innerOrigin, const Eigen::Vector2i& innerSize,
+            std::vector<Eigen::Vector2i>& pixels);
+
+} // namespace AntiAliasings
@@ -0,0 +1,56 @@
+#include "AutoIterations.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+
+IterationHistogram::IterationHistogram(const float* values, size_t count, unsigned long maxIterations) {
+    const float limit = static_cast<float>(maxIterations);
+    for (size_t i = 0; i < count; ++i) {
+        if (values[i] >= limit) {
+            ++capped_;
+            continue;
+        }
+        const auto iterations = static_cast<uint64_t>(std::max(values[i], 0.0f));
+        ++octaves_[std::bit_width(iterations)];
+    }
+    escaped_ = count - capped_;
+}
+
+size_t IterationHistogram::escaped() const {
+    return escaped_;
+}
+
+size_t IterationHistogram::capped() const {
+    return capped_;
+}
+
+double IterationHistogram::tail(unsigned long limit) const {
+    if (escaped_ == 0)
+        return 0.0;
+    // Half of 2^m starts octave m
+    size_t count = 0;
+    for (size_t k = std::bit_width(limit) - 1; k < octaves_.size(); ++k)
+        count += octaves_[k];
+    return static_cast<double>(count) / static_cast<double>(escaped_);
+}
+
+namespace AutoIterations {
+
+unsigned long quantize(unsigned long limit) {
+    return std::clamp(std::bit_ceil(limit), minimum, maximum);
+}
+
+bool shouldRaise(const IterationHistogram& histogram, unsigned long limit) {
+    return limit < maximum && histogram.capped() > 0 && histogram.escaped() > 0 && histogram.tail(limit) > raiseTail;
+}
+
+unsigned long lowest(const IterationHistogram& histogram, unsigned long limit) {
+    for (unsigned long candidate = minimum; candidate < limit; candidate *= 2) {
+        if (histogram.tail(candidate) <= lowerTail)
+            return candidate;
+    }
+    return limit;
+}
+
+} // namespace AutoIterations
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+// Escape times of a render in octaves: octave k counts the pixels which escaped
+// after [2^(k-1), 2^k) iterations, octave 0 the ones below a single iteration
+class IterationHistogram final {
+public:
+    IterationHistogram(const float* values, size_t count, unsigned long maxIterations);
+
+    size_t escaped() const;
+    // Pixels which reached the limit
+    size_t capped() const;
+    // Share of the escaped pixels which needed at least half of `limit`, a power of two
+    double tail(unsigned long limit) const;
+private:
+    std::array<size_t, 65> octaves_{};
+    size_t escaped_ = 0;
+    size_t capped_ = 0;
+};
+
+// Iteration limit picked from the escape times instead of a fixed number. Limits are powers of two,
+// so nearby views share them and keep reusing each other's iterations.
+namespace AutoIterations {
+
+constexpr unsigned long minimum = 64;
+constexpr unsigned long maximum = 1ul << 22;
+// More escaped pixels than this in the upper half of the range mean the capped ones are mostly
+// boundary which needs a higher limit. Fewer than lowerTail in the upper half of a lower limit
+// mean the current one is wasted on the interior.
+constexpr double raiseTail = 0.005;
+constexpr double lowerTail = 0.001;
+// Doublings tried when nothing escaped at all, the view may be deep inside the set or the limit far too low
+constexpr int blankRaises = 4;
+
+// Power of two not below `limit`, within minimum and maximum
+unsigned long quantize(unsigned long limit);
+// Escape times crowd the limit while some pixels are capped
+bool shouldRaise(const IterationHistogram& histogram, unsigned long limit);
+// Smallest limit up to `limit` which still keeps the escape times clear of it
+unsigned long lowest(const IterationHistogram& histogram, unsigned long limit);
+
+} // namespace AutoIterations
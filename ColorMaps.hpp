@@ -0,0 +1,97 @@
+#pragma once
+
+// Color maps of normalized iteration values, ported from the original metal kernel.
+// They are sampled into lookup tables by Palette, so they don't have to be fast.
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <Eigen/Dense>
+
+namespace ColorMaps {
+
+inline Eigen::Vector4f coldColorMap(float value)
+{
+    return {std::min(3.0f * value, 1.0f),
+            std::min(3.0f * value - 1.0f, 1.0f),
+            std::min(3.0f * value - 2.0f, 1.0f),
+            1.0f};
+}
+
+inline Eigen::Vector4f hotColorMap(float value)
+{
+    return {std::min(3.0f * value - 2.0f, 1.0f),
+            std::min(3.0f * value - 1.0f, 1.0f),
+            std::min(3.0f * value, 1.0f),
+            1.0f};
+}
+
+inline Eigen::Vector4f greenColorMap(float value)
+{
+    return {std::min(3.0f * value - 1.0f, 1.0f),
+            std::min(3.0f * value, 1.0f),
+            std::min(3.0f * value - 2.0f, 1.0f),
+            1.0f};
+}
+
+inline Eigen::Vector4f simpleColorMap(float value)
+{
+    return {value, value, value, 1.0f};
+}
+
+inline Eigen::Vector3f hsvToRgb(const Eigen::Vector3f& hsv)
+{
+    float h60 = hsv.x() / 60.0f;
+    int hmod6 = static_cast<int>(h60) % 6;
+    float f = h60 - std::floor(h60);
+    Eigen::Vector3f pqt(hsv.z() * (1 - hsv.y()),
+                        hsv.z() * (1 - f * hsv.y()),
+                        hsv.z() * (1 - (1 - f) * hsv.y()));
+    Eigen::Vector3f rgb(0.0f, 0.0f, 0.0f);
+    if (hmod6 == 0)
+        rgb = {hsv.z(), pqt.z(), pqt.x()}; // V T P
+    else if (hmod6 == 1)
+        rgb = {pqt.y(), hsv.z(), pqt.x()}; // Q V P
+    else if (hmod6 == 2)
+        rgb = {pqt.x(), hsv.z(), pqt.z()}; // P V T
+    else if (hmod6 == 3)
+        rgb = {pqt.x(), pqt.y(), hsv.z()}; // P Q V
+    else if (hmod6 == 4)
+        rgb = {pqt.z(), pqt.x(), hsv.z()}; // T P V
+    else if (hmod6 == 5)
+        rgb = {hsv.z(), pqt.x(), pqt.y()}; // V P Q
+    return rgb;
+}
+
+inline Eigen::Vector4f rainbowColorMap(float value)
+{
+    float hue = value * 360.0f;
+    Eigen::Vector3f rgb = hsvToRgb({hue, 1.0f, 1.0f});
+    return {rgb.x(), rgb.y(), rgb.z(), 1.0f};
+}
+
+inline Eigen::Vector4f cubicInterpolation(float value, const Eigen::Vector4f& c1, const Eigen::Vector4f& c2)
+{
+    float coef = 1.0f - std::pow(1.0f - value, 3.0f);
+    return c1 + (c2 - c1) * coef;
+}
+
+// The metal version left alpha at 0, here the colors are opaque so the map is usable for images
+inline Eigen::Vector4f cubicInterpolatedColorMap(float value)
+{
+    const Eigen::Vector4f red(1.0f, 0.0f, 0.0f, 1.0f);
+    const Eigen::Vector4f green(0.0f, 1.0f, 0.0f, 1.0f);
+    const Eigen::Vector4f blue(0.0f, 0.0f, 1.0f, 1.0f);
+    if (value < 0.5f)
+        return cubicInterpolation(2.0f * value, red, green);
+    return cubicInterpolation(2.0f * (value - 0.5f), green, blue);
+}
+
+// Same conversion as `uint4(clamp(pixel, 0.0, 1.0) * 255.0)` of the original kernel
+inline void writePixel(const Eigen::Vector4f& pixel, uint8_t* dst)
+{
+    for (int i = 0; i < 4; ++i)
+        dst[i] = static_cast<uint8_t>(std::clamp(pixel[i], 0.0f, 1.0f) * 255.0f);
+}
+
+} // namespace ColorMaps
@@ -0,0 +1,200 @@
+#include "CompressedIterations.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <istream>
+#include <ostream>
+#include <stdexcept>
+
+namespace {
+    constexpr int interiorCode = 0xFFFF;
+    // Escaped counts stay below the limit after decoding
+    constexpr float maxEscapedCode = 65534.0f;
+    constexpr float codeSteps = 65535.0f;
+    // Pixels of a block: one byte of bit width, then the block's zigzag coded differences packed at that width
+    constexpr int blockSize = 32;
+    // Differences of 16-bit codes take up to 17 bits
+    constexpr int maxBits = 17;
+    // Differences are read 8 bytes at a time, the last ones of the codes too
+    constexpr size_t padding = 8;
+
+    uint32_t zigzag(int value) {
+        return (static_cast<uint32_t>(value) << 1) ^ static_cast<uint32_t>(value >> 31);
+    }
+
+    int unzigzag(uint32_t value) {
+        return static_cast<int>(value >> 1) ^ -static_cast<int>(value & 1);
+    }
+
+    size_t blockBytes(int pixels, int bits) {
+        return (static_cast<size_t>(pixels) * bits + 7) / 8;
+    }
+
+    // Writes at most 1 + blockBytes(blockSize, maxBits) bytes per block to `out`, returns the end of the codes
+    uint8_t* encodeRow(const uint16_t* codes, int width, uint8_t* out) {
+        int previous = 0;
+        uint32_t differences[blockSize];
+        for (int x0 = 0; x0 < width; x0 += blockSize) {
+            const int pixels = std::min(blockSize, width - x0);
+            uint32_t all = 0;
+            for (int i = 0; i < pixels; ++i) {
+                differences[i] = zigzag(codes[x0 + i] - previous);
+                previous = codes[x0 + i];
+                all |= differences[i];
+            }
+            const int bits = all == 0 ? 0 : 32 - __builtin_clz(all);
+            *out++ = static_cast<uint8_t>(bits);
+            uint64_t pending = 0;
+            int pendingBits = 0;
+            for (int i = 0; i < pixels; ++i) {
+                pending |= static_cast<uint64_t>(differences[i]) << pendingBits;
+                pendingBits += bits;
+                for (; pendingBits >= 8; pendingBits -= 8, pending >>= 8)
+                    *out++ = static_cast<uint8_t>(pending);
+            }
+            if (pendingBits > 0)
+                *out++ = static_cast<uint8_t>(pending);
+        }
+        return out;
+    }
+
+    template<typename T>
+    void writeValue(std::ostream& out, const T& value) {
+        out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    template<typename T>
+    bool readValue(std::istream& in, T& value) {
+        return static_cast<bool>(in.read(reinterpret_cast<char*>(&value), sizeof(value)));
+    }
+} // namespace
+
+CompressedIterations::CompressedIterations(const float* values, const Eigen::Vector2i& size, size_t valuesPerRow,
+                                           unsigned long maxIterations)
+    : size_(size), maxIterations_(maxIterations) {
+    if ((size.array() < 0).any() || maxIterations == 0)
+        throw std::invalid_argument("Compressed iterations need a size and an iteration limit");
+    const float limit = static_cast<float>(maxIterations);
+    const float scale = codeSteps / limit;
+    std::vector<uint16_t> codes(size[0]);
+    const size_t worstRow = static_cast<size_t>((size[0] + blockSize - 1) / blockSize) *
+                            (1 + blockBytes(blockSize, maxBits));
+    // Room for the worst row, trimmed at the end
+    std::vector<uint8_t> data(worstRow);
+    size_t used = 0;
+    rowOffsets_.resize(static_cast<size_t>(size[1]) + 1);
+    for (int y = 0; y < size[1]; ++y) {
+        rowOffsets_[y] = static_cast<uint32_t>(used);
+        const float* row = values + y * valuesPerRow;
+        for (int x = 0; x < size[0]; ++x) {
+            codes[x] = row[x] >= limit
+                ? interiorCode
+                : static_cast<uint16_t>(std::clamp(row[x] * scale + 0.5f, 0.0f, maxEscapedCode));
+        }
+        if (data.size() < used + worstRow)
+            data.resize(std::max(data.size() * 2, used + worstRow));
+        used = static_cast<size_t>(encodeRow(codes.data(), size[0], data.data() + used) - data.data());
+        // Rows are found by 32-bit offsets, noisy images take up to 2.2 bytes per pixel
+        if (used > UINT32_MAX)
+            throw std::length_error("Iterations are too large to compress");
+    }
+    rowOffsets_[size[1]] = static_cast<uint32_t>(used);
+    data_.assign(data.begin(), data.begin() + used);
+    data_.resize(used + padding, 0);
+}
+
+Eigen::Vector2i CompressedIterations::size() const {
+    return size_;
+}
+
+unsigned long CompressedIterations::maxIterations() const {
+    return maxIterations_;
+}
+
+size_t CompressedIterations::bytes() const {
+    return data_.size() + rowOffsets_.size() * sizeof(uint32_t);
+}
+
+void CompressedIterations::decodeRows(int y, int rows, float* dst, size_t valuesPerRow) const {
+    if (y < 0 || rows < 0 || y + rows > size_[1])
+        throw std::out_of_range("Rows are out of the compressed iterations");
+    const float limit = static_cast<float>(maxIterations_);
+    const float step = limit / codeSteps;
+    auto value = [limit, step](int code) { return code == interiorCode ? limit : static_cast<float>(code) * step; };
+    const int width = size_[0];
+    for (int row = 0; row < rows; ++row) {
+        const uint8_t* in = data_.data() + rowOffsets_[y + row];
+        float* out = dst + row * valuesPerRow;
+        int previous = 0;
+        for (int x0 = 0; x0 < width; x0 += blockSize) {
+            const int pixels = std::min(blockSize, width - x0);
+            const int bits = *in++;
+            if (bits == 0) {
+                // Runs of one count, the interior above all, are plain fills
+                std::fill_n(out + x0, pixels, value(previous));
+                continue;
+            }
+            const uint64_t mask = (uint64_t(1) << bits) - 1;
+            for (int i = 0; i < pixels; ++i) {
+                const size_t bit = static_cast<size_t>(i) * bits;
+                uint64_t word;
+                std::memcpy(&word, in + bit / 8, sizeof(word));
+                previous += unzigzag(static_cast<uint32_t>((word >> (bit % 8)) & mask));
+                out[x0 + i] = value(previous);
+            }
+            in += blockBytes(pixels, bits);
+        }
+    }
+}
+
+void CompressedIterations::write(std::ostream& out) const {
+    const int32_t width = size_[0];
+    const int32_t height = size_[1];
+    const uint64_t maxIterations = maxIterations_;
+    const uint64_t bytes = data_.size();
+    writeValue(out, width);
+    writeValue(out, height);
+    writeValue(out, maxIterations);
+    writeValue(out, bytes);
+    out.write(reinterpret_cast<const char*>(rowOffsets_.data()),
+              static_cast<std::streamsize>(rowOffsets_.size() * sizeof(uint32_t)));
+    out.write(reinterpret_cast<const char*>(data_.data()), static_cast<std::streamsize>(data_.size()));
+}
+
+bool CompressedIterations::read(std::istream& in) {
+    int32_t width;
+    int32_t height;
+    uint64_t maxIterations;
+    uint64_t bytes;
+    if (!readValue(in, width) || !readValue(in, height) || !readValue(in, maxIterations) || !readValue(in, bytes) ||
+        width < 0 || height < 0 || maxIterations == 0 || bytes < padding || bytes > (uint64_t(1) << 32))
+        return false;
+    std::vector<uint32_t> offsets(static_cast<size_t>(height) + 1);
+    std::vector<uint8_t> data(bytes);
+    if (!in.read(reinterpret_cast<char*>(offsets.data()), static_cast<std::streamsize>(offsets.size() * sizeof(uint32_t))) ||
+        !in.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(data.size())))
+        return false;
+    // Every block of a row must lie within the row, so decoding never leaves the codes
+    if (offsets.front() != 0 || uint64_t(offsets.back()) + padding != bytes)
+        return false;
+    for (int32_t y = 0; y < height; ++y) {
+        if (offsets[y + 1] < offsets[y])
+            return false;
+        size_t offset = offsets[y];
+        for (int x0 = 0; x0 < width; x0 += blockSize) {
+            if (offset >= offsets[y + 1])
+                return false;
+            const int bits = data[offset];
+            if (bits > maxBits)
+                return false;
+            offset += 1 + blockBytes(std::min(blockSize, width - x0), bits);
+        }
+        if (offset != offsets[y + 1])
+            return false;
+    }
+    size_ = {width, height};
+    maxIterations_ = static_cast<unsigned long>(maxIterations);
+    rowOffsets_ = std::move(offsets);
+    data_ = std::move(data);
+    return true;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <vector>
+#include <Eigen/Dense>
+
+// Smooth iteration counts at 4-8x less memory than floats, for caches holding many views.
+// Counts are quantized to 16 bits of the iteration limit: 65535 is the interior, escaped counts are
+// multiples of maxIterations / 65535 (16 steps per palette color), so colors stay the same up to a rounding
+// of one palette entry on a few pixels. Every row is then coded on its own as differences from the pixel to
+// the left, bit-packed in blocks of 32 at the width of the block's largest one. Blocks without changes
+// (the interior, flat areas) take one byte, and any rows decode without the ones above them.
+class CompressedIterations final {
+public:
+    CompressedIterations() = default;
+    CompressedIterations(const float* values, const Eigen::Vector2i& size, size_t valuesPerRow,
+                         unsigned long maxIterations);
+
+    Eigen::Vector2i size() const;
+    unsigned long maxIterations() const;
+    // Memory taken by the codes and the row index
+    size_t bytes() const;
+    // Full width rows [y, y + rows)
+    void decodeRows(int y, int rows, float* dst, size_t valuesPerRow) const;
+
+    void write(std::ostream& out) const;
+    // False if the stream doesn't hold a valid encoding
+    bool read(std::istream& in);
+private:
+    Eigen::Vector2i size_{0, 0};
+    unsigned long maxIterations_ = 0;
+    std::vector<uint32_t> rowOffsets_; // size[1] + 1 offsets of the rows in data_
+    std::vector<uint8_t> data_;
+};
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "DoubleDouble.hpp"
+#include "Formula.hpp"
+#include "Precision.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <stop_token>
+#include <vector>
+#include <Eigen/Dense>
+
+// Bumped whenever the backends change the iteration values they produce, it's a part of cache keys
+constexpr int iterationsVersion = 1;
+
+// How the backend covers a region: every pixel, or only the borders of rectangles, filling the
+// ones with a uniform border (Mariani-Silver). Backends which can't trace compute every pixel.
+enum class RenderStrategy {
+    PerPixel,
+    BoundaryTrace
+};
+
+struct RenderParams {
+    Eigen::Vector2i size;
+    Eigen::Vector2f center;
+    float scale;
+    unsigned long maxIterations;
+    // Full precision view, center and scale above are rounded from it
+    PrecisePoint preciseCenter;
+    double preciseScale;
+    // Perturbation around a reference orbit, the double-double tier of z^2 + c
+    bool deepZoom;
+    // Number type of the escape loop otherwise, never Precision::Auto
+    Precision precision;
+    // Interior shortcuts: analytic main cardioid/period-2 bulb test and orbit cycle detection
+    bool bulbCheck;
+    bool periodicityCheck;
+    Formula formula;
+    RenderStrategy strategy;
+    // The render is no longer needed, backends may return early leaving dst partially written
+    std::stop_token stop;
+};
+
+// Pixels of the last render which were resolved by the interior shortcuts or filled by the boundary tracer
+struct ShortcutStats {
+    size_t pixels = 0;
+    size_t bulbs = 0;
+    size_t periodic = 0;
+    size_t filled = 0;
+};
+
+// Where the time of the last render went: setup and submission (for the CPU the deep zoom reference
+// orbit), the work itself and copying the results back to the caller
+struct RenderTimings {
+    double dispatchMs = 0.0;
+    double computeMs = 0.0;
+    double readbackMs = 0.0;
+    // Busy time of every CPU worker during compute, empty for GPU backends
+    std::vector<double> workerBusyMs;
+};
+
+// Rectangle of the image in pixels of RenderParams::size.
+// `size` counts samples, they are the pixels origin + i * step; step > 1 renders a coarse preview.
+struct RenderRegion {
+    Eigen::Vector2i origin;
+    Eigen::Vector2i size;
+    int step = 1;
+};
+
+// Interface of the device which actually evaluates the mandelbrot kernel.
+// Every backend produces the same RGBA8 layout: 4 bytes per pixel, rows top to bottom.
+class ComputeBackend {
+public:
+    virtual ~ComputeBackend() = default;
+
+    virtual const char* name() const = 0;
+    // Backends which can't handle some mode (e.g. deep zoom) are replaced by the CPU backend for that frame
+    virtual bool supports(const RenderParams&) const { return true; }
+    // Smooth iteration counts of the region, maxIterations for points which never escaped.
+    // The first row of dst receives the first row of the region, coloring is up to the caller.
+    virtual void render(const RenderParams& params, const RenderRegion& region,
+                        float* dst, size_t valuesPerRow) = 0;
+    virtual const ShortcutStats& shortcutStats() const = 0;
+    virtual const RenderTimings& timings() const = 0;
+};
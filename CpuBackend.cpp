@@ -0,0 +1,450 @@
+#include "CpuBackend.hpp"
+#include "Log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+namespace {
+    // Rectangle of tile samples, both borders included
+    struct TraceRect {
+        int x0, y0, x1, y1;
+    };
+
+    // Per thread scratch rows, reused between tiles so rendering doesn't allocate
+    struct TileScratch {
+        std::vector<float> cx;
+        std::vector<float> cy;
+        // Boundary tracer: samples waiting for evaluation and their values, rectangles of the current
+        // level, of the next one and the ones whose interior probes are evaluated
+        std::vector<Eigen::Vector2i> queue;
+        std::vector<Eigen::Vector2f> pixels;
+        std::vector<float> values;
+        std::vector<TraceRect> rects;
+        std::vector<TraceRect> next;
+        std::vector<TraceRect> candidates;
+
+        void resize(size_t count) {
+            if (cx.size() < count) {
+                cx.resize(count);
+                cy.resize(count);
+            }
+        }
+    };
+
+    thread_local TileScratch scratch;
+
+    // Coordinates of the double and double-double loops
+    template<typename T>
+    struct PreciseScratch {
+        std::vector<T> cx;
+        std::vector<T> cy;
+    };
+
+    template<typename T>
+    thread_local PreciseScratch<T> preciseScratch;
+
+    // `pixel(i)` gives the image position of point i. Its offset from the center is well inside of
+    // the double range at any depth, only the sum with the center needs the precision of the loop.
+    template<typename T, typename Pixel>
+    EscapeCounts escapePrecise(EscapeFunc<T> escape, const RenderParams& params, size_t count, Pixel&& pixel,
+                               float* values) {
+        PreciseScratch<T>& precise = preciseScratch<T>;
+        if (precise.cx.size() < count) {
+            precise.cx.resize(count);
+            precise.cy.resize(count);
+        }
+        T centerX, centerY;
+        if constexpr (std::is_same_v<T, double>) {
+            centerX = static_cast<double>(params.preciseCenter.x);
+            centerY = static_cast<double>(params.preciseCenter.y);
+        } else {
+            centerX = params.preciseCenter.x;
+            centerY = params.preciseCenter.y;
+        }
+        const double width = params.size[0];
+        const double height = params.size[1];
+        for (size_t i = 0; i < count; ++i) {
+            const Eigen::Vector2d position = pixel(i);
+            precise.cx[i] = centerX + T(params.preciseScale * (position[0] - width / 2.0) / width);
+            precise.cy[i] = centerY + T(params.preciseScale * (position[1] - height / 2.0) / height);
+        }
+        const EscapeOptions options{params.bulbCheck, params.periodicityCheck, params.formula.juliaX, params.formula.juliaY};
+        return escape(precise.cx.data(), precise.cy.data(), count, params.maxIterations, options, values);
+    }
+
+    template<typename Pixel>
+    EscapeCounts escapeInPrecision(const EscapeKernel& kernel, const RenderParams& params, size_t count, Pixel&& pixel,
+                                   float* values) {
+        if (params.precision == Precision::Double)
+            return escapePrecise<double>(kernel.selectDouble(params.formula), params, count, pixel, values);
+        return escapePrecise<DoubleDouble>(EscapeKernels::doubleDouble(params.formula), params, count, pixel, values);
+    }
+
+    // Rectangles narrower than this are computed in full, tracing them saves next to nothing
+    constexpr int traceMinSize = 8;
+    // A uniform border is trusted only if a 3x3 grid of interior samples agrees with it, which catches
+    // most filaments passing between the border samples. Escaped pixels with no escaped neighbour,
+    // e.g. at the pinch points between bulbs, can still be filled as interior: at pixel resolution
+    // they don't touch the border and no sparser probing than computing every pixel finds them.
+    constexpr int traceProbes = 3;
+
+    // Samples of one band share the whole escape count, -1 stands for the interior
+    long band(float value, float limit) {
+        return value >= limit ? -1 : static_cast<long>(value);
+    }
+} // namespace
+
+CpuBackend::CpuBackend(unsigned threadCount)
+    : pool_(threadCount), scheduler_(pool_), kernel_(&EscapeKernels::best()) {
+    Log::info("CPU backend uses {} threads, {} kernel",
+              pool_.size(), kernel_->name);
+}
+
+const char* CpuBackend::name() const {
+    return "cpu";
+}
+
+unsigned CpuBackend::threadCount() const {
+    return pool_.size();
+}
+
+const EscapeKernel& CpuBackend::kernel() const {
+    return *kernel_;
+}
+
+void CpuBackend::setKernel(const EscapeKernel& kernel) {
+    kernel_ = &kernel;
+}
+
+int CpuBackend::tileSize() const {
+    return scheduler_.tileSize();
+}
+
+void CpuBackend::setTileSize(int tileSize) {
+    scheduler_.setTileSize(tileSize);
+}
+
+const SchedulerStats& CpuBackend::schedulerStats() const {
+    return scheduler_.lastStats();
+}
+
+const DeepZoomStats& CpuBackend::deepZoomStats() const {
+    return deepZoomStats_;
+}
+
+const ShortcutStats& CpuBackend::shortcutStats() const {
+    return shortcutStats_;
+}
+
+const RenderTimings& CpuBackend::timings() const {
+    return timings_;
+}
+
+void CpuBackend::render(const RenderParams& params, const RenderRegion& region,
+                        float* dst, size_t valuesPerRow) {
+    const auto start = std::chrono::steady_clock::now();
+    if (params.deepZoom)
+        orbit_.update(params.preciseCenter, params.maxIterations);
+    timings_.dispatchMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    std::mutex countersMutex;
+    TileCounters total;
+    scheduler_.run(region.size, [&](const Eigen::Vector2i& origin, const Eigen::Vector2i& size) {
+        if (params.stop.stop_requested())
+            return;
+        float* tileDst = dst + origin[1] * valuesPerRow + origin[0];
+        TileCounters counters;
+        if (params.strategy == RenderStrategy::BoundaryTrace)
+            traceTile(params, region.origin + origin * region.step, region.step, size, tileDst, valuesPerRow, counters);
+        else
+            renderTile(params, region.origin + origin * region.step, region.step, size, tileDst, valuesPerRow, counters);
+
+        std::lock_guard lock(countersMutex);
+        total.bulbs += counters.bulbs;
+        total.periodic += counters.periodic;
+        total.rebases += counters.rebases;
+        total.filled += counters.filled;
+    });
+
+    shortcutStats_ = {static_cast<size_t>(region.size[0]) * region.size[1], total.bulbs, total.periodic, total.filled};
+    if (params.deepZoom)
+        deepZoomStats_ = {orbit_.points().size(), total.rebases};
+    // Tiles are written straight into dst, there is nothing to read back
+    const SchedulerStats& stats = scheduler_.lastStats();
+    timings_.computeMs = stats.wallMs;
+    timings_.readbackMs = 0.0;
+    timings_.workerBusyMs = stats.workerBusyMs;
+}
+
+void CpuBackend::renderPoints(const RenderParams& params, const Eigen::Vector2f* pixels, size_t count, float* dst) {
+    const auto start = std::chrono::steady_clock::now();
+    if (params.deepZoom)
+        orbit_.update(params.preciseCenter, params.maxIterations);
+    const auto computeStart = std::chrono::steady_clock::now();
+    timings_.dispatchMs = std::chrono::duration<double, std::milli>(computeStart - start).count();
+
+    // Chunks are long enough to fill the lanes of the kernel many times over
+    constexpr size_t chunkSize = 1024;
+    std::mutex countersMutex;
+    TileCounters total;
+    pool_.parallelFor((count + chunkSize - 1) / chunkSize, [&](size_t chunk) {
+        if (params.stop.stop_requested())
+            return;
+        const size_t first = chunk * chunkSize;
+        TileCounters counters;
+        computePoints(params, pixels + first, std::min(chunkSize, count - first), dst + first, counters);
+
+        std::lock_guard lock(countersMutex);
+        total.bulbs += counters.bulbs;
+        total.periodic += counters.periodic;
+        total.rebases += counters.rebases;
+    });
+
+    shortcutStats_ = {count, total.bulbs, total.periodic, 0};
+    if (params.deepZoom)
+        deepZoomStats_ = {orbit_.points().size(), total.rebases};
+    timings_.computeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - computeStart).count();
+    timings_.readbackMs = 0.0;
+    timings_.workerBusyMs.clear();
+}
+
+// origin is in image pixels, size in samples `step` pixels apart, dst points to the first sample of the tile
+void CpuBackend::renderTile(const RenderParams& params, const Eigen::Vector2i& origin, int step,
+                            const Eigen::Vector2i& size, float* dst, size_t valuesPerRow,
+                            TileCounters& counters) const {
+    scratch.resize(size[0]);
+    for (int j = 0; j < size[1]; ++j)
+        computeRow(params, {origin[0], origin[1] + j * step}, step, size[0], dst + j * valuesPerRow, counters);
+}
+
+// Mariani-Silver subdivision of the tile: the escape count is continuous in c and the set is connected,
+// so a rectangle whose whole border is in one band holds nothing else as long as no filament slips
+// between the samples. Such rectangles are filled, the others are split in four by their middle lines.
+// Rectangles are processed level by level and the samples of a level are evaluated in one batch,
+// short borders alone would leave most lanes of the escape kernel idle.
+void CpuBackend::traceTile(const RenderParams& params, const Eigen::Vector2i& origin, int step,
+                           const Eigen::Vector2i& size, float* dst, size_t valuesPerRow,
+                           TileCounters& counters) const {
+    if (size[0] <= traceMinSize || size[1] <= traceMinSize) {
+        renderTile(params, origin, step, size, dst, valuesPerRow, counters);
+        return;
+    }
+
+    auto at = [&](int x, int y) -> float& { return dst[y * valuesPerRow + x]; };
+    std::vector<Eigen::Vector2i>& queue = scratch.queue;
+    auto row = [&](int y, int x0, int x1) {
+        for (int x = x0; x <= x1; ++x)
+            queue.emplace_back(x, y);
+    };
+    auto column = [&](int x, int y0, int y1) {
+        for (int y = y0; y <= y1; ++y)
+            queue.emplace_back(x, y);
+    };
+    auto flush = [&]() {
+        if (queue.empty())
+            return;
+        scratch.pixels.resize(queue.size());
+        scratch.values.resize(queue.size());
+        for (size_t i = 0; i < queue.size(); ++i)
+            scratch.pixels[i] = (origin + queue[i] * step).cast<float>();
+        computePoints(params, scratch.pixels.data(), queue.size(), scratch.values.data(), counters);
+        for (size_t i = 0; i < queue.size(); ++i)
+            at(queue[i][0], queue[i][1]) = scratch.values[i];
+        queue.clear();
+    };
+
+    const float limit = static_cast<float>(params.maxIterations);
+    auto uniformBorder = [&](const TraceRect& r) {
+        const long first = band(at(r.x0, r.y0), limit);
+        for (int x = r.x0; x <= r.x1; ++x) {
+            if (band(at(x, r.y0), limit) != first || band(at(x, r.y1), limit) != first)
+                return false;
+        }
+        for (int y = r.y0 + 1; y < r.y1; ++y) {
+            if (band(at(r.x0, y), limit) != first || band(at(r.x1, y), limit) != first)
+                return false;
+        }
+        return true;
+    };
+    // Probes are written into the interior, a fill or the next level overwrites them
+    auto probe = [&](const TraceRect& r, auto&& visit) {
+        for (int j = 1; j <= traceProbes; ++j) {
+            for (int i = 1; i <= traceProbes; ++i)
+                visit(r.x0 + (r.x1 - r.x0) * i / (traceProbes + 1), r.y0 + (r.y1 - r.y0) * j / (traceProbes + 1));
+        }
+    };
+    auto uniformProbes = [&](const TraceRect& r) {
+        const long first = band(at(r.x0, r.y0), limit);
+        bool uniform = true;
+        probe(r, [&](int x, int y) { uniform = uniform && band(at(x, y), limit) == first; });
+        return uniform;
+    };
+    // Interior samples get the mean of the linear interpolations between opposite borders, a convex
+    // combination of border values which keeps them in the band and the smooth coloring continuous
+    auto fill = [&](const TraceRect& r) {
+        const float width = static_cast<float>(r.x1 - r.x0);
+        const float height = static_cast<float>(r.y1 - r.y0);
+        const bool interior = at(r.x0, r.y0) >= limit;
+        for (int y = r.y0 + 1; y < r.y1; ++y) {
+            const float v = static_cast<float>(y - r.y0) / height;
+            const float left = at(r.x0, y);
+            const float right = at(r.x1, y);
+            for (int x = r.x0 + 1; x < r.x1; ++x) {
+                const float u = static_cast<float>(x - r.x0) / width;
+                at(x, y) = interior ? limit
+                                    : 0.5f * ((1.0f - u) * left + u * right +
+                                              (1.0f - v) * at(x, r.y0) + v * at(x, r.y1));
+            }
+        }
+        counters.filled += static_cast<size_t>(r.x1 - r.x0 - 1) * (r.y1 - r.y0 - 1);
+    };
+    std::vector<TraceRect>& next = scratch.next;
+    auto split = [&](const TraceRect& r) {
+        const int xm = (r.x0 + r.x1) / 2;
+        const int ym = (r.y0 + r.y1) / 2;
+        row(ym, r.x0 + 1, r.x1 - 1);
+        column(xm, r.y0 + 1, ym - 1);
+        column(xm, ym + 1, r.y1 - 1);
+        next.push_back({r.x0, r.y0, xm, ym});
+        next.push_back({xm, r.y0, r.x1, ym});
+        next.push_back({r.x0, ym, xm, r.y1});
+        next.push_back({xm, ym, r.x1, r.y1});
+    };
+
+    const int right = size[0] - 1;
+    const int bottom = size[1] - 1;
+    row(0, 0, right);
+    row(bottom, 0, right);
+    column(0, 1, bottom - 1);
+    column(right, 1, bottom - 1);
+    flush();
+
+    std::vector<TraceRect>& rects = scratch.rects;
+    std::vector<TraceRect>& candidates = scratch.candidates;
+    rects.assign(1, {0, 0, right, bottom});
+    while (!rects.empty() && !params.stop.stop_requested()) {
+        next.clear();
+        candidates.clear();
+        for (const TraceRect& r : rects) {
+            if (r.x1 - r.x0 < 2 || r.y1 - r.y0 < 2)
+                continue;
+            if (r.x1 - r.x0 <= traceMinSize || r.y1 - r.y0 <= traceMinSize) {
+                for (int y = r.y0 + 1; y < r.y1; ++y)
+                    row(y, r.x0 + 1, r.x1 - 1);
+            } else if (uniformBorder(r)) {
+                probe(r, [&](int x, int y) { queue.emplace_back(x, y); });
+                candidates.push_back(r);
+            } else {
+                split(r);
+            }
+        }
+        flush();
+        for (const TraceRect& r : candidates) {
+            if (uniformProbes(r))
+                fill(r);
+            else
+                split(r);
+        }
+        flush();
+        std::swap(rects, next);
+    }
+}
+
+// Smooth escape counts of `count` pixels starting at `origin`, `step` pixels apart
+void CpuBackend::computeRow(const RenderParams& params, const Eigen::Vector2i& origin, int step, int count,
+                            float* values, TileCounters& counters) const {
+    if (params.deepZoom) {
+        // Offsets from the reference are tiny but well inside of the double range
+        const double width = params.size[0];
+        const double height = params.size[1];
+        const double dcy = params.preciseScale * (origin[1] - height / 2.0) / height;
+        const double cy = static_cast<double>(params.preciseCenter.y) + dcy;
+        DeepZoom::EscapeStats stats;
+        for (int i = 0; i < count; ++i) {
+            const double dcx = params.preciseScale * (origin[0] + i * step - width / 2.0) / width;
+            if (params.bulbCheck && DeepZoom::insideBulb(static_cast<double>(params.preciseCenter.x) + dcx, cy)) {
+                values[i] = static_cast<float>(params.maxIterations);
+                ++counters.bulbs;
+                continue;
+            }
+            values[i] = DeepZoom::escape(orbit_, dcx, dcy, params.maxIterations, params.periodicityCheck, stats);
+        }
+        counters.periodic += stats.periodic;
+        counters.rebases += stats.rebases;
+        return;
+    }
+    if (params.precision != Precision::Float) {
+        const EscapeCounts shortcuts = escapeInPrecision(*kernel_, params, static_cast<size_t>(count), [&](size_t i) {
+            return Eigen::Vector2d(origin[0] + static_cast<double>(i) * step, origin[1]);
+        }, values);
+        counters.bulbs += shortcuts.bulbs;
+        counters.periodic += shortcuts.periodic;
+        return;
+    }
+
+    const float scale = params.scale;
+    const float width = params.size[0];
+    const float height = params.size[1];
+    float* cx = scratch.cx.data();
+    float* cy = scratch.cy.data();
+    for (int i = 0; i < count; ++i) {
+        const float x = origin[0] + i * step;
+        cx[i] = scale * (x - width / 2.0f) / width + params.center[0];
+    }
+    const float y = origin[1];
+    std::fill_n(cy, count, scale * (y - height / 2.0f) / height + params.center[1]);
+    const EscapeOptions options{params.bulbCheck, params.periodicityCheck, params.formula.juliaX, params.formula.juliaY};
+    const EscapeCounts shortcuts = kernel_->select(params.formula)(cx, cy, count, params.maxIterations, options, values);
+    counters.bulbs += shortcuts.bulbs;
+    counters.periodic += shortcuts.periodic;
+}
+
+// Same for scattered points, in pixels which may be fractional
+void CpuBackend::computePoints(const RenderParams& params, const Eigen::Vector2f* pixels, size_t count,
+                               float* values, TileCounters& counters) const {
+    if (params.deepZoom) {
+        const double width = params.size[0];
+        const double height = params.size[1];
+        DeepZoom::EscapeStats stats;
+        for (size_t i = 0; i < count; ++i) {
+            const double dcx = params.preciseScale * (pixels[i][0] - width / 2.0) / width;
+            const double dcy = params.preciseScale * (pixels[i][1] - height / 2.0) / height;
+            if (params.bulbCheck && DeepZoom::insideBulb(static_cast<double>(params.preciseCenter.x) + dcx,
+                                                         static_cast<double>(params.preciseCenter.y) + dcy)) {
+                values[i] = static_cast<float>(params.maxIterations);
+                ++counters.bulbs;
+                continue;
+            }
+            values[i] = DeepZoom::escape(orbit_, dcx, dcy, params.maxIterations, params.periodicityCheck, stats);
+        }
+        counters.periodic += stats.periodic;
+        counters.rebases += stats.rebases;
+        return;
+    }
+    if (params.precision != Precision::Float) {
+        const EscapeCounts shortcuts = escapeInPrecision(*kernel_, params, count, [&](size_t i) {
+            return pixels[i].cast<double>();
+        }, values);
+        counters.bulbs += shortcuts.bulbs;
+        counters.periodic += shortcuts.periodic;
+        return;
+    }
+
+    const float scale = params.scale;
+    const float width = params.size[0];
+    const float height = params.size[1];
+    scratch.resize(count);
+    float* cx = scratch.cx.data();
+    float* cy = scratch.cy.data();
+    for (size_t i = 0; i < count; ++i) {
+        cx[i] = scale * (pixels[i][0] - width / 2.0f) / width + params.center[0];
+        cy[i] = scale * (pixels[i][1] - height / 2.0f) / height + params.center[1];
+    }
+    const EscapeOptions options{params.bulbCheck, params.periodicityCheck, params.formula.juliaX, params.formula.juliaY};
+    const EscapeCounts shortcuts = kernel_->select(params.formula)(cx, cy, count, params.maxIterations, options, values);
+    counters.bulbs += shortcuts.bulbs;
+    counters.periodic += shortcuts.periodic;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "ComputeBackend.hpp"
+#include "DeepZoom.hpp"
+#include "EscapeKernel.hpp"
+#include "ThreadPool.hpp"
+#include "TileScheduler.hpp"
+
+struct DeepZoomStats {
+    size_t referenceLength = 0;
+    size_t rebases = 0;
+};
+
+// Portable implementation of the `mandelbrot` metal kernel.
+// The image is cut into square tiles which are balanced over the thread pool by
+// the work stealing scheduler, rows of a tile are evaluated by the fastest
+// escape kernel the CPU supports.
+// With RenderStrategy::BoundaryTrace every tile is subdivided into rectangles instead,
+// only their borders are evaluated and rectangles with a uniform border are filled.
+class CpuBackend final : public ComputeBackend
+{
+public:
+    explicit CpuBackend(unsigned threadCount = std::thread::hardware_concurrency());
+    ~CpuBackend() override = default;
+
+    const char* name() const override;
+    void render(const RenderParams& params, const RenderRegion& region,
+                float* dst, size_t valuesPerRow) override;
+    const ShortcutStats& shortcutStats() const override;
+    const RenderTimings& timings() const override;
+    // Smooth iteration counts of arbitrary points given in pixels of the image, supersampling uses it
+    void renderPoints(const RenderParams& params, const Eigen::Vector2f* pixels, size_t count, float* dst);
+
+    unsigned threadCount() const;
+    const EscapeKernel& kernel() const;
+    void setKernel(const EscapeKernel& kernel);
+    int tileSize() const;
+    void setTileSize(int tileSize);
+    // Per tile timings of the last render
+    const SchedulerStats& schedulerStats() const;
+    // Reference orbit length and rebase count of the last deep zoom render
+    const DeepZoomStats& deepZoomStats() const;
+private:
+    // Counters of one tile, summed up when the render is done
+    struct TileCounters {
+        size_t bulbs = 0;
+        size_t periodic = 0;
+        size_t rebases = 0;
+        size_t filled = 0;
+    };
+
+    void renderTile(const RenderParams& params, const Eigen::Vector2i& origin, int step, const Eigen::Vector2i& size,
+                    float* dst, size_t valuesPerRow, TileCounters& counters) const;
+    void traceTile(const RenderParams& params, const Eigen::Vector2i& origin, int step, const Eigen::Vector2i& size,
+                   float* dst, size_t valuesPerRow, TileCounters& counters) const;
+    void computeRow(const RenderParams& params, const Eigen::Vector2i& origin, int step, int count,
+                    float* values, TileCounters& counters) const;
+    void computePoints(const RenderParams& params, const Eigen::Vector2f* pixels, size_t count, float* values,
+                       TileCounters& counters) const;
+private:
+    ThreadPool pool_;
+    TileScheduler scheduler_;
+    const EscapeKernel* kernel_;
+    DeepZoom::ReferenceOrbit orbit_;
+    DeepZoomStats deepZoomStats_;
+    ShortcutStats shortcutStats_;
+    RenderTimings timings_;
+};
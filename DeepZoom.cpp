@@ -0,0 +1,102 @@
+#include "DeepZoom.hpp"
+
+namespace {
+    // Squared distance of orbit points taken for the same point of a cycle, a few double ulps around |z| ~ 1
+    constexpr double periodicityEpsilon = 1e-28;
+} // namespace
+
+namespace DeepZoom {
+
+void ReferenceOrbit::update(const PrecisePoint& center, unsigned long maxIterations) {
+    if (!points_.empty() && center == center_ && maxIterations == maxIterations_)
+        return;
+    center_ = center;
+    maxIterations_ = maxIterations;
+
+    points_.clear();
+    points_.reserve(maxIterations + 2);
+    DoubleDouble zx;
+    DoubleDouble zy;
+    points_.emplace_back(0.0, 0.0);
+    for (unsigned long n = 0; n <= maxIterations; ++n) {
+        const DoubleDouble zx2 = zx * zx;
+        const DoubleDouble zy2 = zy * zy;
+        zy = (zx + zx) * zy + center.y;
+        zx = zx2 - zy2 + center.x;
+        const double x = static_cast<double>(zx);
+        const double y = static_cast<double>(zy);
+        points_.emplace_back(x, y);
+        if (x * x + y * y > 4.0)
+            break;
+    }
+}
+
+const std::vector<std::complex<double>>& ReferenceOrbit::points() const {
+    return points_;
+}
+
+const PrecisePoint& ReferenceOrbit::center() const {
+    return center_;
+}
+
+bool insideBulb(double cx, double cy) {
+    const double xq = cx - 0.25;
+    const double y2 = cy * cy;
+    const double q = xq * xq + y2;
+    return q * (q + xq) <= 0.25 * y2 || (cx + 1.0) * (cx + 1.0) + y2 <= 0.0625;
+}
+
+float escape(const ReferenceOrbit& orbit, double dcx, double dcy,
+             unsigned long maxIterations, bool periodicityCheck, EscapeStats& stats) {
+    const std::complex<double>* reference = orbit.points().data();
+    const size_t referenceSize = orbit.points().size();
+
+    double dzx = 0.0;
+    double dzy = 0.0;
+    size_t m = 0;
+    // Brent-style periodicity check compares z with the point saved at the last power of two
+    double savedX = 0.0;
+    double savedY = 0.0;
+    unsigned long saveAt = 1;
+    // Step n produces z[n + 1] of the orbit starting at z[0] = 0. The metal kernel starts
+    // at z = c and tests from z[2] on, so its iteration i corresponds to n = i + 1.
+    for (unsigned long n = 0; n <= maxIterations; ++n) {
+        const double tx = 2.0 * reference[m].real() + dzx;
+        const double ty = 2.0 * reference[m].imag() + dzy;
+        const double ndzx = tx * dzx - ty * dzy + dcx;
+        const double ndzy = tx * dzy + ty * dzx + dcy;
+        dzx = ndzx;
+        dzy = ndzy;
+        ++m;
+
+        const double zx = reference[m].real() + dzx;
+        const double zy = reference[m].imag() + dzy;
+        const double lengthSquared = zx * zx + zy * zy;
+        if (n > 0 && lengthSquared > 4.0)
+            return static_cast<float>(n - std::log(std::log2(std::sqrt(lengthSquared))));
+
+        if (periodicityCheck) {
+            const double dx = zx - savedX;
+            const double dy = zy - savedY;
+            if (dx * dx + dy * dy <= periodicityEpsilon) {
+                ++stats.periodic;
+                return static_cast<float>(maxIterations);
+            }
+            if (n + 1 == saveAt) {
+                saveAt *= 2;
+                savedX = zx;
+                savedY = zy;
+            }
+        }
+
+        if (lengthSquared < dzx * dzx + dzy * dzy || m + 1 >= referenceSize) {
+            dzx = zx;
+            dzy = zy;
+            m = 0;
+            ++stats.rebases;
+        }
+    }
+    return static_cast<float>(maxIterations);
+}
+
+} // namespace DeepZoom
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "DoubleDouble.hpp"
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+// Perturbation rendering for views deeper than float/double can resolve.
+// One reference orbit Z is iterated in double-double at the center of the view,
+// every pixel iterates only its difference dz from that orbit in plain double:
+//   dz' = (2Z + dz) * dz + dc
+// When the full value Z + dz gets smaller than dz (where a single reference
+// starts to glitch) or the reference escapes, the pixel is rebased onto the
+// beginning of the reference orbit with dz = Z + dz.
+namespace DeepZoom {
+
+class ReferenceOrbit final {
+public:
+    // Recomputes the orbit only if the center or the iteration limit changed
+    void update(const PrecisePoint& center, unsigned long maxIterations);
+
+    // Z[0] = 0, Z[1] = C, ... up to the first escaped point or maxIterations + 1
+    const std::vector<std::complex<double>>& points() const;
+    const PrecisePoint& center() const;
+private:
+    std::vector<std::complex<double>> points_;
+    PrecisePoint center_;
+    unsigned long maxIterations_ = 0;
+};
+
+// Main cardioid or period-2 bulb, points there never escape
+bool insideBulb(double cx, double cy);
+
+struct EscapeStats {
+    size_t rebases = 0;
+    size_t periodic = 0; // pixels stopped by the periodicity check
+};
+
+// Same smooth escape count as the float kernel for c = C + dc, `stats` are accumulated
+float escape(const ReferenceOrbit& orbit, double dcx, double dcy,
+             unsigned long maxIterations, bool periodicityCheck, EscapeStats& stats);
+
+} // namespace DeepZoom
@@ -0,0 +1,93 @@
+#include "DoubleDouble.hpp"
+
+#include <cctype>
+#include <stdexcept>
+
+DoubleDouble DoubleDouble::fromString(const std::string& text) {
+    size_t pos = 0;
+    while (pos < text.size() && std::isspace(static_cast<unsigned char>(text[pos])))
+        ++pos;
+
+    bool negative = false;
+    if (pos < text.size() && (text[pos] == '-' || text[pos] == '+'))
+        negative = text[pos++] == '-';
+
+    DoubleDouble value;
+    int exponent = 0;
+    bool digits = false;
+    bool fraction = false;
+    for (; pos < text.size(); ++pos) {
+        const char ch = text[pos];
+        if (std::isdigit(static_cast<unsigned char>(ch))) {
+            value = value * 10.0 + static_cast<double>(ch - '0');
+            if (fraction)
+                --exponent;
+            digits = true;
+        } else if (ch == '.' && !fraction) {
+            fraction = true;
+        } else {
+            break;
+        }
+    }
+    if (!digits)
+        throw std::invalid_argument("Malformed number: " + text);
+
+    if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+        size_t parsed = 0;
+        try {
+            exponent += std::stoi(text.substr(pos + 1), &parsed);
+        } catch (const std::logic_error&) {
+            throw std::invalid_argument("Malformed exponent: " + text);
+        }
+        pos += parsed + 1;
+    }
+    if (pos != text.size())
+        throw std::invalid_argument("Malformed number: " + text);
+
+    for (; exponent > 0; --exponent)
+        value = value * 10.0;
+    for (; exponent < 0; ++exponent)
+        value = value / 10.0;
+    return negative ? -value : value;
+}
+
+std::string DoubleDouble::toString(int digits) const {
+    if (hi == 0.0)
+        return "0";
+    if (!std::isfinite(hi))
+        return std::to_string(hi);
+
+    DoubleDouble value = hi < 0.0 ? -*this : *this;
+    int exponent = 0;
+    while (value.hi >= 10.0) {
+        value = value / 10.0;
+        ++exponent;
+    }
+    while (value.hi < 1.0) {
+        value = value * 10.0;
+        --exponent;
+    }
+
+    // Round half up at the last printed digit
+    DoubleDouble half(5.0);
+    for (int i = 0; i < digits; ++i)
+        half = half / 10.0;
+    value = value + half;
+    if (value.hi >= 10.0) {
+        value = value / 10.0;
+        ++exponent;
+    }
+
+    std::string result = hi < 0.0 ? "-" : "";
+    for (int i = 0; i < digits; ++i) {
+        int digit = static_cast<int>(std::floor(value.hi));
+        if (value.hi == digit && value.lo < 0.0)
+            --digit;
+        digit = digit < 0 ? 0 : (digit > 9 ? 9 : digit);
+        result += static_cast<char>('0' + digit);
+        if (i == 0)
+            result += '.';
+        value = (value - static_cast<double>(digit)) * 10.0;
+    }
+    return result + "e" + (exponent < 0 ? "-" : "+") + std::to_string(std::abs(exponent));
+}
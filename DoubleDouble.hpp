@@ -0,0 +1,100 @@
+#pragma once
+
+// Unevaluated sum of two doubles giving ~32 significant decimal digits.
+// Enough to keep the center of the view exact down to scales of ~1e-28.
+// Arithmetic relies on IEEE rounding, don't build this with -ffast-math.
+
+#include <cmath>
+#include <string>
+
+struct DoubleDouble {
+    double hi = 0.0;
+    double lo = 0.0;
+
+    constexpr DoubleDouble() = default;
+    constexpr DoubleDouble(double value) : hi(value), lo(0.0) {}
+    constexpr DoubleDouble(double high, double low) : hi(high), lo(low) {}
+
+    explicit operator double() const { return hi + lo; }
+    explicit operator float() const { return static_cast<float>(hi + lo); }
+
+    // Decimal notation, e.g. "-1.18659200000000000000000000012345e+0"
+    static DoubleDouble fromString(const std::string& text);
+    std::string toString(int digits = 32) const;
+};
+
+namespace DoubleDoubleOps {
+
+inline DoubleDouble quickTwoSum(double a, double b) {
+    const double s = a + b;
+    return {s, b - (s - a)};
+}
+
+inline DoubleDouble twoSum(double a, double b) {
+    const double s = a + b;
+    const double bb = s - a;
+    return {s, (a - (s - bb)) + (b - bb)};
+}
+
+inline DoubleDouble twoProd(double a, double b) {
+    const double p = a * b;
+    return {p, std::fma(a, b, -p)};
+}
+
+} // namespace DoubleDoubleOps
+
+inline DoubleDouble operator+(const DoubleDouble& a, const DoubleDouble& b) {
+    DoubleDouble s = DoubleDoubleOps::twoSum(a.hi, b.hi);
+    const DoubleDouble t = DoubleDoubleOps::twoSum(a.lo, b.lo);
+    s.lo += t.hi;
+    s = DoubleDoubleOps::quickTwoSum(s.hi, s.lo);
+    s.lo += t.lo;
+    return DoubleDoubleOps::quickTwoSum(s.hi, s.lo);
+}
+
+inline DoubleDouble operator-(const DoubleDouble& a) {
+    return {-a.hi, -a.lo};
+}
+
+inline DoubleDouble operator-(const DoubleDouble& a, const DoubleDouble& b) {
+    return a + (-b);
+}
+
+inline DoubleDouble operator*(const DoubleDouble& a, const DoubleDouble& b) {
+    DoubleDouble p = DoubleDoubleOps::twoProd(a.hi, b.hi);
+    p.lo += a.hi * b.lo + a.lo * b.hi;
+    return DoubleDoubleOps::quickTwoSum(p.hi, p.lo);
+}
+
+inline DoubleDouble operator/(const DoubleDouble& a, double b) {
+    const double q1 = a.hi / b;
+    const DoubleDouble r = a - DoubleDoubleOps::twoProd(q1, b);
+    const double q2 = r.hi / b;
+    return DoubleDoubleOps::quickTwoSum(q1, q2);
+}
+
+inline bool operator==(const DoubleDouble& a, const DoubleDouble& b) {
+    return a.hi == b.hi && a.lo == b.lo;
+}
+
+inline bool operator!=(const DoubleDouble& a, const DoubleDouble& b) {
+    return !(a == b);
+}
+
+inline bool operator<(const DoubleDouble& a, const DoubleDouble& b) {
+    return a.hi < b.hi || (a.hi == b.hi && a.lo < b.lo);
+}
+
+// Point of the complex plane with double-double coordinates
+struct PrecisePoint {
+    DoubleDouble x;
+    DoubleDouble y;
+};
+
+inline bool operator==(const PrecisePoint& a, const PrecisePoint& b) {
+    return a.x == b.x && a.y == b.y;
+}
+
+inline bool operator!=(const PrecisePoint& a, const PrecisePoint& b) {
+    return !(a == b);
+}
@@ -0,0 +1,110 @@
+#include "EscapeKernel.hpp"
+#include "EscapeKernelSimd.hpp"
+
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+#ifdef MANDELBROT_SIMD_X86
+extern const EscapeKernel avx2EscapeKernel;
+extern const EscapeKernel avx512EscapeKernel;
+#endif
+#ifdef MANDELBROT_SIMD_NEON
+extern const EscapeKernel neonEscapeKernel;
+#endif
+
+namespace {
+    template<typename T>
+    struct Lane {
+        using Scalar = T;
+        using Real = T;
+        using Mask = bool;
+        static constexpr size_t width = 1;
+
+        static Real load(const T* p) { return *p; }
+        static void store(T* p, Real v) { *p = v; }
+        static Real set1(T v) { return v; }
+        static Real add(Real a, Real b) { return a + b; }
+        static Real sub(Real a, Real b) { return a - b; }
+        static Real mul(Real a, Real b) { return a * b; }
+        static Real abs(Real a) { return std::fabs(a); }
+        static Mask cmpLe(Real a, Real b) { return a <= b; }
+        static Mask maskAnd(Mask a, Mask b) { return a && b; }
+        static Mask maskOr(Mask a, Mask b) { return a || b; }
+        static Mask maskAndNot(Mask a, Mask b) { return a && !b; }
+        static Real select(Mask m, Real a, Real b) { return m ? a : b; }
+        static Real addMasked(Real acc, Mask m, Real v) { return m ? acc + v : acc; }
+        static bool none(Mask m) { return !m; }
+    };
+
+    struct DoubleDoubleLane {
+        using Scalar = DoubleDouble;
+        using Real = DoubleDouble;
+        using Mask = bool;
+        static constexpr size_t width = 1;
+
+        static Real load(const DoubleDouble* p) { return *p; }
+        static void store(DoubleDouble* p, Real v) { *p = v; }
+        static Real set1(double v) { return v; }
+        static Real add(Real a, Real b) { return a + b; }
+        static Real sub(Real a, Real b) { return a - b; }
+        static Real mul(Real a, Real b) { return a * b; }
+        static Real abs(Real a) { return a.hi < 0.0 ? -a : a; }
+        static Mask cmpLe(Real a, Real b) { return a.hi < b.hi || (a.hi == b.hi && a.lo <= b.lo); }
+        static Mask maskAnd(Mask a, Mask b) { return a && b; }
+        static Mask maskOr(Mask a, Mask b) { return a || b; }
+        static Mask maskAndNot(Mask a, Mask b) { return a && !b; }
+        static Real select(Mask m, Real a, Real b) { return m ? a : b; }
+        // Only iteration counts are summed, they are exact in the high part
+        static Real addMasked(Real acc, Mask m, Real v) { return m ? Real(acc.hi + v.hi) : acc; }
+        static bool none(Mask m) { return !m; }
+    };
+
+    constexpr EscapeKernel::FormulaTable formulas = EscapeKernels::detail::formulaTable<Lane<float>, 1>();
+    constexpr EscapeFormulaTable<double> doubleFormulas = EscapeKernels::detail::formulaTable<Lane<double>, 1>();
+    constexpr EscapeFormulaTable<DoubleDouble> doubleDoubleFormulas =
+        EscapeKernels::detail::formulaTable<DoubleDoubleLane, 1>();
+
+    const EscapeKernel scalarEscapeKernel{"scalar", 1, formulas[0][0], &formulas, &doubleFormulas};
+} // namespace
+
+namespace EscapeKernels {
+
+const EscapeKernel& scalar() {
+    return scalarEscapeKernel;
+}
+
+std::vector<const EscapeKernel*> available() {
+    std::vector<const EscapeKernel*> kernels{&scalarEscapeKernel};
+#ifdef MANDELBROT_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        kernels.push_back(&avx2EscapeKernel);
+    if (__builtin_cpu_supports("avx512f"))
+        kernels.push_back(&avx512EscapeKernel);
+#endif
+#ifdef MANDELBROT_SIMD_NEON
+    kernels.push_back(&neonEscapeKernel);
+#endif
+    return kernels;
+}
+
+const EscapeKernel& best() {
+    if (const char* forced = std::getenv("MANDELBROT_KERNEL"))
+        return byName(forced);
+    return *available().back();
+}
+
+const EscapeKernel& byName(const std::string& name) {
+    for (const EscapeKernel* kernel : available()) {
+        if (name == kernel->name)
+            return *kernel;
+    }
+    throw std::runtime_error("Escape kernel '" + name + "' isn't supported by this CPU");
+}
+
+EscapeFunc<DoubleDouble> doubleDouble(const Formula& formula) {
+    return selectFormula(doubleDoubleFormulas, formula);
+}
+
+} // namespace EscapeKernels
@@ -0,0 +1,70 @@
+#pragma once
+
+#include "DoubleDouble.hpp"
+#include "Formula.hpp"
+
+#include <array>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Shortcuts for interior points, both of them give maxIterations without iterating that far
+struct EscapeOptions {
+    bool bulbCheck = false;        // analytic test for the main cardioid and the period-2 bulb, z^2 + c only
+    bool periodicityCheck = false; // Brent-style detection of cycling orbits
+    // Constant c of Julia sets, the points are the starting z then
+    float juliaX = 0.0f;
+    float juliaY = 0.0f;
+};
+
+// Points resolved by each of the shortcuts
+struct EscapeCounts {
+    size_t bulbs = 0;
+    size_t periodic = 0;
+};
+
+// Escape time evaluation for a batch of points c = (cx[i], cy[i]) given in the precision T of the loop.
+// out[i] gets the smooth escape count `i + 1 - log(log2(|z|)) / log2(n)` for z^n, or maxIterations for points
+// which never escaped.
+template<typename T>
+using EscapeFunc = EscapeCounts (*)(const T* cx, const T* cy, size_t count,
+                                    unsigned long maxIterations, EscapeOptions options, float* out);
+
+// Loop of every formula type and power, each one instantiated for its formula
+template<typename T>
+using EscapeFormulaTable = std::array<std::array<EscapeFunc<T>, Formula::maxPower - Formula::minPower + 1>,
+                                      formulaTypeCount>;
+
+template<typename T>
+EscapeFunc<T> selectFormula(const EscapeFormulaTable<T>& table, const Formula& formula) {
+    return table[static_cast<size_t>(formula.type)][static_cast<size_t>(formula.power - Formula::minPower)];
+}
+
+struct EscapeKernel {
+    using Func = EscapeFunc<float>;
+    using FormulaTable = EscapeFormulaTable<float>;
+
+    const char* name;
+    size_t width; // points processed per lane group
+    Func escape; // z^2 + c
+    const FormulaTable* formulas;
+    // Same loops in double, half the lanes
+    const EscapeFormulaTable<double>* doubleFormulas;
+
+    Func select(const Formula& formula) const { return selectFormula(*formulas, formula); }
+    EscapeFunc<double> selectDouble(const Formula& formula) const { return selectFormula(*doubleFormulas, formula); }
+};
+
+namespace EscapeKernels {
+
+const EscapeKernel& scalar();
+// All kernels which are compiled in and supported by the running CPU, fastest last
+std::vector<const EscapeKernel*> available();
+// Fastest supported kernel, MANDELBROT_KERNEL environment variable overrides the choice
+const EscapeKernel& best();
+const EscapeKernel& byName(const std::string& name);
+// Double-double loops, scalar on every CPU. Views deeper than double of z^2 + c are rendered by
+// perturbation instead (see DeepZoom), which is much faster, the other formulas need these.
+EscapeFunc<DoubleDouble> doubleDouble(const Formula& formula);
+
+} // namespace EscapeKernels
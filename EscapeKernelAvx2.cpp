@@ -0,0 +1,59 @@
+#include "EscapeKernel.hpp"
+#include "EscapeKernelSimd.hpp"
+
+#include <immintrin.h>
+
+// Compiled with -mavx2 -mfma, used only when the running CPU reports support for both
+
+namespace {
+    struct Avx2 {
+        using Scalar = float;
+        using Real = __m256;
+        using Mask = __m256;
+        static constexpr size_t width = 8;
+
+        static Real load(const float* p) { return _mm256_loadu_ps(p); }
+        static void store(float* p, Real v) { _mm256_storeu_ps(p, v); }
+        static Real set1(float v) { return _mm256_set1_ps(v); }
+        static Real add(Real a, Real b) { return _mm256_add_ps(a, b); }
+        static Real sub(Real a, Real b) { return _mm256_sub_ps(a, b); }
+        static Real mul(Real a, Real b) { return _mm256_mul_ps(a, b); }
+        static Real abs(Real a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+        static Mask cmpLe(Real a, Real b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+        static Mask maskAnd(Mask a, Mask b) { return _mm256_and_ps(a, b); }
+        static Mask maskOr(Mask a, Mask b) { return _mm256_or_ps(a, b); }
+        static Mask maskAndNot(Mask a, Mask b) { return _mm256_andnot_ps(b, a); }
+        static Real select(Mask m, Real a, Real b) { return _mm256_blendv_ps(b, a, m); }
+        static Real addMasked(Real acc, Mask m, Real v) { return _mm256_add_ps(acc, _mm256_and_ps(m, v)); }
+        static bool none(Mask m) { return _mm256_movemask_ps(m) == 0; }
+    };
+
+    struct Avx2Double {
+        using Scalar = double;
+        using Real = __m256d;
+        using Mask = __m256d;
+        static constexpr size_t width = 4;
+
+        static Real load(const double* p) { return _mm256_loadu_pd(p); }
+        static void store(double* p, Real v) { _mm256_storeu_pd(p, v); }
+        static Real set1(double v) { return _mm256_set1_pd(v); }
+        static Real add(Real a, Real b) { return _mm256_add_pd(a, b); }
+        static Real sub(Real a, Real b) { return _mm256_sub_pd(a, b); }
+        static Real mul(Real a, Real b) { return _mm256_mul_pd(a, b); }
+        static Real abs(Real a) { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), a); }
+        static Mask cmpLe(Real a, Real b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+        static Mask maskAnd(Mask a, Mask b) { return _mm256_and_pd(a, b); }
+        static Mask maskOr(Mask a, Mask b) { return _mm256_or_pd(a, b); }
+        static Mask maskAndNot(Mask a, Mask b) { return _mm256_andnot_pd(b, a); }
+        static Real select(Mask m, Real a, Real b) { return _mm256_blendv_pd(b, a, m); }
+        static Real addMasked(Real acc, Mask m, Real v) { return _mm256_add_pd(acc, _mm256_and_pd(m, v)); }
+        static bool none(Mask m) { return _mm256_movemask_pd(m) == 0; }
+    };
+
+    constexpr size_t interleave = 2;
+
+    constexpr EscapeKernel::FormulaTable formulas = EscapeKernels::detail::formulaTable<Avx2, interleave>();
+    constexpr EscapeFormulaTable<double> doubleFormulas = EscapeKernels::detail::formulaTable<Avx2Double, interleave>();
+} // namespace
+
+extern const EscapeKernel avx2EscapeKernel{"avx2", Avx2::width * interleave, formulas[0][0], &formulas, &doubleFormulas};
@@ -0,0 +1,60 @@
+#include "EscapeKernel.hpp"
+#include "EscapeKernelSimd.hpp"
+
+#include <immintrin.h>
+
+// Compiled with -mavx512f, used only when the running CPU reports support for it
+
+namespace {
+    struct Avx512 {
+        using Scalar = float;
+        using Real = __m512;
+        using Mask = __mmask16;
+        static constexpr size_t width = 16;
+
+        static Real load(const float* p) { return _mm512_loadu_ps(p); }
+        static void store(float* p, Real v) { _mm512_storeu_ps(p, v); }
+        static Real set1(float v) { return _mm512_set1_ps(v); }
+        static Real add(Real a, Real b) { return _mm512_add_ps(a, b); }
+        static Real sub(Real a, Real b) { return _mm512_sub_ps(a, b); }
+        static Real mul(Real a, Real b) { return _mm512_mul_ps(a, b); }
+        static Real abs(Real a) { return _mm512_abs_ps(a); }
+        static Mask cmpLe(Real a, Real b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+        static Mask maskAnd(Mask a, Mask b) { return a & b; }
+        static Mask maskOr(Mask a, Mask b) { return a | b; }
+        static Mask maskAndNot(Mask a, Mask b) { return static_cast<Mask>(a & ~b); }
+        static Real select(Mask m, Real a, Real b) { return _mm512_mask_blend_ps(m, b, a); }
+        static Real addMasked(Real acc, Mask m, Real v) { return _mm512_mask_add_ps(acc, m, acc, v); }
+        static bool none(Mask m) { return m == 0; }
+    };
+
+    struct Avx512Double {
+        using Scalar = double;
+        using Real = __m512d;
+        using Mask = __mmask8;
+        static constexpr size_t width = 8;
+
+        static Real load(const double* p) { return _mm512_loadu_pd(p); }
+        static void store(double* p, Real v) { _mm512_storeu_pd(p, v); }
+        static Real set1(double v) { return _mm512_set1_pd(v); }
+        static Real add(Real a, Real b) { return _mm512_add_pd(a, b); }
+        static Real sub(Real a, Real b) { return _mm512_sub_pd(a, b); }
+        static Real mul(Real a, Real b) { return _mm512_mul_pd(a, b); }
+        static Real abs(Real a) { return _mm512_abs_pd(a); }
+        static Mask cmpLe(Real a, Real b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+        static Mask maskAnd(Mask a, Mask b) { return a & b; }
+        static Mask maskOr(Mask a, Mask b) { return a | b; }
+        static Mask maskAndNot(Mask a, Mask b) { return static_cast<Mask>(a & ~b); }
+        static Real select(Mask m, Real a, Real b) { return _mm512_mask_blend_pd(m, b, a); }
+        static Real addMasked(Real acc, Mask m, Real v) { return _mm512_mask_add_pd(acc, m, acc, v); }
+        static bool none(Mask m) { return m == 0; }
+    };
+
+    constexpr size_t interleave = 2;
+
+    constexpr EscapeKernel::FormulaTable formulas = EscapeKernels::detail::formulaTable<Avx512, interleave>();
+    constexpr EscapeFormulaTable<double> doubleFormulas = EscapeKernels::detail::formulaTable<Avx512Double, interleave>();
+} // namespace
+
+extern const EscapeKernel avx512EscapeKernel{"avx512", Avx512::width * interleave, formulas[0][0], &formulas,
+                                             &doubleFormulas};
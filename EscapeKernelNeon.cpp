@@ -0,0 +1,63 @@
+#include "EscapeKernel.hpp"
+#include "EscapeKernelSimd.hpp"
+
+#include <arm_neon.h>
+
+// NEON is mandatory on AArch64, so this kernel needs no runtime check
+
+namespace {
+    struct Neon {
+        using Scalar = float;
+        using Real = float32x4_t;
+        using Mask = uint32x4_t;
+        static constexpr size_t width = 4;
+
+        static Real load(const float* p) { return vld1q_f32(p); }
+        static void store(float* p, Real v) { vst1q_f32(p, v); }
+        static Real set1(float v) { return vdupq_n_f32(v); }
+        static Real add(Real a, Real b) { return vaddq_f32(a, b); }
+        static Real sub(Real a, Real b) { return vsubq_f32(a, b); }
+        static Real mul(Real a, Real b) { return vmulq_f32(a, b); }
+        static Real abs(Real a) { return vabsq_f32(a); }
+        static Mask cmpLe(Real a, Real b) { return vcleq_f32(a, b); }
+        static Mask maskAnd(Mask a, Mask b) { return vandq_u32(a, b); }
+        static Mask maskOr(Mask a, Mask b) { return vorrq_u32(a, b); }
+        static Mask maskAndNot(Mask a, Mask b) { return vbicq_u32(a, b); }
+        static Real select(Mask m, Real a, Real b) { return vbslq_f32(m, a, b); }
+        static Real addMasked(Real acc, Mask m, Real v) {
+            return vaddq_f32(acc, vreinterpretq_f32_u32(vandq_u32(m, vreinterpretq_u32_f32(v))));
+        }
+        static bool none(Mask m) { return vmaxvq_u32(m) == 0; }
+    };
+
+    struct NeonDouble {
+        using Scalar = double;
+        using Real = float64x2_t;
+        using Mask = uint64x2_t;
+        static constexpr size_t width = 2;
+
+        static Real load(const double* p) { return vld1q_f64(p); }
+        static void store(double* p, Real v) { vst1q_f64(p, v); }
+        static Real set1(double v) { return vdupq_n_f64(v); }
+        static Real add(Real a, Real b) { return vaddq_f64(a, b); }
+        static Real sub(Real a, Real b) { return vsubq_f64(a, b); }
+        static Real mul(Real a, Real b) { return vmulq_f64(a, b); }
+        static Real abs(Real a) { return vabsq_f64(a); }
+        static Mask cmpLe(Real a, Real b) { return vcleq_f64(a, b); }
+        static Mask maskAnd(Mask a, Mask b) { return vandq_u64(a, b); }
+        static Mask maskOr(Mask a, Mask b) { return vorrq_u64(a, b); }
+        static Mask maskAndNot(Mask a, Mask b) { return vbicq_u64(a, b); }
+        static Real select(Mask m, Real a, Real b) { return vbslq_f64(m, a, b); }
+        static Real addMasked(Real acc, Mask m, Real v) {
+            return vaddq_f64(acc, vreinterpretq_f64_u64(vandq_u64(m, vreinterpretq_u64_f64(v))));
+        }
+        static bool none(Mask m) { return vmaxvq_u32(vreinterpretq_u32_u64(m)) == 0; }
+    };
+
+    constexpr size_t interleave = 2;
+
+    constexpr EscapeKernel::FormulaTable formulas = EscapeKernels::detail::formulaTable<Neon, interleave>();
+    constexpr EscapeFormulaTable<double> doubleFormulas = EscapeKernels::detail::formulaTable<NeonDouble, interleave>();
+} // namespace
+
+extern const EscapeKernel neonEscapeKernel{"neon", Neon::width * interleave, formulas[0][0], &formulas, &doubleFormulas};
@@ -0,0 +1,233 @@
+#pragma once
+
+// Lane-generic escape loop. It is included only by the ISA specific translation units,
+// each of them instantiates it with its own vector traits type V:
+//   Scalar, Real, Mask, width, load, store, set1, add, sub, mul, abs, cmpLe, maskAnd, maskOr, maskAndNot,
+//   select, addMasked, none
+// Scalar is the precision of the loop (float, double or DoubleDouble), inputs are given in it.
+// The loop is a template over the formula and its power as well, so every formula gets its own
+// straight-line iteration with no runtime branches or pow calls.
+
+#include "EscapeKernel.hpp"
+
+#include <array>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+
+namespace EscapeKernels::detail {
+
+// Squared distance under which two points of an orbit are taken for the same point of a cycle.
+// A few ulps of the precision around |z| ~ 1, larger values stop slowly escaping boundary points too early.
+template<typename Scalar>
+constexpr double periodicityEpsilon = 1e-12;
+template<>
+constexpr double periodicityEpsilon<double> = 1e-28;
+template<>
+constexpr double periodicityEpsilon<DoubleDouble> = 1e-60;
+
+// z^Power given z and its squared parts, which the escape test needs anyway.
+// Unrolled at compile time: even powers square the half power, odd ones multiply by z once more.
+template<typename V, int Power>
+inline void complexPower(typename V::Real zr, typename V::Real zi, typename V::Real zr2, typename V::Real zi2,
+                         typename V::Real& pr, typename V::Real& pi) {
+    if constexpr (Power == 2) {
+        pr = V::sub(zr2, zi2);
+        pi = V::mul(V::add(zr, zr), zi);
+    } else if constexpr (Power % 2 == 0) {
+        typename V::Real hr, hi;
+        complexPower<V, Power / 2>(zr, zi, zr2, zi2, hr, hi);
+        pr = V::sub(V::mul(hr, hr), V::mul(hi, hi));
+        pi = V::mul(V::add(hr, hr), hi);
+    } else {
+        typename V::Real qr, qi;
+        complexPower<V, Power - 1>(zr, zi, zr2, zi2, qr, qi);
+        pr = V::sub(V::mul(qr, zr), V::mul(qi, zi));
+        pi = V::add(V::mul(qr, zi), V::mul(qi, zr));
+    }
+}
+
+// Lane group is `Interleave` independent vectors, iterating them together hides
+// the latency of the dependent multiply-add chain of a single vector.
+// Only the first `lanes` points are counted in the result, the rest is tail padding.
+template<typename V, size_t Interleave, bool Periodicity, FormulaType Type, int Power>
+inline EscapeCounts escapeGroup(const typename V::Scalar* cx, const typename V::Scalar* cy, unsigned long maxIterations,
+                                const EscapeOptions& options, size_t lanes, float* out) {
+    // The bulb test is exact for z^2 + c only
+    constexpr bool hasBulbs = Type == FormulaType::Mandelbrot && Power == 2;
+    constexpr size_t width = V::width;
+    const typename V::Real zero = V::set1(0.0f);
+    const typename V::Real one = V::set1(1.0f);
+    const typename V::Real two = V::set1(2.0f);
+    const typename V::Real four = V::set1(4.0f);
+    const typename V::Real quarter = V::set1(0.25f);
+    const typename V::Real sixteenth = V::set1(0.0625f);
+    const typename V::Real epsilon = V::set1(periodicityEpsilon<typename V::Scalar>);
+
+    typename V::Real cr[Interleave], ci[Interleave];
+    typename V::Real zr[Interleave], zi[Interleave];
+    typename V::Real zr2[Interleave], zi2[Interleave];
+    typename V::Real savedR[Interleave], savedI[Interleave];
+    typename V::Real count[Interleave];
+    typename V::Real resolved[Interleave]; // 0 - iterated, 1 - inside of a bulb, 2 - cycle detected
+    typename V::Mask active[Interleave];
+    bool done = true;
+    for (size_t k = 0; k < Interleave; ++k) {
+        if constexpr (Type == FormulaType::Julia) {
+            zr[k] = V::load(cx + k * width);
+            zi[k] = V::load(cy + k * width);
+            cr[k] = V::set1(options.juliaX);
+            ci[k] = V::set1(options.juliaY);
+        } else {
+            cr[k] = V::load(cx + k * width);
+            ci[k] = V::load(cy + k * width);
+            zr[k] = cr[k];
+            zi[k] = ci[k];
+        }
+        zr2[k] = V::mul(zr[k], zr[k]);
+        zi2[k] = V::mul(zi[k], zi[k]);
+        savedR[k] = zr[k];
+        savedI[k] = zi[k];
+        count[k] = zero;
+        resolved[k] = zero;
+        active[k] = V::cmpLe(four, four);
+        if (hasBulbs && options.bulbCheck) {
+            // Cardioid: q(q + x - 1/4) <= y^2/4 with q = (x - 1/4)^2 + y^2, bulb: (x + 1)^2 + y^2 <= 1/16
+            const typename V::Real xq = V::sub(cr[k], quarter);
+            const typename V::Real q = V::add(V::mul(xq, xq), zi2[k]);
+            const typename V::Mask cardioid = V::cmpLe(V::mul(q, V::add(q, xq)), V::mul(quarter, zi2[k]));
+            const typename V::Real x1 = V::add(cr[k], one);
+            const typename V::Mask bulb = V::cmpLe(V::add(V::mul(x1, x1), zi2[k]), sixteenth);
+            const typename V::Mask inside = V::maskOr(cardioid, bulb);
+            active[k] = V::maskAndNot(active[k], inside);
+            resolved[k] = V::select(inside, one, zero);
+        }
+        done = done && V::none(active[k]);
+    }
+
+    // |z|^2 is compared against 4, lanes which escaped keep their last z and stop counting
+    unsigned long saveAt = 1;
+    for (unsigned long i = 0; i < maxIterations && !done; ++i) {
+        done = true;
+        for (size_t k = 0; k < Interleave; ++k) {
+            typename V::Real pr, pi;
+            if constexpr (Type == FormulaType::BurningShip)
+                complexPower<V, Power>(V::abs(zr[k]), V::abs(zi[k]), zr2[k], zi2[k], pr, pi);
+            else
+                complexPower<V, Power>(zr[k], zi[k], zr2[k], zi2[k], pr, pi);
+            const typename V::Real nzr = V::add(pr, cr[k]);
+            const typename V::Real nzi = V::add(pi, ci[k]);
+            zr[k] = V::select(active[k], nzr, zr[k]);
+            zi[k] = V::select(active[k], nzi, zi[k]);
+            zr2[k] = V::mul(zr[k], zr[k]);
+            zi2[k] = V::mul(zi[k], zi[k]);
+            active[k] = V::maskAnd(active[k], V::cmpLe(V::add(zr2[k], zi2[k]), four));
+            if constexpr (Periodicity) {
+                const typename V::Real dr = V::sub(zr[k], savedR[k]);
+                const typename V::Real di = V::sub(zi[k], savedI[k]);
+                const typename V::Mask cycle =
+                    V::maskAnd(active[k], V::cmpLe(V::add(V::mul(dr, dr), V::mul(di, di)), epsilon));
+                active[k] = V::maskAndNot(active[k], cycle);
+                resolved[k] = V::select(cycle, two, resolved[k]);
+            }
+            count[k] = V::addMasked(count[k], active[k], one);
+            done = done && V::none(active[k]);
+        }
+        // Brent: the saved point jumps forward at powers of two, so cycles of any length are met
+        if constexpr (Periodicity) {
+            if (i + 1 == saveAt) {
+                saveAt *= 2;
+                for (size_t k = 0; k < Interleave; ++k) {
+                    savedR[k] = zr[k];
+                    savedI[k] = zi[k];
+                }
+            }
+        }
+    }
+
+    alignas(64) typename V::Scalar lengths[width * Interleave];
+    alignas(64) typename V::Scalar counts[width * Interleave];
+    alignas(64) typename V::Scalar kinds[width * Interleave];
+    for (size_t k = 0; k < Interleave; ++k) {
+        V::store(lengths + k * width, V::add(zr2[k], zi2[k]));
+        V::store(counts + k * width, count[k]);
+        V::store(kinds + k * width, resolved[k]);
+    }
+    const float maxIt = static_cast<float>(maxIterations);
+    // |z| grows as the power of the previous one, 1 for z^2
+    const float smoothScale = 1.0f / std::log2(static_cast<float>(Power));
+    EscapeCounts shortcuts;
+    for (size_t lane = 0; lane < width * Interleave; ++lane) {
+        // Counts and kinds are small integers, exact in any precision
+        const float lengthZ = std::sqrt(static_cast<float>(lengths[lane]));
+        const float laneCount = static_cast<float>(counts[lane]);
+        const float kind = static_cast<float>(kinds[lane]);
+        out[lane] = maxIt;
+        if (kind == 0.0f && lengthZ > 1 && laneCount < maxIt)
+            out[lane] = laneCount + 1.0f - std::log(std::log2(lengthZ)) * smoothScale;
+        if (lane < lanes) {
+            shortcuts.bulbs += kind == 1.0f;
+            shortcuts.periodic += kind == 2.0f;
+        }
+    }
+    return shortcuts;
+}
+
+template<typename V, size_t Interleave, bool Periodicity, FormulaType Type, int Power>
+inline EscapeCounts escapeRange(const typename V::Scalar* cx, const typename V::Scalar* cy, size_t count,
+                                unsigned long maxIterations, const EscapeOptions& options, float* out) {
+    constexpr size_t groupWidth = V::width * Interleave;
+    EscapeCounts total;
+    auto accumulate = [&total](const EscapeCounts& counts) {
+        total.bulbs += counts.bulbs;
+        total.periodic += counts.periodic;
+    };
+
+    size_t i = 0;
+    for (; i + groupWidth <= count; i += groupWidth)
+        accumulate(escapeGroup<V, Interleave, Periodicity, Type, Power>(cx + i, cy + i, maxIterations, options,
+                                                                        groupWidth, out + i));
+    if (i == count)
+        return total;
+
+    // Tail is padded with the last point so no lane reads past the input
+    alignas(64) typename V::Scalar tailX[groupWidth];
+    alignas(64) typename V::Scalar tailY[groupWidth];
+    alignas(64) float tailOut[groupWidth];
+    for (size_t lane = 0; lane < groupWidth; ++lane) {
+        const size_t src = i + lane < count ? i + lane : count - 1;
+        tailX[lane] = cx[src];
+        tailY[lane] = cy[src];
+    }
+    accumulate(escapeGroup<V, Interleave, Periodicity, Type, Power>(tailX, tailY, maxIterations, options,
+                                                                    count - i, tailOut));
+    for (size_t lane = 0; i + lane < count; ++lane)
+        out[i + lane] = tailOut[lane];
+    return total;
+}
+
+// The periodicity check costs a few operations per iteration, so the loop is instantiated with and without it
+template<typename V, size_t Interleave, FormulaType Type, int Power>
+inline EscapeCounts escapePoints(const typename V::Scalar* cx, const typename V::Scalar* cy, size_t count,
+                                 unsigned long maxIterations, EscapeOptions options, float* out) {
+    if (options.periodicityCheck)
+        return escapeRange<V, Interleave, true, Type, Power>(cx, cy, count, maxIterations, options, out);
+    return escapeRange<V, Interleave, false, Type, Power>(cx, cy, count, maxIterations, options, out);
+}
+
+template<typename V, size_t Interleave, FormulaType Type, int... Offsets>
+constexpr auto formulaRow(std::integer_sequence<int, Offsets...>) {
+    return std::array<EscapeFunc<typename V::Scalar>, sizeof...(Offsets)>{
+        &escapePoints<V, Interleave, Type, Formula::minPower + Offsets>...};
+}
+
+// EscapeKernel::formulas of the ISA and precision, rows follow the order of FormulaType
+template<typename V, size_t Interleave>
+constexpr EscapeFormulaTable<typename V::Scalar> formulaTable() {
+    constexpr auto powers = std::make_integer_sequence<int, Formula::maxPower - Formula::minPower + 1>();
+    return {formulaRow<V, Interleave, FormulaType::Mandelbrot>(powers),
+            formulaRow<V, Interleave, FormulaType::Julia>(powers),
+            formulaRow<V, Interleave, FormulaType::BurningShip>(powers)};
+}
+
+} // namespace EscapeKernels::detail
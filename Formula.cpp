@@ -0,0 +1,47 @@
+#include "Formula.hpp"
+
+#include <fmt/format.h>
+
+#include <stdexcept>
+
+namespace Formulas {
+
+void validate(const Formula& formula) {
+    if (formula.power < Formula::minPower || formula.power > Formula::maxPower)
+        throw std::invalid_argument(fmt::format("Formula power must be from {} to {}: {}",
+                                                Formula::minPower, Formula::maxPower, formula.power));
+}
+
+const char* typeName(FormulaType type) {
+    switch (type) {
+    case FormulaType::Mandelbrot:
+        return "mandelbrot";
+    case FormulaType::Julia:
+        return "julia";
+    case FormulaType::BurningShip:
+        return "burning-ship";
+    }
+    return "unknown";
+}
+
+FormulaType parseType(const std::string& name) {
+    if (name == "mandelbrot" || name == "multibrot")
+        return FormulaType::Mandelbrot;
+    if (name == "julia")
+        return FormulaType::Julia;
+    if (name == "burning-ship")
+        return FormulaType::BurningShip;
+    throw std::invalid_argument("Unknown formula " + name);
+}
+
+std::string describe(const Formula& formula) {
+    std::string text = formula.type == FormulaType::Mandelbrot && formula.power > 2 ? "multibrot"
+                                                                                    : typeName(formula.type);
+    if (formula.power != 2)
+        text += fmt::format(" z^{}", formula.power);
+    if (formula.type == FormulaType::Julia)
+        text += fmt::format(" c=({}, {})", formula.juliaX, formula.juliaY);
+    return text;
+}
+
+} // namespace Formulas
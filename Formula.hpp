@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+
+// Iterated function of the fractal:
+//   Mandelbrot   z^n + c, z starts at c = pixel (Multibrot for n > 2)
+//   Julia        z^n + c, z starts at the pixel, c is fixed
+//   BurningShip  (|Re z| + i|Im z|)^n + c, z starts at c = pixel
+enum class FormulaType {
+    Mandelbrot,
+    Julia,
+    BurningShip
+};
+
+constexpr int formulaTypeCount = 3;
+
+// Kernels are compiled for every formula and power, so the power is limited to the compiled range
+struct Formula {
+    FormulaType type = FormulaType::Mandelbrot;
+    int power = 2;
+    // Constant c of Julia sets, unused by the other formulas
+    float juliaX = -0.8f;
+    float juliaY = 0.156f;
+
+    static constexpr int minPower = 2;
+    static constexpr int maxPower = 8;
+
+    // Plain z^2 + c, the only formula of the bulb check and of deep zoom
+    bool quadraticMandelbrot() const { return type == FormulaType::Mandelbrot && power == 2; }
+    bool operator==(const Formula&) const = default;
+};
+
+namespace Formulas {
+
+// Throws if the power is outside of the compiled range
+void validate(const Formula& formula);
+const char* typeName(FormulaType type);
+// "mandelbrot", "multibrot" (Mandelbrot, the power is set separately), "julia" or "burning-ship"
+FormulaType parseType(const std::string& name);
+// Short human readable form, e.g. "multibrot z^3" or "julia c=(-0.8, 0.156)"
+std::string describe(const Formula& formula);
+
+} // namespace Formulas
@@ -0,0 +1,140 @@
+#include "FrameMetrics.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+
+namespace {
+    const char* stageNames[frameStageCount] = {"dispatch", "compute", "readback", "colorize", "upload", "present"};
+
+    // Trace threads: the one producing the iterations and the one showing them
+    int traceThread(FrameStage stage) {
+        return stage == FrameStage::Upload || stage == FrameStage::Present ? 2 : 1;
+    }
+} // namespace
+
+const char* frameStageName(FrameStage stage) {
+    return stageNames[static_cast<size_t>(stage)];
+}
+
+void FrameMetrics::addSpan(FrameStage stage, double startUs, double durationUs) {
+    spans.push_back({stage, startUs, durationUs});
+}
+
+double FrameMetrics::stageMs(FrameStage stage) const {
+    double total = 0.0;
+    for (const MetricSpan& span : spans) {
+        if (span.stage == stage)
+            total += span.durationUs;
+    }
+    return total / 1000.0;
+}
+
+std::vector<double> FrameMetrics::threadUtilization() const {
+    std::vector<double> utilization(workerBusyMs.size(), 0.0);
+    if (workerWallMs <= 0.0)
+        return utilization;
+    for (size_t i = 0; i < workerBusyMs.size(); ++i)
+        utilization[i] = workerBusyMs[i] / workerWallMs;
+    return utilization;
+}
+
+void FrameMetrics::clear() {
+    frame = 0;
+    step = 1;
+    spans.clear();
+    iterations = 0.0;
+    escapedPixels = 0;
+    interiorPixels = 0;
+    supersampledPixels = 0;
+    workerBusyMs.clear();
+    workerWallMs = 0.0;
+}
+
+namespace Metrics {
+
+double nowUs() {
+    using Clock = std::chrono::steady_clock;
+    static const Clock::time_point epoch = Clock::now();
+    return std::chrono::duration<double, std::micro>(Clock::now() - epoch).count();
+}
+
+} // namespace Metrics
+
+StageTimer::StageTimer(FrameMetrics& metrics, FrameStage stage)
+    : metrics_(metrics), stage_(stage), startUs_(Metrics::nowUs()) {
+}
+
+StageTimer::~StageTimer() {
+    metrics_.addSpan(stage_, startUs_, Metrics::nowUs() - startUs_);
+}
+
+FrameTrace::FrameTrace(size_t capacity)
+    : capacity_(capacity) {
+    if (capacity_ == 0)
+        throw std::invalid_argument("Trace capacity must be positive");
+}
+
+void FrameTrace::record(const FrameMetrics& metrics) {
+    if (frames_.size() == capacity_)
+        frames_.pop_front();
+    frames_.push_back(metrics);
+}
+
+const std::deque<FrameMetrics>& FrameTrace::frames() const {
+    return frames_;
+}
+
+void FrameTrace::clear() {
+    frames_.clear();
+}
+
+std::string FrameTrace::chromeTrace() const {
+    std::string json = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+    auto out = std::back_inserter(json);
+    fmt::format_to(out, "{{\"ph\":\"M\",\"pid\":1,\"tid\":1,\"name\":\"thread_name\",\"args\":{{\"name\":\"render\"}}}},\n"
+                        "{{\"ph\":\"M\",\"pid\":1,\"tid\":2,\"name\":\"thread_name\",\"args\":{{\"name\":\"ui\"}}}}");
+    for (const FrameMetrics& frame : frames_) {
+        for (const MetricSpan& span : frame.spans) {
+            fmt::format_to(out, ",\n{{\"ph\":\"X\",\"pid\":1,\"tid\":{},\"name\":\"{}\",\"ts\":{:.3f},\"dur\":{:.3f},"
+                                "\"args\":{{\"frame\":{},\"step\":{}}}}}",
+                           traceThread(span.stage), frameStageName(span.stage), span.startUs, span.durationUs,
+                           frame.frame, frame.step);
+        }
+        if (frame.spans.empty())
+            continue;
+        // Counters are stamped at the end of the frame
+        double endUs = 0.0;
+        for (const MetricSpan& span : frame.spans)
+            endUs = std::max(endUs, span.startUs + span.durationUs);
+        fmt::format_to(out, ",\n{{\"ph\":\"C\",\"pid\":1,\"name\":\"pixels\",\"ts\":{:.3f},"
+                            "\"args\":{{\"escaped\":{},\"interior\":{}}}}}",
+                       endUs, frame.escapedPixels, frame.interiorPixels);
+        fmt::format_to(out, ",\n{{\"ph\":\"C\",\"pid\":1,\"name\":\"iterations\",\"ts\":{:.3f},"
+                            "\"args\":{{\"iterations\":{:.0f}}}}}",
+                       endUs, frame.iterations);
+        const std::vector<double> utilization = frame.threadUtilization();
+        if (utilization.empty())
+            continue;
+        fmt::format_to(out, ",\n{{\"ph\":\"C\",\"pid\":1,\"name\":\"worker utilization\",\"ts\":{:.3f},\"args\":{{",
+                       endUs);
+        for (size_t i = 0; i < utilization.size(); ++i)
+            fmt::format_to(out, "{}\"worker {}\":{:.3f}", i == 0 ? "" : ",", i, utilization[i]);
+        json += "}}";
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+void FrameTrace::writeChromeTrace(const std::string& path) const {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    if (!file)
+        throw std::runtime_error("Unable to open " + path + " for writing");
+    file << chromeTrace();
+    if (!file.flush())
+        throw std::runtime_error("Unable to write trace " + path);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+enum class FrameStage {
+    Dispatch, // backend setup and submission, the deep zoom reference orbit on the CPU
+    Compute,
+    Readback,
+    Colorize,
+    Upload,   // viewer: copy into the streaming texture
+    Present,  // viewer: drawing and presenting the window
+};
+
+constexpr size_t frameStageCount = 6;
+
+const char* frameStageName(FrameStage stage);
+
+struct MetricSpan {
+    FrameStage stage;
+    double startUs; // Metrics::nowUs() time base
+    double durationUs;
+};
+
+// What it took to produce one frame, a progressive pass in the viewer
+struct FrameMetrics {
+    uint64_t frame = 0;
+    int step = 1;
+    std::vector<MetricSpan> spans;
+    // Computed pixels only, the ones reused from earlier renders aren't counted.
+    // Iterations are the smooth counts summed, interior pixels count the whole limit.
+    double iterations = 0.0;
+    size_t escapedPixels = 0;
+    size_t interiorPixels = 0;
+    // Pixels which got anti-aliasing samples, the samples are counted as computed pixels above
+    size_t supersampledPixels = 0;
+    // Busy time of every CPU worker and the compute time it was busy within
+    std::vector<double> workerBusyMs;
+    double workerWallMs = 0.0;
+
+    void addSpan(FrameStage stage, double startUs, double durationUs);
+    // Summed over all spans of the stage
+    double stageMs(FrameStage stage) const;
+    // Busy share of every worker, 0 to 1
+    std::vector<double> threadUtilization() const;
+    // Keeps the capacity, so metrics of every frame don't allocate
+    void clear();
+};
+
+namespace Metrics {
+
+// Steady clock microseconds since the first call, the time base of all spans
+double nowUs();
+
+} // namespace Metrics
+
+// Adds a span of `stage` from construction to destruction
+class StageTimer final {
+public:
+    StageTimer(FrameMetrics& metrics, FrameStage stage);
+    ~StageTimer();
+
+    StageTimer(const StageTimer&) = delete;
+    StageTimer& operator=(const StageTimer&) = delete;
+private:
+    FrameMetrics& metrics_;
+    FrameStage stage_;
+    double startUs_;
+};
+
+// Metrics of the recent frames, dumped in the Chrome trace event format
+// (chrome://tracing, ui.perfetto.dev): stages are spans of a render and a UI thread,
+// worker utilization and pixel counts are counter tracks.
+class FrameTrace final {
+public:
+    explicit FrameTrace(size_t capacity = 1000);
+
+    // The oldest frame is dropped once capacity frames are kept
+    void record(const FrameMetrics& metrics);
+    const std::deque<FrameMetrics>& frames() const;
+    void clear();
+
+    std::string chromeTrace() const;
+    void writeChromeTrace(const std::string& path) const;
+private:
+    size_t capacity_;
+    std::deque<FrameMetrics> frames_;
+};
@@ -1,14 +1,24 @@
 #include "ImGuiHandler.hpp"
+#include "Palette.hpp"
 
 #include <backends/imgui_impl_sdl2.h>
 #include <backends/imgui_impl_sdlrenderer2.h>
 
+#include <algorithm>
+#include <cstdio>
+#include <iterator>
+
 const auto panelWidth = 200.0f;
+const auto metricsWidth = 220.0f;
 
 ImGuiHandler::ImGuiHandler(SDLWindowPtr window, SDLRendererPtr renderer)
     : window_(window), renderer_(renderer),
-      size_({0, 0}), scale_(0.0f),
-      center_({0.0f, 0.0f}), maxIt_(0),
+      size_({0, 0}), scale_(0.0),
+      center_({0.0, 0.0}), maxIt_(0), autoIterations_(false),
+      bulbCheck_(false), periodicityCheck_(false), precision_(Precision::Auto),
+      framePrecision_(Precision::Float), boundaryTrace_(false),
+      aaSamples_(1), aaJittered_(true),
+      showMetrics_(false), traceRequested_(false),
       fullScreen_(false), updateRequested_(false) {
     IMGUI_CHECKVERSION();
     ImGui::CreateContext();
@@ -43,6 +53,10 @@ bool ImGuiHandler::updateRequested() const {
     return updateRequested_;
 }
 
+bool ImGuiHandler::wantsMouse() const {
+    return ImGui::GetIO().WantCaptureMouse;
+}
+
 void ImGuiHandler::render() {
     ImGui_ImplSDLRenderer2_NewFrame();
     ImGui_ImplSDL2_NewFrame();
@@ -63,13 +77,77 @@ void ImGuiHandler::renderPanel() {
     ImGui::Begin("Position", nullptr, ImGuiWindowFlags_NoCollapse);
     ImGui::SeparatorText("Scale");
     ImGui::PushItemWidth(-1);
-    ImGui::InputFloat("##scale", &scale_, 0.0f, 0.0f, "%f");
+    ImGui::InputDouble("##scale", &scale_, 0.0, 0.0, "%.17g");
     ImGui::SeparatorText("Center (x, y)");
-    ImGui::InputFloat("##x", &center_[0], 0.0f, 0.0f, "%f");
-    ImGui::InputFloat("##y", &center_[1], 0.0f, 0.0f, "%f");
+    ImGui::InputDouble("##x", &center_[0], 0.0, 0.0, "%.17g");
+    ImGui::InputDouble("##y", &center_[1], 0.0, 0.0, "%.17g");
     ImGui::SeparatorText("Max iterations");
     ImGui::InputScalar("##maxIt", ImGuiDataType_U64, &maxIt_);
+    ImGui::Checkbox("Auto", &autoIterations_);
+    ImGui::SeparatorText("Palette");
+    if (ImGui::BeginCombo("##palette", palette_.c_str())) {
+        for (const std::string& name : Palettes::names()) {
+            if (ImGui::Selectable(name.c_str(), name == palette_))
+                palette_ = name;
+        }
+        ImGui::EndCombo();
+    }
+    ImGui::SeparatorText("Formula");
+    if (ImGui::BeginCombo("##formula", Formulas::typeName(formula_.type))) {
+        for (int i = 0; i < formulaTypeCount; ++i) {
+            const auto type = static_cast<FormulaType>(i);
+            if (ImGui::Selectable(Formulas::typeName(type), type == formula_.type))
+                formula_.type = type;
+        }
+        ImGui::EndCombo();
+    }
+    if (ImGui::InputInt("##power", &formula_.power))
+        formula_.power = std::clamp(formula_.power, Formula::minPower, Formula::maxPower);
+    if (formula_.type == FormulaType::Julia) {
+        ImGui::InputFloat("##juliaX", &formula_.juliaX, 0.0f, 0.0f, "%f");
+        ImGui::InputFloat("##juliaY", &formula_.juliaY, 0.0f, 0.0f, "%f");
+    }
+    ImGui::SeparatorText("Precision");
+    if (ImGui::BeginCombo("##precision", Precisions::name(precision_))) {
+        for (Precision precision : {Precision::Auto, Precision::Float, Precision::Double, Precision::DoubleDouble}) {
+            if (ImGui::Selectable(Precisions::name(precision), precision == precision_))
+                precision_ = precision;
+        }
+        ImGui::EndCombo();
+    }
+    ImGui::Text("Frame: %s", Precisions::name(framePrecision_));
+    ImGui::PopItemWidth();
+    ImGui::SeparatorText("Interior shortcuts");
+    ImGui::Checkbox("Bulbs", &bulbCheck_);
+    ImGui::Checkbox("Periodicity", &periodicityCheck_);
+    ImGui::Text("Bulbs: %zu", shortcutStats_.bulbs);
+    ImGui::Text("Periodic: %zu", shortcutStats_.periodic);
+    ImGui::SeparatorText("Boundary tracing");
+    ImGui::Checkbox("Trace", &boundaryTrace_);
+    ImGui::Text("Filled: %zu", shortcutStats_.filled);
+    ImGui::SeparatorText("Anti-aliasing");
+    ImGui::PushItemWidth(-1);
+    const int sampleChoices[] = {1, 4, 9, 16};
+    const char* sampleNames[] = {"Off", "4x", "9x", "16x"};
+    const char* current = sampleNames[0];
+    for (size_t i = 0; i < std::size(sampleChoices); ++i) {
+        if (sampleChoices[i] == aaSamples_)
+            current = sampleNames[i];
+    }
+    if (ImGui::BeginCombo("##antiAliasing", current)) {
+        for (size_t i = 0; i < std::size(sampleChoices); ++i) {
+            if (ImGui::Selectable(sampleNames[i], sampleChoices[i] == aaSamples_))
+                aaSamples_ = sampleChoices[i];
+        }
+        ImGui::EndCombo();
+    }
     ImGui::PopItemWidth();
+    ImGui::Checkbox("Jittered", &aaJittered_);
+    ImGui::SeparatorText("Tile cache");
+    ImGui::Text("Hits: %zu, misses: %zu", tileCacheStats_.hits, tileCacheStats_.misses);
+    ImGui::Text("Evictions: %zu", tileCacheStats_.evictions);
+    ImGui::Text("Tiles: %zu (%zu MB)", tileCacheStats_.tiles, tileCacheStats_.bytes >> 20);
+    ImGui::Checkbox("Metrics", &showMetrics_);
     ImGui::Separator();
     ImGui::Text("Window: %dx%d", size_[0], size_[1]);
     ImGui::Checkbox("##fullScreen", &fullScreen_);
@@ -77,9 +155,42 @@ void ImGuiHandler::renderPanel() {
         updateRequested_ = true;
     }
     ImGui::End();
+    if (showMetrics_)
+        renderMetrics();
     ImGui::EndFrame();
 }
 
+// Next to the "Position" panel, the stages of the last shown frame
+void ImGuiHandler::renderMetrics() {
+    ImGui::SetNextWindowSize({metricsWidth, 0.0f}, ImGuiCond_FirstUseEver);
+    ImGui::SetNextWindowPos({static_cast<float>(size_[0]) - panelWidth - metricsWidth, 0.0f}, ImGuiCond_FirstUseEver);
+    ImGui::Begin("Metrics", &showMetrics_, ImGuiWindowFlags_NoCollapse);
+    ImGui::Text("Frame %llu, step %d", static_cast<unsigned long long>(frameMetrics_.frame), frameMetrics_.step);
+    ImGui::SeparatorText("Stages, ms");
+    for (size_t i = 0; i < frameStageCount; ++i) {
+        const auto stage = static_cast<FrameStage>(i);
+        ImGui::Text("%-10s %8.2f", frameStageName(stage), frameMetrics_.stageMs(stage));
+    }
+    ImGui::SeparatorText("Computed pixels");
+    ImGui::Text("Escaped: %zu", frameMetrics_.escapedPixels);
+    ImGui::Text("Interior: %zu", frameMetrics_.interiorPixels);
+    ImGui::Text("Supersampled: %zu", frameMetrics_.supersampledPixels);
+    ImGui::Text("Iterations: %.3g", frameMetrics_.iterations);
+    const std::vector<double> utilization = frameMetrics_.threadUtilization();
+    if (!utilization.empty()) {
+        ImGui::SeparatorText("Worker utilization");
+        char label[32];
+        for (size_t i = 0; i < utilization.size(); ++i) {
+            std::snprintf(label, sizeof(label), "%zu: %.0f%%", i, utilization[i] * 100.0);
+            ImGui::ProgressBar(static_cast<float>(utilization[i]), {-1.0f, 0.0f}, label);
+        }
+    }
+    ImGui::Separator();
+    if (ImGui::Button("Save trace"))
+        traceRequested_ = true;
+    ImGui::End();
+}
+
 void ImGuiHandler::processEvent(SDL_Event *event) {
     ImGui_ImplSDL2_ProcessEvent(event);
 }
@@ -92,19 +203,19 @@ void ImGuiHandler::setSize(const Eigen::Vector2i& size) {
     size_ = size;
 }
 
-float ImGuiHandler::scale() const {
+double ImGuiHandler::scale() const {
     return scale_;
 }
 
-void ImGuiHandler::setScale(float s) {
+void ImGuiHandler::setScale(double s) {
     scale_ = s;
 }
 
-Eigen::Vector2f ImGuiHandler::center() const {
+Eigen::Vector2d ImGuiHandler::center() const {
     return center_;
 }
 
-void ImGuiHandler::setCenter(const Eigen::Vector2f& center) {
+void ImGuiHandler::setCenter(const Eigen::Vector2d& center) {
     center_ = center;
 }
 
@@ -115,3 +226,95 @@ unsigned long ImGuiHandler::maxIterations() const {
 void ImGuiHandler::setMaxIterations(unsigned long maxIt) {
     maxIt_ = maxIt;
 }
+
+bool ImGuiHandler::autoIterations() const {
+    return autoIterations_;
+}
+
+void ImGuiHandler::setAutoIterations(bool enabled) {
+    autoIterations_ = enabled;
+}
+
+bool ImGuiHandler::boundaryTrace() const {
+    return boundaryTrace_;
+}
+
+void ImGuiHandler::setBoundaryTrace(bool enabled) {
+    boundaryTrace_ = enabled;
+}
+
+AntiAliasing ImGuiHandler::antiAliasing() const {
+    AntiAliasing antiAliasing;
+    antiAliasing.samples = aaSamples_;
+    antiAliasing.pattern = aaJittered_ ? SamplePattern::Jittered : SamplePattern::Stratified;
+    return antiAliasing;
+}
+
+void ImGuiHandler::setAntiAliasing(const AntiAliasing& antiAliasing) {
+    aaSamples_ = antiAliasing.samples;
+    aaJittered_ = antiAliasing.pattern == SamplePattern::Jittered;
+}
+
+const Formula& ImGuiHandler::formula() const {
+    return formula_;
+}
+
+void ImGuiHandler::setFormula(const Formula& formula) {
+    formula_ = formula;
+}
+
+Precision ImGuiHandler::precision() const {
+    return precision_;
+}
+
+void ImGuiHandler::setPrecision(Precision precision) {
+    precision_ = precision;
+}
+
+void ImGuiHandler::setFramePrecision(Precision precision) {
+    framePrecision_ = precision;
+}
+
+bool ImGuiHandler::bulbCheck() const {
+    return bulbCheck_;
+}
+
+void ImGuiHandler::setBulbCheck(bool enabled) {
+    bulbCheck_ = enabled;
+}
+
+bool ImGuiHandler::periodicityCheck() const {
+    return periodicityCheck_;
+}
+
+void ImGuiHandler::setPeriodicityCheck(bool enabled) {
+    periodicityCheck_ = enabled;
+}
+
+void ImGuiHandler::setShortcutStats(const ShortcutStats& stats) {
+    shortcutStats_ = stats;
+}
+
+void ImGuiHandler::setTileCacheStats(const TileCacheStats& stats) {
+    tileCacheStats_ = stats;
+}
+
+void ImGuiHandler::setFrameMetrics(const FrameMetrics& metrics) {
+    frameMetrics_ = metrics;
+}
+
+bool ImGuiHandler::traceRequested() const {
+    return traceRequested_;
+}
+
+void ImGuiHandler::resetTraceRequest() {
+    traceRequested_ = false;
+}
+
+const std::string& ImGuiHandler::palette() const {
+    return palette_;
+}
+
+void ImGuiHandler::setPalette(const std::string& name) {
+    palette_ = name;
+}
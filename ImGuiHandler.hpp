@@ -1,6 +1,13 @@
 #pragma once
 #include "SDLTypes.hpp"
+#include "AntiAliasing.hpp"
+#include "ComputeBackend.hpp"
+#include "Formula.hpp"
+#include "FrameMetrics.hpp"
+#include "Precision.hpp"
+#include "TileCache.hpp"
 #include <imgui.h>
+#include <string>
 #include <Eigen/Dense>
 
 class ImGuiHandler final {
@@ -13,26 +20,69 @@ public:
     bool fullScreen() const;
     void setFullScreen(bool fullScreen);
     bool updateRequested() const;
+    // Mouse is over the panel, its events aren't for the image
+    bool wantsMouse() const;
     void resetUpdate();
 
     // TODO: Some universal update mechanism
     Eigen::Vector2i size() const;
     void setSize(const Eigen::Vector2i& size);
-    float scale() const;
-    void setScale(float s);
-    Eigen::Vector2f center() const;
-    void setCenter(const Eigen::Vector2f& center);
+    double scale() const;
+    void setScale(double s);
+    Eigen::Vector2d center() const;
+    void setCenter(const Eigen::Vector2d& center);
     unsigned long maxIterations() const;
     void setMaxIterations(unsigned long maxIt);
+    bool autoIterations() const;
+    void setAutoIterations(bool enabled);
+    bool bulbCheck() const;
+    void setBulbCheck(bool enabled);
+    bool periodicityCheck() const;
+    void setPeriodicityCheck(bool enabled);
+    const Formula& formula() const;
+    void setFormula(const Formula& formula);
+    Precision precision() const;
+    void setPrecision(Precision precision);
+    // Precision of the shown frame, the one auto mode picked
+    void setFramePrecision(Precision precision);
+    bool boundaryTrace() const;
+    void setBoundaryTrace(bool enabled);
+    AntiAliasing antiAliasing() const;
+    void setAntiAliasing(const AntiAliasing& antiAliasing);
+    void setShortcutStats(const ShortcutStats& stats);
+    void setTileCacheStats(const TileCacheStats& stats);
+    // Shown in the optional metrics window
+    void setFrameMetrics(const FrameMetrics& metrics);
+    // "Save trace" was pressed in the metrics window
+    bool traceRequested() const;
+    void resetTraceRequest();
+    const std::string& palette() const;
+    void setPalette(const std::string& name);
 private:
     void renderPanel();
+    void renderMetrics();
 private:
     SDLWindowPtr window_;
     SDLRendererPtr renderer_;
     Eigen::Vector2i size_;
-    float scale_;
-    Eigen::Vector2f center_;
+    double scale_;
+    Eigen::Vector2d center_;
     unsigned long long maxIt_;
+    bool autoIterations_;
+    bool bulbCheck_;
+    bool periodicityCheck_;
+    Formula formula_;
+    Precision precision_;
+    Precision framePrecision_;
+    bool boundaryTrace_;
+    int aaSamples_;
+    bool aaJittered_;
+    ShortcutStats shortcutStats_;
+    TileCacheStats tileCacheStats_;
+    FrameMetrics frameMetrics_;
+    bool showMetrics_;
+    bool traceRequested_;
+    std::string palette_;
     bool fullScreen_;
     bool updateRequested_;
 };
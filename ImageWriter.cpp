@@ -0,0 +1,115 @@
+#include "ImageWriter.hpp"
+
+#include <cstdio>
+#include <functional>
+#include <stdexcept>
+#include <vector>
+
+#ifdef MANDELBROT_WITH_PNG
+#include <png.h>
+#endif
+
+using FilePtr = std::unique_ptr<FILE, std::function<void(FILE*)>>;
+
+namespace {
+    FilePtr openFile(const std::string& path) {
+        FilePtr file(std::fopen(path.c_str(), "wb"), [](FILE* f) { std::fclose(f); });
+        if (file == nullptr)
+            throw std::runtime_error("Unable to open " + path + " for writing");
+        return file;
+    }
+
+    bool hasExtension(const std::string& path, const std::string& extension) {
+        return path.size() >= extension.size() &&
+               path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+    }
+
+    // Binary RGB portable pixmap, the alpha channel is dropped
+    class PpmWriter final : public ImageWriter {
+    public:
+        PpmWriter(const std::string& path, const Eigen::Vector2i& size)
+            : file_(openFile(path)), width_(size[0]), rgb_(static_cast<size_t>(size[0]) * 3) {
+            if (std::fprintf(file_.get(), "P6\n%d %d\n255\n", size[0], size[1]) < 0)
+                throw std::runtime_error("Unable to write PPM header");
+        }
+
+        void writeRows(const uint8_t* rgba, size_t bytesPerRow, int rows) override {
+            for (int row = 0; row < rows; ++row) {
+                const uint8_t* src = rgba + row * bytesPerRow;
+                for (int x = 0; x < width_; ++x) {
+                    rgb_[x * 3 + 0] = src[x * 4 + 0];
+                    rgb_[x * 3 + 1] = src[x * 4 + 1];
+                    rgb_[x * 3 + 2] = src[x * 4 + 2];
+                }
+                if (std::fwrite(rgb_.data(), 1, rgb_.size(), file_.get()) != rgb_.size())
+                    throw std::runtime_error("Unable to write PPM row");
+            }
+        }
+
+        void finish() override {
+            if (std::fflush(file_.get()) != 0)
+                throw std::runtime_error("Unable to flush PPM file");
+        }
+    private:
+        FilePtr file_;
+        int width_;
+        std::vector<uint8_t> rgb_;
+    };
+
+#ifdef MANDELBROT_WITH_PNG
+    // libpng reports errors with longjmp, every call into it is guarded by setjmp
+    class PngWriter final : public ImageWriter {
+    public:
+        PngWriter(const std::string& path, const Eigen::Vector2i& size)
+            : file_(openFile(path)), png_(nullptr), info_(nullptr) {
+            png_ = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+            if (png_ == nullptr)
+                throw std::runtime_error("Unable to create PNG write struct");
+            info_ = png_create_info_struct(png_);
+            if (info_ == nullptr) {
+                png_destroy_write_struct(&png_, nullptr);
+                throw std::runtime_error("Unable to create PNG info struct");
+            }
+            if (setjmp(png_jmpbuf(png_)))
+                throw std::runtime_error("Unable to write PNG header");
+            png_init_io(png_, file_.get());
+            png_set_IHDR(png_, info_, size[0], size[1], 8, PNG_COLOR_TYPE_RGB_ALPHA,
+                         PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+            png_write_info(png_, info_);
+        }
+
+        ~PngWriter() override {
+            png_destroy_write_struct(&png_, &info_);
+        }
+
+        void writeRows(const uint8_t* rgba, size_t bytesPerRow, int rows) override {
+            if (setjmp(png_jmpbuf(png_)))
+                throw std::runtime_error("Unable to write PNG row");
+            for (int row = 0; row < rows; ++row)
+                png_write_row(png_, rgba + row * bytesPerRow);
+        }
+
+        void finish() override {
+            if (setjmp(png_jmpbuf(png_)))
+                throw std::runtime_error("Unable to finish PNG file");
+            png_write_end(png_, nullptr);
+            if (std::fflush(file_.get()) != 0)
+                throw std::runtime_error("Unable to flush PNG file");
+        }
+    private:
+        FilePtr file_;
+        png_structp png_;
+        png_infop info_;
+    };
+#endif
+} // namespace
+
+std::unique_ptr<ImageWriter> ImageWriter::create(const std::string& path, const Eigen::Vector2i& size) {
+    if (hasExtension(path, ".ppm"))
+        return std::make_unique<PpmWriter>(path, size);
+#ifdef MANDELBROT_WITH_PNG
+    if (hasExtension(path, ".png"))
+        return std::make_unique<PngWriter>(path, size);
+#endif
+    throw std::invalid_argument("Unsupported image format: " + path);
+}
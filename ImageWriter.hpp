@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <Eigen/Dense>
+
+// Streams RGBA8 rows into an image file top to bottom,
+// only the rows passed to writeRows() have to be resident in memory.
+class ImageWriter {
+public:
+    virtual ~ImageWriter() = default;
+
+    virtual void writeRows(const uint8_t* rgba, size_t bytesPerRow, int rows) = 0;
+    virtual void finish() = 0;
+
+    // Format is chosen by the file extension: .ppm or .png (when built with libpng)
+    static std::unique_ptr<ImageWriter> create(const std::string& path, const Eigen::Vector2i& size);
+};
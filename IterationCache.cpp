@@ -0,0 +1,88 @@
+#include "IterationCache.hpp"
+#include "CompressedIterations.hpp"
+
+#include <fmt/core.h>
+
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
+#include <utility>
+
+#include <unistd.h>
+
+namespace {
+    constexpr char magic[8] = {'M', 'B', 'I', 'T', 'E', 'R', 'S', '2'};
+
+    struct Header {
+        char magic[8];
+        uint64_t count;
+        uint32_t descriptionSize;
+        uint32_t reserved;
+    };
+
+    // Temporary names are unique within the process, the pid is added for processes sharing a cache
+    std::atomic<uint64_t> temporaryCounter{0};
+} // namespace
+
+IterationCache::IterationCache(std::filesystem::path directory)
+    : directory_(std::move(directory)) {
+    std::filesystem::create_directories(directory_);
+}
+
+const std::filesystem::path& IterationCache::directory() const {
+    return directory_;
+}
+
+bool IterationCache::load(const std::string& description, std::vector<float>& values) const {
+    std::ifstream file(entryPath(description), std::ios::binary);
+    if (!file)
+        return false;
+    Header header;
+    if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, magic, sizeof(magic)) != 0 ||
+        header.count != values.size() || header.descriptionSize != description.size())
+        return false;
+    std::string stored(header.descriptionSize, '\0');
+    if (!file.read(stored.data(), static_cast<std::streamsize>(stored.size())) || stored != description)
+        return false;
+    CompressedIterations counts;
+    if (!counts.read(file) || static_cast<size_t>(counts.size().prod()) != values.size())
+        return false;
+    counts.decodeRows(0, counts.size()[1], values.data(), counts.size()[0]);
+    return true;
+}
+
+void IterationCache::store(const std::string& description, const std::vector<float>& values,
+                           unsigned long maxIterations) const {
+    const std::filesystem::path path = entryPath(description);
+    const std::filesystem::path temporary = path.string() + fmt::format(".{}.{}.tmp", ::getpid(),
+                                                                        temporaryCounter.fetch_add(1));
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        Header header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.count = values.size();
+        header.descriptionSize = static_cast<uint32_t>(description.size());
+        file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        file.write(description.data(), static_cast<std::streamsize>(description.size()));
+        // One row, entries are only ever read whole
+        CompressedIterations(values.data(), {static_cast<int>(values.size()), 1}, values.size(), maxIterations).write(file);
+        if (!file.flush())
+            throw std::runtime_error("Unable to write cache entry " + temporary.string());
+    }
+    std::filesystem::rename(temporary, path);
+}
+
+std::string IterationCache::key(const std::string& description) {
+    uint64_t hash = 14695981039346656037ull;
+    for (unsigned char c : description) {
+        hash ^= c;
+        hash *= 1099511628211ull;
+    }
+    return fmt::format("{:016x}", hash);
+}
+
+std::filesystem::path IterationCache::entryPath(const std::string& description) const {
+    return directory_ / (key(description) + ".iter");
+}
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+// Content-addressed directory of smooth iteration counts.
+// An entry is named after a hash of the description of the view it holds and keeps the description
+// itself, so colliding or foreign files are never mistaken for a hit. Coloring isn't part of an entry,
+// a palette change recolors cached counts instead of recomputing them.
+// Entries are written to a temporary file and renamed, concurrent writers and crashes leave no partial entries.
+// Counts are kept as CompressedIterations, a few times smaller than floats.
+class IterationCache final {
+public:
+    explicit IterationCache(std::filesystem::path directory);
+
+    const std::filesystem::path& directory() const;
+    // Fills `values` when there is an entry of `description` with exactly values.size() counts
+    bool load(const std::string& description, std::vector<float>& values) const;
+    void store(const std::string& description, const std::vector<float>& values, unsigned long maxIterations) const;
+
+    // 64-bit FNV-1a of the description in hex
+    static std::string key(const std::string& description);
+private:
+    std::filesystem::path entryPath(const std::string& description) const;
+
+    std::filesystem::path directory_;
+};
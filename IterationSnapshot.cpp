@@ -0,0 +1,196 @@
+#include "IterationSnapshot.hpp"
+
+#include <fmt/format.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    constexpr char magic[8] = {'M', 'B', 'S', 'N', 'A', 'P', 'S', 'H'};
+    // Readers refuse other versions, a layout change bumps it
+    constexpr uint32_t version = 1;
+    // Values start at a page boundary, so they are aligned wherever the file is mapped
+    constexpr uint64_t dataOffset = 4096;
+
+    struct Header {
+        char magic[8];
+        uint32_t version;
+        uint32_t width;
+        uint32_t height;
+        uint32_t formulaType;
+        uint32_t power;
+        uint32_t precision;
+        double centerX[2]; // double-double hi, lo
+        double centerY[2];
+        double scale;
+        uint64_t maxIterations;
+        float juliaX;
+        float juliaY;
+        uint64_t dataOffset;
+    };
+
+    static_assert(sizeof(Header) <= dataOffset);
+
+    std::runtime_error systemError(const std::string& what, const std::string& path) {
+        const std::string reason = std::strerror(errno);
+        return std::runtime_error(what + " " + path + ": " + reason);
+    }
+} // namespace
+
+SnapshotWriter::SnapshotWriter(const std::string& path, const SnapshotView& view)
+    : path_(path), temporary_(path + fmt::format(".{}.tmp", ::getpid())), fd_(-1), size_(view.size), rows_(0) {
+    if ((view.size.array() <= 0).any())
+        throw std::invalid_argument("Snapshot needs a positive image size");
+    if (view.precision == Precision::Auto)
+        throw std::invalid_argument("Snapshot needs the precision the counts were computed in");
+    fd_ = ::open(temporary_.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0)
+        throw systemError("Unable to create", temporary_);
+
+    Header header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.width = static_cast<uint32_t>(view.size[0]);
+    header.height = static_cast<uint32_t>(view.size[1]);
+    header.formulaType = static_cast<uint32_t>(view.formula.type);
+    header.power = static_cast<uint32_t>(view.formula.power);
+    header.precision = static_cast<uint32_t>(view.precision);
+    header.centerX[0] = view.center.x.hi;
+    header.centerX[1] = view.center.x.lo;
+    header.centerY[0] = view.center.y.hi;
+    header.centerY[1] = view.center.y.lo;
+    header.scale = view.scale;
+    header.maxIterations = view.maxIterations;
+    header.juliaX = view.formula.juliaX;
+    header.juliaY = view.formula.juliaY;
+    header.dataOffset = dataOffset;
+    std::vector<uint8_t> page(dataOffset, 0);
+    std::memcpy(page.data(), &header, sizeof(header));
+    write(page.data(), page.size());
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    // Unfinished, nothing is left behind
+    if (fd_ >= 0) {
+        ::close(fd_);
+        ::unlink(temporary_.c_str());
+    }
+}
+
+void SnapshotWriter::writeRows(const float* values, size_t valuesPerRow, int rows) {
+    if (fd_ < 0 || rows < 0 || rows_ + rows > size_[1])
+        throw std::out_of_range("Rows are out of the snapshot");
+    const size_t rowBytes = static_cast<size_t>(size_[0]) * sizeof(float);
+    if (valuesPerRow == static_cast<size_t>(size_[0])) {
+        write(values, rowBytes * rows);
+    } else {
+        for (int y = 0; y < rows; ++y)
+            write(values + y * valuesPerRow, rowBytes);
+    }
+    rows_ += rows;
+}
+
+void SnapshotWriter::finish() {
+    if (rows_ != size_[1])
+        throw std::runtime_error(fmt::format("Snapshot {} has {} of {} rows", path_, rows_, size_[1]));
+    if (::fsync(fd_) != 0 || ::close(fd_) != 0) {
+        fd_ = -1;
+        ::unlink(temporary_.c_str());
+        throw systemError("Unable to write", temporary_);
+    }
+    fd_ = -1;
+    if (std::rename(temporary_.c_str(), path_.c_str()) != 0) {
+        ::unlink(temporary_.c_str());
+        throw systemError("Unable to rename to", path_);
+    }
+}
+
+void SnapshotWriter::write(const void* src, size_t bytes) {
+    const uint8_t* in = static_cast<const uint8_t*>(src);
+    while (bytes > 0) {
+        const ssize_t done = ::write(fd_, in, bytes);
+        if (done < 0 && errno == EINTR)
+            continue;
+        if (done <= 0)
+            throw systemError("Unable to write", temporary_);
+        in += done;
+        bytes -= static_cast<size_t>(done);
+    }
+}
+
+IterationSnapshot::IterationSnapshot(const std::string& path)
+    : path_(path), data_(MAP_FAILED), bytes_(0), values_(nullptr) {
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        throw systemError("Unable to open", path);
+    struct stat status;
+    if (::fstat(fd, &status) != 0) {
+        ::close(fd);
+        throw systemError("Unable to open", path);
+    }
+    bytes_ = static_cast<size_t>(status.st_size);
+    if (bytes_ < sizeof(Header)) {
+        ::close(fd);
+        throw std::runtime_error(path + " isn't an iteration snapshot");
+    }
+    // The mapping outlives the descriptor
+    data_ = ::mmap(nullptr, bytes_, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data_ == MAP_FAILED)
+        throw systemError("Unable to map", path);
+
+    Header header;
+    std::memcpy(&header, data_, sizeof(header));
+    try {
+        if (std::memcmp(header.magic, magic, sizeof(magic)) != 0)
+            throw std::runtime_error(path + " isn't an iteration snapshot");
+        if (header.version != version)
+            throw std::runtime_error(fmt::format("{} is a version {} snapshot, version {} is supported",
+                                                 path, header.version, version));
+        const uint64_t pixels = static_cast<uint64_t>(header.width) * header.height;
+        if (header.width == 0 || header.height == 0 || header.dataOffset % sizeof(float) != 0 ||
+            header.dataOffset + pixels * sizeof(float) > bytes_ ||
+            header.formulaType >= formulaTypeCount || header.precision > static_cast<uint32_t>(Precision::DoubleDouble))
+            throw std::runtime_error(path + " is a damaged snapshot");
+    } catch (...) {
+        ::munmap(data_, bytes_);
+        throw;
+    }
+
+    view_.size = {static_cast<int>(header.width), static_cast<int>(header.height)};
+    view_.center = {DoubleDouble(header.centerX[0], header.centerX[1]), DoubleDouble(header.centerY[0], header.centerY[1])};
+    view_.scale = header.scale;
+    view_.maxIterations = static_cast<unsigned long>(header.maxIterations);
+    view_.formula.type = static_cast<FormulaType>(header.formulaType);
+    view_.formula.power = static_cast<int>(header.power);
+    view_.formula.juliaX = header.juliaX;
+    view_.formula.juliaY = header.juliaY;
+    view_.precision = static_cast<Precision>(header.precision);
+    values_ = reinterpret_cast<const float*>(static_cast<const uint8_t*>(data_) + header.dataOffset);
+}
+
+IterationSnapshot::~IterationSnapshot() {
+    ::munmap(data_, bytes_);
+}
+
+const SnapshotView& IterationSnapshot::view() const {
+    return view_;
+}
+
+const float* IterationSnapshot::values() const {
+    return values_;
+}
+
+const float* IterationSnapshot::row(int y) const {
+    if (y < 0 || y >= view_.size[1])
+        throw std::out_of_range("Row is out of the snapshot");
+    return values_ + static_cast<size_t>(y) * view_.size[0];
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include "DoubleDouble.hpp"
+#include "Formula.hpp"
+#include "Precision.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <Eigen/Dense>
+
+// Everything needed to recolor a snapshot or to render its view again
+struct SnapshotView {
+    Eigen::Vector2i size{0, 0};
+    PrecisePoint center;
+    double scale = 0.0;
+    unsigned long maxIterations = 0;
+    Formula formula;
+    Precision precision = Precision::Float; // the one the counts were computed in
+};
+
+// Smooth iteration counts of a whole image with the view they belong to.
+// Layout: versioned header, then width * height floats in row-major order from the first page boundary,
+// so an opened snapshot is the mapped file itself and a crop or thumbnail reads only the pages it samples.
+// Host byte order, like the tile containers.
+class SnapshotWriter final {
+public:
+    // Rows go to a temporary file next to `path`, which is renamed to it by finish()
+    SnapshotWriter(const std::string& path, const SnapshotView& view);
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // Next `rows` full width rows
+    void writeRows(const float* values, size_t valuesPerRow, int rows);
+    // All rows must have been written
+    void finish();
+private:
+    void write(const void* src, size_t bytes);
+private:
+    std::string path_;
+    std::string temporary_;
+    int fd_;
+    Eigen::Vector2i size_;
+    int rows_;
+};
+
+class IterationSnapshot final {
+public:
+    // Maps the file read-only, nothing but the header is read until the values are
+    explicit IterationSnapshot(const std::string& path);
+    ~IterationSnapshot();
+
+    IterationSnapshot(const IterationSnapshot&) = delete;
+    IterationSnapshot& operator=(const IterationSnapshot&) = delete;
+
+    const SnapshotView& view() const;
+    const float* values() const;
+    const float* row(int y) const;
+private:
+    std::string path_;
+    void* data_;
+    size_t bytes_;
+    SnapshotView view_;
+    const float* values_;
+};
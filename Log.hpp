@@ -0,0 +1,28 @@
+#pragma once
+
+// Minimal logger of the compute core. It doesn't depend on SDL,
+// so the headless tools can use the generator without SDL at all.
+
+#include <fmt/core.h>
+
+#include <cstdio>
+#include <utility>
+
+namespace Log {
+
+template<typename... Args>
+void info(fmt::format_string<Args...> format, Args&&... args) {
+    fmt::print(stderr, "INFO: {}\n", fmt::format(format, std::forward<Args>(args)...));
+}
+
+template<typename... Args>
+void warn(fmt::format_string<Args...> format, Args&&... args) {
+    fmt::print(stderr, "WARN: {}\n", fmt::format(format, std::forward<Args>(args)...));
+}
+
+template<typename... Args>
+void error(fmt::format_string<Args...> format, Args&&... args) {
+    fmt::print(stderr, "ERROR: {}\n", fmt::format(format, std::forward<Args>(args)...));
+}
+
+} // namespace Log
@@ -1,72 +1,93 @@
 #include "MandelbrotSetGenerator.hpp"
-#include <SDL_log.h> // TODO: wrap to C++ logger
-#include <fmt/core.h>
-
-#define NS_PRIVATE_IMPLEMENTATION
-#define MTL_PRIVATE_IMPLEMENTATION
-#define MTK_PRIVATE_IMPLEMENTATION
-#define CA_PRIVATE_IMPLEMENTATION
-#include <Metal/Metal.hpp>
-#include <Foundation/Foundation.hpp>
-#include <QuartzCore/QuartzCore.hpp>
+#ifdef MANDELBROT_WITH_METAL
+#include "MetalBackend.hpp"
+#endif
+#include "AutoIterations.hpp"
+#include "Log.hpp"
 
+#include <algorithm>
 #include <cmath>
-#include <iostream>
-#include <functional>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <utility>
 
 namespace {
-    const std::string functionName{"mandelbrot"};
-} // namespace
+    SnapshotView snapshotViewOf(const RenderParams& params) {
+        return {params.size, params.preciseCenter, params.preciseScale, params.maxIterations, params.formula,
+                params.precision};
+    }
 
-template<typename T>
-void refDeleter(NS::Referencing<T> * ref) {
-    ref->release();
-}
+    // Offset of `current` in pixels of `previous`, nothing if they don't share the pixel grid
+    std::optional<Eigen::Vector2i> latticeOffset(const RenderParams& previous, const RenderParams& current) {
+        if (previous.size != current.size || previous.preciseScale != current.preciseScale ||
+            previous.maxIterations != current.maxIterations || previous.deepZoom != current.deepZoom ||
+            previous.precision != current.precision ||
+            previous.formula != current.formula || previous.strategy != current.strategy)
+            return std::nullopt;
+
+        // Pixel x is at scale * (x - width / 2) / width + center, y uses the height the same way
+        const double dx = static_cast<double>(current.preciseCenter.x - previous.preciseCenter.x) *
+                          current.size[0] / current.preciseScale;
+        const double dy = static_cast<double>(current.preciseCenter.y - previous.preciseCenter.y) *
+                          current.size[1] / current.preciseScale;
+        const Eigen::Vector2d offset(std::round(dx), std::round(dy));
+        if (std::abs(dx - offset[0]) > 1e-3 || std::abs(dy - offset[1]) > 1e-3)
+            return std::nullopt;
+        if (std::abs(offset[0]) >= 1 << 30 || std::abs(offset[1]) >= 1 << 30)
+            return std::nullopt;
+        return offset.cast<int>();
+    }
 
-template<typename T>
-void refResourceDeleter(NS::Referencing<T, MTL::Resource> * ref) {
-    ref->release();
-}
+    // Same for views which overlap
+    std::optional<Eigen::Vector2i> gridOffset(const RenderParams& previous, const RenderParams& current) {
+        const auto offset = latticeOffset(previous, current);
+        if (!offset || std::abs((*offset)[0]) >= current.size[0] || std::abs((*offset)[1]) >= current.size[1])
+            return std::nullopt;
+        return offset;
+    }
 
-template<typename T>
-void refCopyingDeleter(NS::Copying<T> * ref) {
-    ref->release();
-}
+    int floorDiv(int value, int divisor) {
+        return value >= 0 ? value / divisor : -((-value + divisor - 1) / divisor);
+    }
+
+    std::unique_ptr<ComputeBackend> createBackend(BackendType type, unsigned threadCount) {
+        switch (type) {
+        case BackendType::Default:
+#ifdef MANDELBROT_WITH_METAL
+            return std::make_unique<MetalBackend>();
+#else
+            return std::make_unique<CpuBackend>(threadCount);
+#endif
+        case BackendType::Cpu:
+            return std::make_unique<CpuBackend>(threadCount);
+        case BackendType::Metal:
+#ifdef MANDELBROT_WITH_METAL
+            return std::make_unique<MetalBackend>();
+#else
+            throw std::runtime_error("Metal backend isn't available in this build");
+#endif
+        }
+        throw std::invalid_argument("Unknown backend type");
+    }
+} // namespace
 
 void rawBufferDeleter(uint8_t *rawBuffer) {
     delete [] rawBuffer;
 }
 
-MandelbrotSetGenerator::MandelbrotSetGenerator()
-    : device_(MTL::CreateSystemDefaultDevice(), refDeleter<MTL::Device>),
-      library_(nullptr, refDeleter<MTL::Library>),
-      mandelbrotMetalFunc_(nullptr, refDeleter<MTL::Function>),
-      computePipeline_(nullptr, refDeleter<MTL::ComputePipelineState>),
-      commandQueue_(nullptr, refDeleter<MTL::CommandQueue>),
-      texture_(nullptr, refResourceDeleter<MTL::Texture>),
-      positionBuffer_(nullptr, refResourceDeleter<MTL::Buffer>),
-      maxItBuffer_(nullptr, refResourceDeleter<MTL::Buffer>),
-      error_(NS::Error::alloc()->init(NS::CocoaErrorDomain, 99, NS::Dictionary::dictionary()), refCopyingDeleter<NS::Error>),
-      size_({0, 0}), scale_(0.0), center_({0.0f, 0.0f}),
-      maxIterations_(0), initialized_(false) {
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Initializing metal...");
-    if (device_ == nullptr)
-        throw std::runtime_error("Unable to create device");
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                "Device name: %s",
-                device_->name()->cString(NS::UTF8StringEncoding));
-
-    initLibrary();
-    initFunction();
-    initComputePipeline();
-    initCommandQueue();
-
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Metal has been initialized");
+MandelbrotSetGenerator::MandelbrotSetGenerator(BackendType backend, unsigned threadCount)
+    : backend_(createBackend(backend, threadCount)), threadCount_(threadCount),
+      size_({0, 0}), scale_(0.0), center_(),
+      maxIterations_(0), precision_(Precision::Auto), deepZoom_(false), bulbCheck_(false), periodicityCheck_(false),
+      strategy_(RenderStrategy::PerPixel),
+      palette_(Palettes::byName("rainbow")), incremental_(false), autoIterations_(false), iterationsParams_(),
+      lastComputedPixels_(0), refinementStep_(0), nextLattice_(0) {
+    Log::info("Compute backend: {}", backend_->name());
 }
 
 void MandelbrotSetGenerator::setSize(const Eigen::Vector2i& size) {
     size_ = size;
-    initBuffersTextures();
 }
 
 void MandelbrotSetGenerator::setScale(float s) {
@@ -74,11 +95,25 @@ void MandelbrotSetGenerator::setScale(float s) {
 }
 
 void MandelbrotSetGenerator::setCenter(const Eigen::Vector2f& center) {
-    center_ = center;
+    center_ = {center[0], center[1]};
 }
 
 void MandelbrotSetGenerator::setMaxIterations(unsigned long maxIt) {
-    maxIterations_ = maxIt;
+    maxIterations_ = autoIterations_ ? AutoIterations::quantize(maxIt) : maxIt;
+}
+
+bool MandelbrotSetGenerator::autoIterations() const {
+    return autoIterations_;
+}
+
+void MandelbrotSetGenerator::setAutoIterations(bool enabled) {
+    autoIterations_ = enabled;
+    if (enabled)
+        maxIterations_ = AutoIterations::quantize(maxIterations_);
+}
+
+unsigned long MandelbrotSetGenerator::iterationsLimit() const {
+    return iterationsParams_.maxIterations;
 }
 
 Eigen::Vector2i MandelbrotSetGenerator::size() const {
@@ -86,169 +121,732 @@ Eigen::Vector2i MandelbrotSetGenerator::size() const {
 }
 
 float MandelbrotSetGenerator::scale() const {
-    return scale_;
+    return static_cast<float>(scale_);
 }
 
 Eigen::Vector2f MandelbrotSetGenerator::center() const {
-    return center_;
+    return {static_cast<float>(center_.x), static_cast<float>(center_.y)};
 }
 
 unsigned long MandelbrotSetGenerator::maxIterations() const {
     return maxIterations_;
 }
 
+PrecisePoint MandelbrotSetGenerator::preciseCenter() const {
+    return center_;
+}
+
+void MandelbrotSetGenerator::setPreciseCenter(const PrecisePoint& center) {
+    center_ = center;
+}
+
+double MandelbrotSetGenerator::preciseScale() const {
+    return scale_;
+}
+
+void MandelbrotSetGenerator::setPreciseScale(double s) {
+    scale_ = s;
+}
+
+Precision MandelbrotSetGenerator::precision() const {
+    return precision_;
+}
+
+void MandelbrotSetGenerator::setPrecision(Precision precision) {
+    precision_ = precision;
+}
+
+Precision MandelbrotSetGenerator::renderPrecision() const {
+    if (deepZoom_ && formula_.quadraticMandelbrot())
+        return Precision::DoubleDouble;
+    return precision_ == Precision::Auto ? Precisions::pick(center_, scale_, size_) : precision_;
+}
+
+bool MandelbrotSetGenerator::deepZoom() const {
+    return deepZoom_;
+}
+
+void MandelbrotSetGenerator::setDeepZoom(bool enabled) {
+    deepZoom_ = enabled;
+}
+
+bool MandelbrotSetGenerator::bulbCheck() const {
+    return bulbCheck_;
+}
+
+void MandelbrotSetGenerator::setBulbCheck(bool enabled) {
+    bulbCheck_ = enabled;
+}
+
+bool MandelbrotSetGenerator::periodicityCheck() const {
+    return periodicityCheck_;
+}
+
+void MandelbrotSetGenerator::setPeriodicityCheck(bool enabled) {
+    periodicityCheck_ = enabled;
+}
+
+const Formula& MandelbrotSetGenerator::formula() const {
+    return formula_;
+}
+
+void MandelbrotSetGenerator::setFormula(const Formula& formula) {
+    Formulas::validate(formula);
+    formula_ = formula;
+}
+
+RenderStrategy MandelbrotSetGenerator::renderStrategy() const {
+    return strategy_;
+}
+
+void MandelbrotSetGenerator::setRenderStrategy(RenderStrategy strategy) {
+    strategy_ = strategy;
+}
+
+const AntiAliasing& MandelbrotSetGenerator::antiAliasing() const {
+    return antiAliasing_;
+}
+
+void MandelbrotSetGenerator::setAntiAliasing(const AntiAliasing& antiAliasing) {
+    AntiAliasings::validate(antiAliasing);
+    antiAliasing_ = antiAliasing;
+}
+
+const ShortcutStats& MandelbrotSetGenerator::shortcutStats() const {
+    return shortcutStats_;
+}
+
+void MandelbrotSetGenerator::resetShortcutStats() {
+    shortcutStats_ = {};
+}
+
+const FrameMetrics& MandelbrotSetGenerator::metrics() const {
+    return metrics_;
+}
+
+void MandelbrotSetGenerator::resetMetrics() {
+    metrics_.clear();
+}
+
+const Palette& MandelbrotSetGenerator::palette() const {
+    return palette_;
+}
+
+void MandelbrotSetGenerator::setPalette(const Palette& palette) {
+    palette_ = palette;
+}
+
+bool MandelbrotSetGenerator::incremental() const {
+    return incremental_;
+}
+
+void MandelbrotSetGenerator::setIncremental(bool enabled) {
+    incremental_ = enabled;
+}
+
+void MandelbrotSetGenerator::pan(const Eigen::Vector2i& pixels) {
+    if (!valid())
+        throw std::runtime_error("Drawer wasn't properly initialized");
+    center_.x = center_.x + DoubleDouble(scale_) * static_cast<double>(pixels[0]) / static_cast<double>(size_[0]);
+    center_.y = center_.y + DoubleDouble(scale_) * static_cast<double>(pixels[1]) / static_cast<double>(size_[1]);
+}
+
+size_t MandelbrotSetGenerator::lastComputedPixels() const {
+    return lastComputedPixels_;
+}
+
+void MandelbrotSetGenerator::setStopToken(std::stop_token stop) {
+    stop_ = std::move(stop);
+}
+
+const char* MandelbrotSetGenerator::backendName() const {
+    return backend_->name();
+}
+
+CpuBackend* MandelbrotSetGenerator::cpuBackend() {
+    if (auto* cpu = dynamic_cast<CpuBackend*>(backend_.get()))
+        return cpu;
+    return fallback_.get();
+}
+
 bool MandelbrotSetGenerator::valid() const {
-    return initialized_ && size_[0] > 0 && size_[1] > 0 && maxIterations_ > 0;
-}
-
-void MandelbrotSetGenerator::initLibrary() {
-    // METALLIB is a path to binary compiled with macosx sdk and forwarded to C++ from CMake
-    auto libPath = NS::String::string(METALLIB, NS::UTF8StringEncoding);
-    if (libPath == nullptr)
-        throw std::runtime_error("Unable to create string");
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                "Path to metal library: %s",
-                libPath->cString(NS::UTF8StringEncoding));
-    auto url = NS::URL::fileURLWithPath(libPath);
-
-    NS::Error *errRawPtr = error_.get();
-    library_.reset(device_->newLibrary(url, &errRawPtr));
-    if (library_ == nullptr)
-        throw std::runtime_error(error_->localizedDescription()->utf8String());
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                "Library type: %ld",
-                library_->type());
-}
-
-void MandelbrotSetGenerator::initFunction() {
-    auto funcName = NS::String::string(functionName.c_str(), NS::UTF8StringEncoding);
-    if (funcName == nullptr)
-        throw std::runtime_error("Unable to create string");
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                "Function name: %s",
-                funcName->cString(NS::UTF8StringEncoding));
-    mandelbrotMetalFunc_.reset(library_->newFunction(funcName));
-    if (mandelbrotMetalFunc_ == nullptr)
-        throw std::runtime_error("Unable to create function");
-}
-
-void MandelbrotSetGenerator::initComputePipeline() {
-    NS::Error *errRawPtr = error_.get();
-    computePipeline_.reset(device_->newComputePipelineState(mandelbrotMetalFunc_.get(), &(errRawPtr)));
-    if (computePipeline_ == nullptr)
-        throw std::runtime_error(error_->localizedDescription()->utf8String());
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                "Thread execution width: %lu",
-                computePipeline_->threadExecutionWidth());
-}
-
-void MandelbrotSetGenerator::initCommandQueue() {
-    auto label = NS::String::string(functionName.c_str(), NS::UTF8StringEncoding);
-    if (label == nullptr)
-        throw std::runtime_error("Unable to create string");
-    commandQueue_.reset(device_->newCommandQueue());
-    if (commandQueue_ == nullptr)
-        throw std::runtime_error("Unable to create command queue");
-    commandQueue_->setLabel(label);
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION,
-                "Command queue label: %s",
-                commandQueue_->label()->cString(NS::UTF8StringEncoding));
-}
-
-using MTLTextureDescriptorPtr = std::unique_ptr<MTL::TextureDescriptor, std::function<void(MTL::TextureDescriptor*)>>;
-
-void MandelbrotSetGenerator::initBuffersTextures() {
-    MTLTextureDescriptorPtr textureDesc(MTL::TextureDescriptor::alloc()->init(), refDeleter<MTL::TextureDescriptor>);
-    if (textureDesc == nullptr)
-        throw std::bad_alloc();
-    textureDesc->setWidth(size_[0]);
-    textureDesc->setHeight(size_[1]);
-    textureDesc->setPixelFormat(MTL::PixelFormatRGBA8Uint);
-    textureDesc->setTextureType(MTL::TextureType2D);
-    textureDesc->setAllowGPUOptimizedContents(true);
-    textureDesc->setStorageMode(MTL::StorageModeManaged);
-    textureDesc->setUsage(MTL::ResourceUsageSample | MTL::ResourceUsageRead | MTL::ResourceUsageWrite);
-    texture_.reset(device_->newTexture(textureDesc.get()));
-    if (texture_ == nullptr)
-        throw std::bad_alloc();
-
-    positionBuffer_.reset(device_->newBuffer(sizeof(float) * 3, MTL::ResourceStorageModeManaged));
-    if (positionBuffer_ == nullptr)
-        throw std::bad_alloc();
-    maxItBuffer_.reset(device_->newBuffer(sizeof(unsigned long), MTL::ResourceStorageModeManaged));
-    if (maxItBuffer_ == nullptr)
-        throw std::bad_alloc();
-}
-
-void MandelbrotSetGenerator::setPositionBuffer() {
-    float* position = reinterpret_cast<float*>(positionBuffer_->contents());
-    position[0] = center_[0];
-    position[1] = center_[1];
-    position[2] = scale_;
-    positionBuffer_->didModifyRange(NS::Range::Make(0, sizeof(float) * 3));
-}
-
-void MandelbrotSetGenerator::setMaxItBuffer() {
-    unsigned long* maxIt = reinterpret_cast<unsigned long*>(maxItBuffer_->contents());
-    *maxIt = maxIterations_;
-    maxItBuffer_->didModifyRange(NS::Range::Make(0, sizeof(unsigned long)));
-}
-
-void MandelbrotSetGenerator::executeKernel() {
-    // Command buffer initialization
-    auto commandBuf = commandQueue_->commandBuffer();
-    if (commandBuf == nullptr)
-        throw std::runtime_error("Unable to get command buffer");
-    condAtomicFlag_.clear();
-    commandBuf->addCompletedHandler([&condAtomicFlag = condAtomicFlag_](MTL::CommandBuffer*) -> void {
-                                    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Notifying metal has completed computing");
-                                    condAtomicFlag.test_and_set();
-                                    condAtomicFlag.notify_one();
-                                    });
-
-    setPositionBuffer();
-    setMaxItBuffer();
-
-    // Put all the parameters to encoder and start execution of the kernel
-    auto computeEncoder = commandBuf->computeCommandEncoder();
-    if (computeEncoder == nullptr)
-        throw std::runtime_error("Unable to get compute command encoder");
-    computeEncoder->setComputePipelineState(computePipeline_.get());
-    computeEncoder->setTexture(texture_.get(), 0);
-    computeEncoder->setBuffer(positionBuffer_.get(), 0, 0);
-    computeEncoder->setBuffer(maxItBuffer_.get(), 0, 1);
-    MTL::Size gridSize(texture_->width(), texture_->height(), 1);
-    NS::UInteger threadCount = computePipeline_->maxTotalThreadsPerThreadgroup();
-    MTL::Size threadGroupSize(threadCount, 1, 1);
-    computeEncoder->dispatchThreads(gridSize, threadGroupSize);
-    computeEncoder->endEncoding();
-    commandBuf->commit();
-
-    // Waiting the computation is done
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Wait for metal finishes computing");
-    condAtomicFlag_.wait(false);
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Metal has finished computing");
+    return size_[0] > 0 && size_[1] > 0 && maxIterations_ > 0;
 }
 
 RawBufferPtr MandelbrotSetGenerator::getImage() {
-    // Lazy initialization and validity check
-    if (!initialized_) {
-        initBuffersTextures();
-        initialized_ = true;
+    computeIterations();
+    return colorize();
+}
+
+void MandelbrotSetGenerator::getImage(uint8_t* dst, size_t bytesPerRow) {
+    computeIterations();
+    colorize(dst, bytesPerRow);
+}
+
+void MandelbrotSetGenerator::computeIterations() {
+    if (!valid())
+        throw std::runtime_error("Drawer wasn't properly initialized");
+
+    const RenderParams params = renderParams();
+    supersamples_ = {};
+    if (!reuseIterations(params) && !loadTiles(params)) {
+        refinementStep_ = 0;
+        iterations_.resize(static_cast<size_t>(size_[0]) * size_[1]);
+        renderIterations({{0, 0}, size_}, iterations_.data(), size_[0]);
+        iterationsParams_ = params;
+        lastComputedPixels_ = iterations_.size();
     }
+    completeIterations();
+}
+
+void MandelbrotSetGenerator::startRefinement() {
     if (!valid())
         throw std::runtime_error("Drawer wasn't properly initialized");
 
-    executeKernel();
-    SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Texture parameters: width=%lu, height=%lu, bytesPerRow=%lu, bpp=%lu",
-                texture_->width(), texture_->height(),
-                texture_->bufferBytesPerRow(),
-                texture_->bufferBytesPerRow() / texture_->width());
-
-    // Preparing the result
-    size_t bytesPerRow = texture_->width() * 4;
-    size_t dataSize = bytesPerRow * texture_->height();
-    RawBufferPtr data(new uint8_t[dataSize], rawBufferDeleter);
-    texture_->getBytes(data.get(), bytesPerRow, MTL::Region(0, 0, texture_->width(), texture_->height()), 0);
+    const RenderParams params = renderParams();
+    supersamples_ = {};
+    if (reuseIterations(params) || loadTiles(params)) {
+        completeIterations();
+        return;
+    }
+
+    iterations_.resize(static_cast<size_t>(size_[0]) * size_[1]);
+    samples_.resize(iterations_.size());
+    iterationsParams_ = params;
+    lastComputedPixels_ = 0;
+    refinementStep_ = coarsestStep * 2;
+}
+
+bool MandelbrotSetGenerator::refine() {
+    if (refinementStep_ == 0)
+        return false;
+
+    // The first pass takes every coarsestStep-th pixel, every next one halves the step and
+    // adds the 3 missing samples of each 2x2 cell of the previous grid
+    const int step = refinementStep_ / 2;
+    const bool firstPass = step >= coarsestStep;
+    const Eigen::Vector2i offsets[] = {{step, 0}, {0, step}, {step, step}, {0, 0}};
+    const int gridStep = firstPass ? step : step * 2;
+
+    const int width = size_[0];
+    for (const Eigen::Vector2i& offset : firstPass ? std::span(offsets).last(1) : std::span(offsets).first(3)) {
+        const Eigen::Vector2i count = ((size_ - offset).array() + gridStep - 1) / gridStep;
+        if ((count.array() <= 0).any())
+            continue;
+        band_.resize(static_cast<size_t>(count[0]) * count[1]);
+        renderIterations({offset, count, gridStep}, band_.data(), count[0]);
+        for (int j = 0; j < count[1]; ++j) {
+            float* row = samples_.data() + static_cast<size_t>(offset[1] + j * gridStep) * width + offset[0];
+            for (int i = 0; i < count[0]; ++i)
+                row[i * gridStep] = band_[static_cast<size_t>(j) * count[0] + i];
+        }
+        lastComputedPixels_ += static_cast<size_t>(count[0]) * count[1];
+    }
+
+    // Every pixel shows the sample of its step x step cell until the cell is refined
+    for (int y = 0; y < size_[1]; ++y) {
+        const float* src = samples_.data() + static_cast<size_t>(y - y % step) * width;
+        float* dst = iterations_.data() + static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; ++x)
+            dst[x] = src[x - x % step];
+    }
+
+    refinementStep_ = step == 1 ? 0 : step;
+    if (refinementStep_ == 0)
+        completeIterations();
+    return refinementStep_ != 0;
+}
+
+// Everything which follows once iterations_ hold the whole image. Supersamples aren't cached with
+// the tiles, they are cheap next to the pixels and depend on the anti-aliasing settings.
+void MandelbrotSetGenerator::completeIterations() {
+    adaptIterations();
+    storeTiles(iterationsParams_);
+    supersample(iterations_.data(), {0, 0}, size_, size_[0], iterationsParams_.maxIterations, {{0, 0}, size_},
+                supersamples_);
+}
+
+// Runs on complete iterations only, progressive passes are too coarse for the statistics
+void MandelbrotSetGenerator::adaptIterations() {
+    if (!autoIterations_)
+        return;
+    const unsigned long start = iterationsParams_.maxIterations;
+    IterationHistogram histogram(iterations_.data(), iterations_.size(), start);
+    auto raise = [&]() {
+        raiseIterations(iterationsParams_.maxIterations * 2);
+        histogram = IterationHistogram(iterations_.data(), iterations_.size(), iterationsParams_.maxIterations);
+    };
+    for (int i = 0; i < AutoIterations::blankRaises && histogram.escaped() == 0 &&
+                    iterationsParams_.maxIterations < AutoIterations::maximum; ++i)
+        raise();
+    while (AutoIterations::shouldRaise(histogram, iterationsParams_.maxIterations))
+        raise();
+    // The next render starts from the lowest limit this one justifies, a view where nothing escapes tells nothing
+    maxIterations_ = histogram.escaped() == 0 ? start : AutoIterations::lowest(histogram, iterationsParams_.maxIterations);
+}
+
+// Escaped pixels don't depend on the limit, only blocks holding capped ones are rendered again
+void MandelbrotSetGenerator::raiseIterations(unsigned long limit) {
+    const float capped = static_cast<float>(iterationsParams_.maxIterations);
+    maxIterations_ = limit;
+    const int width = size_[0];
+    const int height = size_[1];
+    for (int by = 0; by < height; by += autoBlockSize) {
+        const int rows = std::min(autoBlockSize, height - by);
+        // Blocks next to each other are rendered as one region
+        auto render = [&](int x0, int x1) {
+            renderIterations({{x0, by}, {x1 - x0, rows}}, iterations_.data() + static_cast<size_t>(by) * width + x0, width);
+            lastComputedPixels_ += static_cast<size_t>(x1 - x0) * rows;
+        };
+        int runStart = -1;
+        for (int bx = 0; bx < width; bx += autoBlockSize) {
+            const int columns = std::min(autoBlockSize, width - bx);
+            bool hasCapped = false;
+            for (int y = by; !hasCapped && y < by + rows; ++y) {
+                const float* row = iterations_.data() + static_cast<size_t>(y) * width + bx;
+                hasCapped = std::any_of(row, row + columns, [capped](float value) { return value >= capped; });
+            }
+            if (hasCapped && runStart < 0) {
+                runStart = bx;
+            } else if (!hasCapped && runStart >= 0) {
+                render(runStart, bx);
+                runStart = -1;
+            }
+        }
+        if (runStart >= 0)
+            render(runStart, width);
+    }
+    iterationsParams_ = renderParams();
+}
+
+int MandelbrotSetGenerator::refinementStep() const {
+    return refinementStep_ / 2;
+}
+
+// Shifts the kept iterations in incremental mode, false if they aren't on the pixel grid of `params`
+bool MandelbrotSetGenerator::reuseIterations(const RenderParams& params) {
+    // A progressive render which hasn't finished leaves only a coarse image behind
+    if (!incremental_ || iterations_.empty() || refinementStep_ != 0)
+        return false;
+    const auto offset = gridOffset(iterationsParams_, params);
+    if (!offset)
+        return false;
+    shiftIterations(*offset, params);
+    iterationsParams_ = params;
+    return true;
+}
+
+// offset is the position of the new view in pixels of the kept one
+void MandelbrotSetGenerator::shiftIterations(const Eigen::Vector2i& offset, const RenderParams& params) {
+    const int width = size_[0];
+    const int height = size_[1];
+    lastComputedPixels_ = 0;
+    if (offset.isZero())
+        return;
+
+    // Columns [x0, x1) and rows [y0, y1) of the new view are covered by the old one
+    const int x0 = std::max(0, -offset[0]);
+    const int x1 = std::min(width, width - offset[0]);
+    const int y0 = std::max(0, -offset[1]);
+    const int y1 = std::min(height, height - offset[1]);
+    spare_.resize(iterations_.size());
+    for (int y = y0; y < y1; ++y) {
+        const float* src = iterations_.data() + static_cast<size_t>(y + offset[1]) * width + x0 + offset[0];
+        std::copy_n(src, x1 - x0, spare_.data() + static_cast<size_t>(y) * width + x0);
+    }
+    std::swap(iterations_, spare_);
+
+    std::vector<RenderRegion> exposed;
+    if (y0 > 0)
+        exposed.push_back({{0, 0}, {width, y0}});
+    if (y1 < height)
+        exposed.push_back({{0, y1}, {width, height - y1}});
+    if (x0 > 0)
+        exposed.push_back({{0, y0}, {x0, y1 - y0}});
+    if (x1 < width)
+        exposed.push_back({{x1, y0}, {width - x1, y1 - y0}});
+    for (const RenderRegion& region : exposed) {
+        // Panning back shows what was seen before, it's likely cached
+        if (tileCache_ != nullptr) {
+            fillFromTiles(latticeOf(params), region, false);
+            continue;
+        }
+        float* dst = iterations_.data() + static_cast<size_t>(region.origin[1]) * width + region.origin[0];
+        renderIterations(region, dst, width);
+        lastComputedPixels_ += static_cast<size_t>(region.size[0]) * region.size[1];
+    }
+}
+
+void MandelbrotSetGenerator::setTileCacheCapacity(size_t bytes) {
+    if (bytes == 0) {
+        tileCache_.reset();
+        lattices_.clear();
+    } else if (tileCache_ == nullptr) {
+        tileCache_ = std::make_unique<TileCache>(cacheTileSize, bytes);
+    } else {
+        tileCache_->setCapacity(bytes);
+    }
+}
+
+TileCacheStats MandelbrotSetGenerator::tileCacheStats() const {
+    return tileCache_ == nullptr ? TileCacheStats{} : tileCache_->stats();
+}
+
+// Views sharing a lattice have their pixels at exactly the same points, so they can share tiles
+MandelbrotSetGenerator::LatticePosition MandelbrotSetGenerator::latticeOf(const RenderParams& params) {
+    for (auto it = lattices_.begin(); it != lattices_.end(); ++it) {
+        const auto offset = latticeOffset(it->params, params);
+        if (!offset)
+            continue;
+        const LatticePosition position{it->id, *offset};
+        std::rotate(it, it + 1, lattices_.end());
+        return position;
+    }
+    // Tiles of a forgotten lattice are unreachable, the cache evicts them in time
+    if (lattices_.size() == maxLattices)
+        lattices_.erase(lattices_.begin());
+    lattices_.push_back({params, nextLattice_});
+    return {nextLattice_++, {0, 0}};
+}
+
+// Calls func(tile, part of the tile inside of the region, view pixel of that part) for every tile the region
+// of the view touches
+template<typename Func>
+void MandelbrotSetGenerator::forEachTile(const LatticePosition& position, const RenderRegion& region,
+                                         Func&& func) const {
+    const int tileSize = cacheTileSize;
+    const Eigen::Vector2i begin = position.offset + region.origin;
+    const Eigen::Vector2i end = begin + region.size;
+    for (int ty = floorDiv(begin[1], tileSize); ty <= floorDiv(end[1] - 1, tileSize); ++ty) {
+        for (int tx = floorDiv(begin[0], tileSize); tx <= floorDiv(end[0] - 1, tileSize); ++tx) {
+            const Eigen::Vector2i tileOrigin = Eigen::Vector2i(tx, ty) * tileSize;
+            const Eigen::Vector2i partBegin = tileOrigin.cwiseMax(begin);
+            const Eigen::Vector2i partEnd = (tileOrigin.array() + tileSize).matrix().cwiseMin(end);
+            func(Eigen::Vector2i(tx, ty), TileCache::Rect{partBegin - tileOrigin, partEnd - partBegin},
+                 Eigen::Vector2i(partBegin - position.offset));
+        }
+    }
+}
+
+// Copies the cached tiles of `region` into iterations_ and computes the rest.
+// With `requireHit` nothing is computed and false is returned when no tile was cached.
+bool MandelbrotSetGenerator::fillFromTiles(const LatticePosition& position, const RenderRegion& region,
+                                           bool requireHit) {
+    const int width = size_[0];
+    std::vector<RenderRegion> missing;
+    bool hit = false;
+    forEachTile(position, region, [&](const Eigen::Vector2i& tile, const TileCache::Rect& rect,
+                                      const Eigen::Vector2i& view) {
+        float* dst = iterations_.data() + static_cast<size_t>(view[1]) * width + view[0];
+        if (!tileCache_->find({position.id, tile}, rect, dst, width)) {
+            // Missing tiles next to each other in a row are computed as one region
+            if (!missing.empty() && missing.back().origin[1] == view[1] &&
+                missing.back().origin[0] + missing.back().size[0] == view[0])
+                missing.back().size[0] += rect.size[0];
+            else
+                missing.push_back({view, rect.size});
+            return;
+        }
+        hit = true;
+    });
+    if (requireHit && !hit)
+        return false;
+
+    for (const RenderRegion& part : missing) {
+        float* dst = iterations_.data() + static_cast<size_t>(part.origin[1]) * width + part.origin[0];
+        renderIterations(part, dst, width);
+        lastComputedPixels_ += static_cast<size_t>(part.size[0]) * part.size[1];
+    }
+    return true;
+}
+
+// Assembles the view from cached tiles, false if none of them was cached
+bool MandelbrotSetGenerator::loadTiles(const RenderParams& params) {
+    if (tileCache_ == nullptr)
+        return false;
+    iterations_.resize(static_cast<size_t>(size_[0]) * size_[1]);
+    refinementStep_ = 0;
+    lastComputedPixels_ = 0;
+    if (!fillFromTiles(latticeOf(params), {{0, 0}, size_}, true))
+        return false;
+    iterationsParams_ = params;
+    return true;
+}
+
+void MandelbrotSetGenerator::storeTiles(const RenderParams& params) {
+    if (tileCache_ == nullptr)
+        return;
+    const LatticePosition position = latticeOf(params);
+    const int width = size_[0];
+    tile_.resize(static_cast<size_t>(cacheTileSize) * cacheTileSize);
+    forEachTile(position, {{0, 0}, size_}, [&](const Eigen::Vector2i& tile, const TileCache::Rect& rect, const Eigen::Vector2i& view) {
+        for (int y = 0; y < rect.size[1]; ++y)
+            std::copy_n(iterations_.data() + static_cast<size_t>(view[1] + y) * width + view[0], rect.size[0],
+                        tile_.data() + static_cast<size_t>(rect.origin[1] + y) * cacheTileSize + rect.origin[0]);
+        tileCache_->insert({position.id, tile}, rect, tile_.data(), params.maxIterations);
+    });
+}
+
+const std::vector<float>& MandelbrotSetGenerator::iterations() const {
+    return iterations_;
+}
+
+CompressedIterations MandelbrotSetGenerator::compressedIterations() const {
+    if (iterations_.empty())
+        throw std::runtime_error("Nothing has been computed yet");
+    return CompressedIterations(iterations_.data(), iterationsParams_.size, static_cast<size_t>(iterationsParams_.size[0]),
+                                iterationsParams_.maxIterations);
+}
+
+RawBufferPtr MandelbrotSetGenerator::colorize() const {
+    if (iterations_.empty())
+        throw std::runtime_error("Nothing has been computed yet");
+
+    RawBufferPtr data(new uint8_t[iterations_.size() * 4], rawBufferDeleter);
+    colorize(data.get(), static_cast<size_t>(iterationsParams_.size[0]) * 4);
     return data;
 }
+
+void MandelbrotSetGenerator::colorize(uint8_t* dst, size_t bytesPerRow) const {
+    if (iterations_.empty())
+        throw std::runtime_error("Nothing has been computed yet");
+    const StageTimer timer(metrics_, FrameStage::Colorize);
+    const size_t width = static_cast<size_t>(iterationsParams_.size[0]);
+    if (bytesPerRow == width * 4) {
+        palette_.colorize(iterations_.data(), iterations_.size(), iterationsParams_.maxIterations, dst);
+    } else {
+        for (int y = 0; y < iterationsParams_.size[1]; ++y)
+            palette_.colorize(iterations_.data() + y * width, width, iterationsParams_.maxIterations,
+                              dst + y * bytesPerRow);
+    }
+    applySupersamples(supersamples_, {0, 0}, iterationsParams_.maxIterations, dst, bytesPerRow);
+}
+
+void MandelbrotSetGenerator::saveSnapshot(const std::string& path) const {
+    // A coarse pass isn't worth keeping
+    if (iterations_.empty() || refinementStep_ != 0)
+        throw std::runtime_error("Nothing has been computed yet");
+    SnapshotWriter writer(path, snapshotViewOf(iterationsParams_));
+    writer.writeRows(iterations_.data(), static_cast<size_t>(iterationsParams_.size[0]), iterationsParams_.size[1]);
+    writer.finish();
+}
+
+SnapshotView MandelbrotSetGenerator::snapshotView() const {
+    return snapshotViewOf(renderParams());
+}
+
+void MandelbrotSetGenerator::renderIterations(const RenderRegion& region, float* dst, size_t valuesPerRow) {
+    if (!valid())
+        throw std::runtime_error("Drawer wasn't properly initialized");
+    if (region.step < 1 || (region.origin.array() < 0).any() || (region.size.array() <= 0).any() ||
+        (region.origin + (region.size.array() - 1).matrix() * region.step - size_).maxCoeff() >= 0)
+        throw std::out_of_range("Region is out of the image");
+
+    const RenderParams params = renderParams();
+    ComputeBackend& backend = backendFor(params);
+    const double startUs = Metrics::nowUs();
+    backend.render(params, region, dst, valuesPerRow);
+    finishRender(backend, startUs, region, dst, valuesPerRow);
+}
+
+// Cancellation, metrics and shortcut counters of a backend call which wrote `region` into values
+void MandelbrotSetGenerator::finishRender(const ComputeBackend& backend, double startUs, const RenderRegion& region,
+                                          const float* values, size_t valuesPerRow) {
+    if (stop_.stop_requested()) {
+        // Whatever was kept is incomplete now
+        iterations_.clear();
+        supersamples_ = {};
+        refinementStep_ = 0;
+        throw RenderCancelled();
+    }
+
+    recordRender(backend, startUs, region, values, valuesPerRow);
+    const ShortcutStats& stats = backend.shortcutStats();
+    shortcutStats_.pixels += stats.pixels;
+    shortcutStats_.bulbs += stats.bulbs;
+    shortcutStats_.periodic += stats.periodic;
+    shortcutStats_.filled += stats.filled;
+}
+
+// The backend stages ran one after another from startUs
+void MandelbrotSetGenerator::recordRender(const ComputeBackend& backend, double startUs, const RenderRegion& region,
+                                          const float* values, size_t valuesPerRow) {
+    const RenderTimings& timings = backend.timings();
+    double atUs = startUs;
+    for (const auto& [stage, ms] : {std::pair{FrameStage::Dispatch, timings.dispatchMs},
+                                    std::pair{FrameStage::Compute, timings.computeMs},
+                                    std::pair{FrameStage::Readback, timings.readbackMs}}) {
+        if (ms <= 0.0)
+            continue;
+        metrics_.addSpan(stage, atUs, ms * 1000.0);
+        atUs += ms * 1000.0;
+    }
+    if (!timings.workerBusyMs.empty()) {
+        if (metrics_.workerBusyMs.size() < timings.workerBusyMs.size())
+            metrics_.workerBusyMs.resize(timings.workerBusyMs.size(), 0.0);
+        for (size_t i = 0; i < timings.workerBusyMs.size(); ++i)
+            metrics_.workerBusyMs[i] += timings.workerBusyMs[i];
+        metrics_.workerWallMs += timings.computeMs;
+    }
+
+    const float limit = static_cast<float>(maxIterations_);
+    size_t interior = 0;
+    double iterations = 0.0;
+    for (int y = 0; y < region.size[1]; ++y) {
+        const float* row = values + y * valuesPerRow;
+        for (int x = 0; x < region.size[0]; ++x) {
+            interior += row[x] >= limit;
+            iterations += row[x];
+        }
+    }
+    const size_t pixels = static_cast<size_t>(region.size[0]) * region.size[1];
+    metrics_.interiorPixels += interior;
+    metrics_.escapedPixels += pixels - interior;
+    metrics_.iterations += iterations;
+}
+
+void MandelbrotSetGenerator::render(const RenderRegion& region, uint8_t* dst, size_t bytesPerRow) {
+    if (!antiAliasing_.enabled() || region.step != 1) {
+        const size_t width = static_cast<size_t>(region.size[0]);
+        band_.resize(width * region.size[1]);
+        renderIterations(region, band_.data(), width);
+        const StageTimer timer(metrics_, FrameStage::Colorize);
+        for (int y = 0; y < region.size[1]; ++y)
+            palette_.colorize(band_.data() + y * width, width, maxIterations_, dst + y * bytesPerRow);
+        return;
+    }
+
+    // One more pixel around the region, so the pixels on its edges see all their neighbours
+    const Eigen::Vector2i from = (region.origin.array() - 1).max(0);
+    const Eigen::Vector2i to = (region.origin + region.size).array().min(size_.array() - 1) + 1;
+    const Eigen::Vector2i bandSize = to - from;
+    const size_t width = static_cast<size_t>(bandSize[0]);
+    band_.resize(width * bandSize[1]);
+    renderIterations({from, bandSize}, band_.data(), width);
+    const Eigen::Vector2i inner = region.origin - from;
+    supersample(band_.data(), from, bandSize, width, maxIterations_, {inner, region.size}, bandSupersamples_);
+
+    const StageTimer timer(metrics_, FrameStage::Colorize);
+    for (int y = 0; y < region.size[1]; ++y)
+        palette_.colorize(band_.data() + (inner[1] + y) * width + inner[0], region.size[0], maxIterations_,
+                          dst + y * bytesPerRow);
+    applySupersamples(bandSupersamples_, region.origin, maxIterations_, dst, bytesPerRow);
+}
+
+void MandelbrotSetGenerator::supersample(const float* values, const Eigen::Vector2i& origin, const Eigen::Vector2i& size,
+                                         size_t valuesPerRow, unsigned long maxIterations, const RenderRegion& inner,
+                                         Supersamples& samples) {
+    samples.pixels.clear();
+    samples.values.clear();
+    samples.count = static_cast<size_t>(antiAliasing_.samples);
+    if (!antiAliasing_.enabled())
+        return;
+    AntiAliasings::detect(antiAliasing_, values, size, valuesPerRow, maxIterations, inner.origin, inner.size,
+                          samples.pixels);
+    if (samples.pixels.empty())
+        return;
+
+    const size_t count = samples.count;
+    samples.values.resize(samples.pixels.size() * count);
+    RenderParams params = renderParams();
+    params.maxIterations = maxIterations;
+    // Computes the queued samples and puts them into samples.values
+    auto renderQueued = [&]() {
+        if (samplePositions_.empty())
+            return;
+        sampleValues_.resize(samplePositions_.size());
+        CpuBackend& backend = pointBackend();
+        const double startUs = Metrics::nowUs();
+        backend.renderPoints(params, samplePositions_.data(), samplePositions_.size(), sampleValues_.data());
+        finishRender(backend, startUs, {{0, 0}, {static_cast<int>(sampleValues_.size()), 1}}, sampleValues_.data(),
+                     sampleValues_.size());
+        for (size_t i = 0; i < sampleTargets_.size(); ++i)
+            samples.values[sampleTargets_[i]] = sampleValues_[i];
+        samplePositions_.clear();
+        sampleTargets_.clear();
+    };
+
+    const std::vector<int> first = AntiAliasings::firstSamples(antiAliasing_);
+    for (size_t i = 0; i < samples.pixels.size(); ++i) {
+        for (int k : first) {
+            samplePositions_.push_back(AntiAliasings::samplePosition(antiAliasing_, samples.pixels[i] + origin, k));
+            sampleTargets_.push_back(i * count + static_cast<size_t>(k));
+        }
+    }
+    renderQueued();
+
+    if (first.size() < count) {
+        std::vector<float> corners(first.size());
+        for (size_t i = 0; i < samples.pixels.size(); ++i) {
+            float* pixelValues = samples.values.data() + i * count;
+            for (size_t j = 0; j < first.size(); ++j)
+                corners[j] = pixelValues[first[j]];
+            const Eigen::Vector2i& pixel = samples.pixels[i];
+            if (AntiAliasings::uniform(antiAliasing_, values[pixel[1] * valuesPerRow + pixel[0]], corners.data(),
+                                       corners.size(), maxIterations)) {
+                // Nothing but an edge next to the pixel, the corners stand for the whole grid
+                for (size_t k = 0; k < count; ++k)
+                    pixelValues[k] = corners[k % corners.size()];
+                continue;
+            }
+            for (size_t k = 0; k < count; ++k) {
+                if (std::find(first.begin(), first.end(), static_cast<int>(k)) != first.end())
+                    continue;
+                samplePositions_.push_back(AntiAliasings::samplePosition(antiAliasing_, pixel + origin, static_cast<int>(k)));
+                sampleTargets_.push_back(i * count + k);
+            }
+        }
+        renderQueued();
+    }
+
+    for (Eigen::Vector2i& pixel : samples.pixels)
+        pixel += origin;
+    metrics_.supersampledPixels += samples.pixels.size();
+}
+
+// Box filter: the colors of a pixel's samples are averaged
+void MandelbrotSetGenerator::applySupersamples(const Supersamples& samples, const Eigen::Vector2i& origin,
+                                               unsigned long maxIterations, uint8_t* dst, size_t bytesPerRow) const {
+    const size_t count = samples.count;
+    if (samples.pixels.empty())
+        return;
+    std::vector<uint8_t> colors(count * 4);
+    for (size_t i = 0; i < samples.pixels.size(); ++i) {
+        palette_.colorize(samples.values.data() + i * count, count, maxIterations, colors.data());
+        const Eigen::Vector2i pixel = samples.pixels[i] - origin;
+        uint8_t* out = dst + pixel[1] * bytesPerRow + static_cast<size_t>(pixel[0]) * 4;
+        for (size_t channel = 0; channel < 4; ++channel) {
+            unsigned sum = 0;
+            for (size_t k = 0; k < count; ++k)
+                sum += colors[k * 4 + channel];
+            out[channel] = static_cast<uint8_t>((sum + count / 2) / count);
+        }
+    }
+}
+
+RenderParams MandelbrotSetGenerator::renderParams() const {
+    // Perturbation is derived for z^2 + c, the other formulas have a double-double loop
+    const Precision precision = renderPrecision();
+    const bool deep = precision == Precision::DoubleDouble && formula_.quadraticMandelbrot();
+    return {size_, center(), scale(), maxIterations_, center_, scale_, deep, precision,
+            bulbCheck_, periodicityCheck_, formula_, strategy_, stop_};
+}
+
+// Scattered points are a CPU backend feature
+CpuBackend& MandelbrotSetGenerator::pointBackend() {
+    if (auto* cpu = dynamic_cast<CpuBackend*>(backend_.get()))
+        return *cpu;
+    if (!fallback_)
+        fallback_ = std::make_unique<CpuBackend>(threadCount_);
+    return *fallback_;
+}
+
+ComputeBackend& MandelbrotSetGenerator::backendFor(const RenderParams& params) {
+    if (backend_->supports(params))
+        return *backend_;
+    if (!fallback_) {
+        Log::info("{} backend can't render this view, falling back to CPU", backend_->name());
+        fallback_ = std::make_unique<CpuBackend>(threadCount_);
+    }
+    return *fallback_;
+}
@@ -1,39 +1,41 @@
 #pragma once
 
-#include <atomic>
+#include "AntiAliasing.hpp"
+#include "CompressedIterations.hpp"
+#include "ComputeBackend.hpp"
+#include "CpuBackend.hpp"
+#include "FrameMetrics.hpp"
+#include "IterationSnapshot.hpp"
+#include "Palette.hpp"
+#include "TileCache.hpp"
+
 #include <memory>
 #include <functional>
+#include <stdexcept>
+#include <stop_token>
+#include <string>
+#include <vector>
 #include <Eigen/Dense>
 
-namespace MTL {
-    class Device;
-    class CommandQueue;
-    class Library;
-    class ComputePipelineState;
-    class Texture;
-    class Function;
-    class Buffer;
-} // namespace MTL
-
-using MTLDevicePtr = std::unique_ptr<MTL::Device, std::function<void(MTL::Device*)>>;
-using MTLCommandQueuePtr = std::unique_ptr<MTL::CommandQueue, std::function<void(MTL::CommandQueue*)>>;
-using MTLLibraryPtr = std::unique_ptr<MTL::Library, std::function<void(MTL::Library*)>>;
-using MTLComputePipelineStatePtr = std::unique_ptr<MTL::ComputePipelineState, std::function<void(MTL::ComputePipelineState*)>>;
-using MTLTexturePtr = std::unique_ptr<MTL::Texture, std::function<void(MTL::Texture*)>>;
-using MTLFunctionPtr = std::unique_ptr<MTL::Function, std::function<void(MTL::Function*)>>;
-using MTLBufferPtr = std::unique_ptr<MTL::Buffer, std::function<void(MTL::Buffer*)>>;
 using RawBufferPtr = std::unique_ptr<uint8_t, std::function<void(uint8_t*)>>;
 
-namespace NS {
-    class Error;
-} // namespace NS
+// Thrown by the render calls when the stop token of the generator was triggered
+class RenderCancelled : public std::runtime_error {
+public:
+    RenderCancelled() : std::runtime_error("Render was cancelled") {}
+};
 
-using NSErrorPtr = std::unique_ptr<NS::Error, std::function<void(NS::Error*)>>;
+enum class BackendType {
+    Default, // Metal when it is compiled in, CPU otherwise
+    Cpu,
+    Metal
+};
 
 class MandelbrotSetGenerator final
 {
 public:
-    MandelbrotSetGenerator();
+    explicit MandelbrotSetGenerator(BackendType backend = BackendType::Default,
+                                    unsigned threadCount = std::thread::hardware_concurrency());
     ~MandelbrotSetGenerator() = default;
 
     Eigen::Vector2i size() const;
@@ -42,35 +44,191 @@ public:
     void setScale(float s);
     Eigen::Vector2f center() const;
     void setCenter(const Eigen::Vector2f& center);
+    // In auto mode the limit of the next render, which may differ from iterationsLimit()
     unsigned long maxIterations() const;
     void setMaxIterations(unsigned long maxIt);
+    // Auto mode picks maxIterations from the escape times of the last complete render, see AutoIterations.
+    // While many pixels escape close to the limit it's doubled right away and only the blocks with capped
+    // pixels are rendered again. setMaxIterations() gives the starting point.
+    bool autoIterations() const;
+    void setAutoIterations(bool enabled);
+    // Limit the kept iterations were computed with
+    unsigned long iterationsLimit() const;
+    // Full precision view, float getters/setters above are rounded versions of it
+    PrecisePoint preciseCenter() const;
+    void setPreciseCenter(const PrecisePoint& center);
+    double preciseScale() const;
+    void setPreciseScale(double s);
+    // Number type of the escape loop. Auto (the default) picks the cheapest one which resolves a pixel of the
+    // current view, so zooming goes from float to double to double-double on its own. The double-double tier
+    // of z^2 + c is perturbation rendering, the other formulas iterate in double-double. Backends without
+    // double support hand the work over to the CPU backend.
+    Precision precision() const;
+    void setPrecision(Precision precision);
+    // Precision the next render uses, never Auto
+    Precision renderPrecision() const;
+    // Perturbation rendering around a double-double reference orbit whatever the precision, z^2 + c only
+    bool deepZoom() const;
+    void setDeepZoom(bool enabled);
+    // Interior shortcuts: the main cardioid/period-2 bulb test and periodicity checking, both off by default
+    bool bulbCheck() const;
+    void setBulbCheck(bool enabled);
+    bool periodicityCheck() const;
+    void setPeriodicityCheck(bool enabled);
+    // Fractal to render, Mandelbrot z^2 + c by default. Every formula and power runs its own compiled
+    // loop on the CPU and the GPU. Deep zoom and the bulb check apply to z^2 + c only.
+    const Formula& formula() const;
+    void setFormula(const Formula& formula);
+    // RenderStrategy::BoundaryTrace computes only the borders of rectangles and fills the ones with a
+    // uniform border. Escaped bands are filled by interpolation, so the counts differ slightly from
+    // PerPixel ones, and isolated escaped pixels inside an interior border may be filled as interior.
+    // Backends which can't trace (Metal) compute every pixel anyway.
+    RenderStrategy renderStrategy() const;
+    void setRenderStrategy(RenderStrategy strategy);
+    // Adaptive supersampling of the pixels next to large iteration differences. Their samples are kept
+    // with the iterations, colorize() averages the sample colors in whatever palette is set. Samples are
+    // computed by the CPU backend, whichever backend renders the pixels.
+    const AntiAliasing& antiAliasing() const;
+    void setAntiAliasing(const AntiAliasing& antiAliasing);
+    // Pixels resolved by the shortcuts and filled by the boundary tracer, summed over all renders since the last reset
+    const ShortcutStats& shortcutStats() const;
+    void resetShortcutStats();
+    // Colors of the iteration counts, changing it needs only colorize(), not a new render
+    const Palette& palette() const;
+    void setPalette(const Palette& palette);
+    // Keeps the last iterations when the view moves by whole pixels and computes only the exposed strips
+    bool incremental() const;
+    void setIncremental(bool enabled);
+    // Moves the center by whole pixels, which keeps the view on the grid of the kept iterations
+    void pan(const Eigen::Vector2i& pixels);
+    // Pixels computed by the last computeIterations(), the rest was reused
+    size_t lastComputedPixels() const;
+    // Keeps computed iterations in an LRU cache of tiles on the pixel grid of the view, so views seen
+    // before (zooming back out, panning back) are assembled from tiles instead of recomputed. 0 disables it.
+    void setTileCacheCapacity(size_t bytes);
+    TileCacheStats tileCacheStats() const;
+    // Stage timings, pixel counts and worker utilization of everything rendered and colorized since the last reset
+    const FrameMetrics& metrics() const;
+    void resetMetrics();
+    // Renders started after the token is triggered throw RenderCancelled, kept iterations are dropped
+    void setStopToken(std::stop_token stop);
+    const char* backendName() const;
+    // Tile size and per tile timings of the CPU path, nullptr until something runs on the CPU
+    CpuBackend* cpuBackend();
 
     bool valid() const;
+    // computeIterations() followed by colorize()
     RawBufferPtr getImage();
+    // Same into caller's rows, e.g. locked texture memory, so nothing is allocated per frame
+    void getImage(uint8_t* dst, size_t bytesPerRow);
+    // Smooth iteration counts of the whole image, kept by the generator for recoloring
+    void computeIterations();
+    const std::vector<float>& iterations() const;
+    // Same, several times smaller, for holding many frames, see CompressedIterations
+    CompressedIterations compressedIterations() const;
+    // Progressive mode: startRefinement() sets the view up, every refine() computes one more pass
+    // (1/16, 1/4, then the rest of the pixels, reusing the samples of the previous passes) and
+    // leaves a complete, coarse until the last pass, image in iterations(). It returns false
+    // when the image is final. A whole pixel pan in incremental mode is finished right away.
+    void startRefinement();
+    bool refine();
+    // Pixel step of the pass refine() will compute next, 0 when nothing is left
+    int refinementStep() const;
+    // RGBA8 image of the last computed iterations in the current palette, no orbit is recomputed
+    RawBufferPtr colorize() const;
+    // Same into caller's memory of size()[1] rows, bytesPerRow may include padding
+    void colorize(uint8_t* dst, size_t bytesPerRow) const;
+    // Kept iterations and their view as an IterationSnapshot file, to be recolored without recomputing
+    void saveSnapshot(const std::string& path) const;
+    // View of the next render, for a SnapshotWriter of the bands of renderIterations()
+    SnapshotView snapshotView() const;
+    // Renders only `region` of the image into caller's memory, used to stream huge images by bands
+    void renderIterations(const RenderRegion& region, float* dst, size_t valuesPerRow);
+    void render(const RenderRegion& region, uint8_t* dst, size_t bytesPerRow);
 private:
-    void initLibrary();
-    void initFunction();
-    void initComputePipeline();
-    void initCommandQueue();
-    void initBuffersTextures();
+    // Extra samples of the pixels flagged by AntiAliasings::detect(), `count` per pixel
+    struct Supersamples {
+        std::vector<Eigen::Vector2i> pixels; // in image pixels
+        std::vector<float> values;
+        size_t count = 0; // antiAliasing_.samples when they were computed, it may have changed since
+    };
 
-    void setPositionBuffer();
-    void setMaxItBuffer();
-    void executeKernel();
-private:
-    MTLDevicePtr device_;
-    MTLLibraryPtr library_;
-    MTLFunctionPtr mandelbrotMetalFunc_;
-    MTLComputePipelineStatePtr computePipeline_;
-    MTLCommandQueuePtr commandQueue_;
-    MTLTexturePtr texture_;
-    MTLBufferPtr positionBuffer_;
-    MTLBufferPtr maxItBuffer_;
-    NSErrorPtr error_;
-    std::atomic_flag condAtomicFlag_;
+    RenderParams renderParams() const;
+    ComputeBackend& backendFor(const RenderParams& params);
+    CpuBackend& pointBackend();
+    void finishRender(const ComputeBackend& backend, double startUs, const RenderRegion& region,
+                      const float* values, size_t valuesPerRow);
+    void recordRender(const ComputeBackend& backend, double startUs, const RenderRegion& region,
+                      const float* values, size_t valuesPerRow);
+    bool reuseIterations(const RenderParams& params);
+    void completeIterations();
+    void adaptIterations();
+    void raiseIterations(unsigned long limit);
+    void shiftIterations(const Eigen::Vector2i& offset, const RenderParams& params);
+    // `values` holds image pixels from `origin` on, computed with maxIterations, the pixels of `inner`
+    // (in its coordinates) are checked
+    void supersample(const float* values, const Eigen::Vector2i& origin, const Eigen::Vector2i& size,
+                     size_t valuesPerRow, unsigned long maxIterations, const RenderRegion& inner,
+                     Supersamples& samples);
+    // Overwrites the supersampled pixels of dst, whose first pixel is image pixel `origin`
+    void applySupersamples(const Supersamples& samples, const Eigen::Vector2i& origin, unsigned long maxIterations,
+                           uint8_t* dst, size_t bytesPerRow) const;
+
+    // View pixel p is pixel p + offset of the lattice
+    struct LatticePosition {
+        uint64_t id;
+        Eigen::Vector2i offset;
+    };
+    struct Lattice {
+        RenderParams params;
+        uint64_t id;
+    };
+    LatticePosition latticeOf(const RenderParams& params);
+    template<typename Func>
+    void forEachTile(const LatticePosition& position, const RenderRegion& region, Func&& func) const;
+    bool fillFromTiles(const LatticePosition& position, const RenderRegion& region, bool requireHit);
+    bool loadTiles(const RenderParams& params);
+    void storeTiles(const RenderParams& params);
+
+    std::unique_ptr<ComputeBackend> backend_;
+    // Created on first use for the modes `backend_` doesn't support
+    std::unique_ptr<CpuBackend> fallback_;
+    unsigned threadCount_;
     Eigen::Vector2i size_;
-    float scale_;
-    Eigen::Vector2f center_;
+    double scale_;
+    PrecisePoint center_;
     unsigned long maxIterations_;
-    bool initialized_;
+    Precision precision_;
+    bool deepZoom_;
+    bool bulbCheck_;
+    bool periodicityCheck_;
+    Formula formula_;
+    RenderStrategy strategy_;
+    ShortcutStats shortcutStats_;
+    mutable FrameMetrics metrics_; // colorize() is const but measured too
+    std::stop_token stop_;
+    Palette palette_;
+    bool incremental_;
+    bool autoIterations_;
+    static constexpr int autoBlockSize = 32; // capped pixels are rendered again in blocks
+    AntiAliasing antiAliasing_;
+    Supersamples supersamples_; // of iterations_
+    Supersamples bandSupersamples_; // of the region passed to render()
+    std::vector<Eigen::Vector2f> samplePositions_;
+    std::vector<float> sampleValues_;
+    std::vector<size_t> sampleTargets_; // index of every sample in Supersamples::values
+    std::vector<float> iterations_;
+    std::vector<float> spare_; // previous frame while it's shifted into iterations_
+    RenderParams iterationsParams_;
+    size_t lastComputedPixels_;
+    static constexpr int coarsestStep = 4;
+    std::vector<float> samples_; // computed samples of the progressive passes
+    int refinementStep_; // twice the step of the next pass, 0 when there is none
+    std::vector<float> band_; // iterations of the region passed to render()
+    static constexpr int cacheTileSize = 128;
+    static constexpr size_t maxLattices = 64;
+    std::unique_ptr<TileCache> tileCache_;
+    std::vector<Lattice> lattices_; // pixel grids of the cached tiles, most recently used last
+    uint64_t nextLattice_;
+    std::vector<float> tile_; // tile handed to tileCache_
 };
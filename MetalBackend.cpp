@@ -0,0 +1,277 @@
+#include "MetalBackend.hpp"
+#include "Log.hpp"
+
+#define NS_PRIVATE_IMPLEMENTATION
+#define MTL_PRIVATE_IMPLEMENTATION
+#define MTK_PRIVATE_IMPLEMENTATION
+#define CA_PRIVATE_IMPLEMENTATION
+#include <Metal/Metal.hpp>
+#include <Foundation/Foundation.hpp>
+#include <QuartzCore/QuartzCore.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <functional>
+#include <utility>
+
+namespace {
+    const std::string queueLabel{"mandelbrot"};
+
+    // Mirrors `ViewParams` of the metal kernel, float2/uint2 members are 8 bytes aligned there
+    struct ViewParams {
+        float center[2];
+        float scale;
+        uint32_t flags;
+        uint32_t origin[2];
+        uint32_t size[2];
+        uint32_t step;
+        uint32_t padding;
+        float julia[2];
+    };
+    static_assert(sizeof(ViewParams) == 48, "ViewParams must match the metal layout");
+
+    // Bits of ViewParams::flags
+    constexpr uint32_t bulbCheckFlag = 1;
+    constexpr uint32_t periodicityCheckFlag = 2;
+
+    // Bulb and periodicity counters written by the kernel
+    constexpr size_t counterCount = 2;
+
+    // Host name of the kernel instantiation, e.g. "mandelbrot_2" or "burning_ship_3"
+    std::string functionName(const Formula& formula) {
+        const char* type = formula.type == FormulaType::Julia ? "julia"
+                         : formula.type == FormulaType::BurningShip ? "burning_ship" : "mandelbrot";
+        return std::string(type) + "_" + std::to_string(formula.power);
+    }
+} // namespace
+
+template<typename T>
+void refDeleter(NS::Referencing<T> * ref) {
+    ref->release();
+}
+
+template<typename T>
+void refResourceDeleter(NS::Referencing<T, MTL::Resource> * ref) {
+    ref->release();
+}
+
+template<typename T>
+void refCopyingDeleter(NS::Copying<T> * ref) {
+    ref->release();
+}
+
+MetalBackend::MetalBackend()
+    : device_(MTL::CreateSystemDefaultDevice(), refDeleter<MTL::Device>),
+      library_(nullptr, refDeleter<MTL::Library>),
+      commandQueue_(nullptr, refDeleter<MTL::CommandQueue>),
+      texture_(nullptr, refResourceDeleter<MTL::Texture>),
+      positionBuffer_(nullptr, refResourceDeleter<MTL::Buffer>),
+      maxItBuffer_(nullptr, refResourceDeleter<MTL::Buffer>),
+      countersBuffer_(nullptr, refResourceDeleter<MTL::Buffer>),
+      error_(NS::Error::alloc()->init(NS::CocoaErrorDomain, 99, NS::Dictionary::dictionary()), refCopyingDeleter<NS::Error>) {
+    Log::info("Initializing metal...");
+    if (device_ == nullptr)
+        throw std::runtime_error("Unable to create device");
+    Log::info("Device name: {}",
+              device_->name()->cString(NS::UTF8StringEncoding));
+
+    initLibrary();
+    pipeline(Formula{});
+    initCommandQueue();
+
+    Log::info("Metal has been initialized");
+}
+
+const char* MetalBackend::name() const {
+    return "metal";
+}
+
+const ShortcutStats& MetalBackend::shortcutStats() const {
+    return shortcutStats_;
+}
+
+const RenderTimings& MetalBackend::timings() const {
+    return timings_;
+}
+
+bool MetalBackend::supports(const RenderParams& params) const {
+    // The kernels compute in float only, Apple GPUs have no double
+    return !params.deepZoom && params.precision == Precision::Float;
+}
+
+void MetalBackend::initLibrary() {
+    // METALLIB is a path to binary compiled with macosx sdk and forwarded to C++ from CMake
+    auto libPath = NS::String::string(METALLIB, NS::UTF8StringEncoding);
+    if (libPath == nullptr)
+        throw std::runtime_error("Unable to create string");
+    Log::info("Path to metal library: {}",
+              libPath->cString(NS::UTF8StringEncoding));
+    auto url = NS::URL::fileURLWithPath(libPath);
+
+    NS::Error *errRawPtr = error_.get();
+    library_.reset(device_->newLibrary(url, &errRawPtr));
+    if (library_ == nullptr)
+        throw std::runtime_error(error_->localizedDescription()->utf8String());
+    Log::info("Library type: {}",
+              library_->type());
+}
+
+// Pipelines are created on the first use of their formula and kept
+MTL::ComputePipelineState* MetalBackend::pipeline(const Formula& formula) {
+    const std::string name = functionName(formula);
+    auto found = pipelines_.find(name);
+    if (found != pipelines_.end())
+        return found->second.get();
+
+    auto funcName = NS::String::string(name.c_str(), NS::UTF8StringEncoding);
+    if (funcName == nullptr)
+        throw std::runtime_error("Unable to create string");
+    Log::info("Function name: {}",
+              funcName->cString(NS::UTF8StringEncoding));
+    MTLFunctionPtr function(library_->newFunction(funcName), refDeleter<MTL::Function>);
+    if (function == nullptr)
+        throw std::runtime_error("Unable to create function");
+
+    NS::Error *errRawPtr = error_.get();
+    MTLComputePipelineStatePtr computePipeline(device_->newComputePipelineState(function.get(), &(errRawPtr)),
+                                               refDeleter<MTL::ComputePipelineState>);
+    if (computePipeline == nullptr)
+        throw std::runtime_error(error_->localizedDescription()->utf8String());
+    Log::info("Thread execution width: {}",
+              computePipeline->threadExecutionWidth());
+    return pipelines_.emplace(name, std::move(computePipeline)).first->second.get();
+}
+
+void MetalBackend::initCommandQueue() {
+    auto label = NS::String::string(queueLabel.c_str(), NS::UTF8StringEncoding);
+    if (label == nullptr)
+        throw std::runtime_error("Unable to create string");
+    commandQueue_.reset(device_->newCommandQueue());
+    if (commandQueue_ == nullptr)
+        throw std::runtime_error("Unable to create command queue");
+    commandQueue_->setLabel(label);
+    Log::info("Command queue label: {}",
+              commandQueue_->label()->cString(NS::UTF8StringEncoding));
+}
+
+using MTLTextureDescriptorPtr = std::unique_ptr<MTL::TextureDescriptor, std::function<void(MTL::TextureDescriptor*)>>;
+
+void MetalBackend::initBuffersTextures(const Eigen::Vector2i& size) {
+    MTLTextureDescriptorPtr textureDesc(MTL::TextureDescriptor::alloc()->init(), refDeleter<MTL::TextureDescriptor>);
+    if (textureDesc == nullptr)
+        throw std::bad_alloc();
+    textureDesc->setWidth(size[0]);
+    textureDesc->setHeight(size[1]);
+    textureDesc->setPixelFormat(MTL::PixelFormatR32Float);
+    textureDesc->setTextureType(MTL::TextureType2D);
+    textureDesc->setAllowGPUOptimizedContents(true);
+    textureDesc->setStorageMode(MTL::StorageModeManaged);
+    textureDesc->setUsage(MTL::ResourceUsageSample | MTL::ResourceUsageRead | MTL::ResourceUsageWrite);
+    texture_.reset(device_->newTexture(textureDesc.get()));
+    if (texture_ == nullptr)
+        throw std::bad_alloc();
+
+    positionBuffer_.reset(device_->newBuffer(sizeof(ViewParams), MTL::ResourceStorageModeManaged));
+    if (positionBuffer_ == nullptr)
+        throw std::bad_alloc();
+    maxItBuffer_.reset(device_->newBuffer(sizeof(unsigned long), MTL::ResourceStorageModeManaged));
+    if (maxItBuffer_ == nullptr)
+        throw std::bad_alloc();
+    // Shared storage, so the counters are readable right after the command buffer completes
+    countersBuffer_.reset(device_->newBuffer(sizeof(uint32_t) * counterCount, MTL::ResourceStorageModeShared));
+    if (countersBuffer_ == nullptr)
+        throw std::bad_alloc();
+}
+
+void MetalBackend::setPositionBuffer(const RenderParams& params, const RenderRegion& region) {
+    ViewParams* view = reinterpret_cast<ViewParams*>(positionBuffer_->contents());
+    view->center[0] = params.center[0];
+    view->center[1] = params.center[1];
+    view->scale = params.scale;
+    view->flags = (params.bulbCheck ? bulbCheckFlag : 0) | (params.periodicityCheck ? periodicityCheckFlag : 0);
+    view->origin[0] = static_cast<uint32_t>(region.origin[0]);
+    view->origin[1] = static_cast<uint32_t>(region.origin[1]);
+    view->step = static_cast<uint32_t>(region.step);
+    view->size[0] = static_cast<uint32_t>(params.size[0]);
+    view->size[1] = static_cast<uint32_t>(params.size[1]);
+    view->julia[0] = params.formula.juliaX;
+    view->julia[1] = params.formula.juliaY;
+    positionBuffer_->didModifyRange(NS::Range::Make(0, sizeof(ViewParams)));
+}
+
+void MetalBackend::setMaxItBuffer(const RenderParams& params) {
+    unsigned long* maxIt = reinterpret_cast<unsigned long*>(maxItBuffer_->contents());
+    *maxIt = params.maxIterations;
+    maxItBuffer_->didModifyRange(NS::Range::Make(0, sizeof(unsigned long)));
+}
+
+void MetalBackend::resetCounters() {
+    uint32_t* counters = reinterpret_cast<uint32_t*>(countersBuffer_->contents());
+    std::fill_n(counters, counterCount, 0u);
+}
+
+void MetalBackend::executeKernel(MTL::ComputePipelineState* computePipeline, const Eigen::Vector2i& size) {
+    const auto start = std::chrono::steady_clock::now();
+    // Command buffer initialization
+    auto commandBuf = commandQueue_->commandBuffer();
+    if (commandBuf == nullptr)
+        throw std::runtime_error("Unable to get command buffer");
+    condAtomicFlag_.clear();
+    commandBuf->addCompletedHandler([&condAtomicFlag = condAtomicFlag_](MTL::CommandBuffer*) -> void {
+                                    condAtomicFlag.test_and_set();
+                                    condAtomicFlag.notify_one();
+                                    });
+
+    // Put all the parameters to encoder and start execution of the kernel
+    auto computeEncoder = commandBuf->computeCommandEncoder();
+    if (computeEncoder == nullptr)
+        throw std::runtime_error("Unable to get compute command encoder");
+    computeEncoder->setComputePipelineState(computePipeline);
+    computeEncoder->setTexture(texture_.get(), 0);
+    computeEncoder->setBuffer(positionBuffer_.get(), 0, 0);
+    computeEncoder->setBuffer(maxItBuffer_.get(), 0, 1);
+    computeEncoder->setBuffer(countersBuffer_.get(), 0, 2);
+    MTL::Size gridSize(size[0], size[1], 1);
+    NS::UInteger threadCount = computePipeline->maxTotalThreadsPerThreadgroup();
+    MTL::Size threadGroupSize(threadCount, 1, 1);
+    computeEncoder->dispatchThreads(gridSize, threadGroupSize);
+    computeEncoder->endEncoding();
+    commandBuf->commit();
+    const auto committed = std::chrono::steady_clock::now();
+
+    // Waiting the computation is done
+    condAtomicFlag_.wait(false);
+    timings_.dispatchMs = std::chrono::duration<double, std::milli>(committed - start).count();
+    timings_.computeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - committed).count();
+}
+
+void MetalBackend::render(const RenderParams& params, const RenderRegion& region,
+                          float* dst, size_t valuesPerRow) {
+    // The samples of the region fill the top left corner of the texture, the kernel maps them to pixels
+    // by origin and step. The texture only grows, so progressive passes and bands don't reallocate it.
+    if (texture_ == nullptr ||
+        texture_->width() < static_cast<NS::UInteger>(region.size[0]) ||
+        texture_->height() < static_cast<NS::UInteger>(region.size[1])) {
+        const Eigen::Vector2i current = texture_ == nullptr ? Eigen::Vector2i(0, 0)
+            : Eigen::Vector2i(static_cast<int>(texture_->width()), static_cast<int>(texture_->height()));
+        initBuffersTextures(current.cwiseMax(region.size));
+        Log::info("Texture parameters: width={}, height={}, bytesPerRow={}, bpp={}",
+                  texture_->width(), texture_->height(),
+                  texture_->bufferBytesPerRow(),
+                  texture_->bufferBytesPerRow() / texture_->width());
+    }
+
+    setPositionBuffer(params, region);
+    setMaxItBuffer(params);
+    resetCounters();
+    executeKernel(pipeline(params.formula), region.size);
+    const auto readback = std::chrono::steady_clock::now();
+    const uint32_t* counters = reinterpret_cast<const uint32_t*>(countersBuffer_->contents());
+    shortcutStats_ = {static_cast<size_t>(region.size[0]) * region.size[1], counters[0], counters[1]};
+
+    texture_->getBytes(dst, valuesPerRow * sizeof(float),
+                       MTL::Region(0, 0, region.size[0], region.size[1]), 0);
+    timings_.readbackMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - readback).count();
+}
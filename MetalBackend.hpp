@@ -0,0 +1,71 @@
+#pragma once
+
+#include "ComputeBackend.hpp"
+
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+namespace MTL {
+    class Device;
+    class CommandQueue;
+    class Library;
+    class ComputePipelineState;
+    class Texture;
+    class Function;
+    class Buffer;
+} // namespace MTL
+
+using MTLDevicePtr = std::unique_ptr<MTL::Device, std::function<void(MTL::Device*)>>;
+using MTLCommandQueuePtr = std::unique_ptr<MTL::CommandQueue, std::function<void(MTL::CommandQueue*)>>;
+using MTLLibraryPtr = std::unique_ptr<MTL::Library, std::function<void(MTL::Library*)>>;
+using MTLComputePipelineStatePtr = std::unique_ptr<MTL::ComputePipelineState, std::function<void(MTL::ComputePipelineState*)>>;
+using MTLTexturePtr = std::unique_ptr<MTL::Texture, std::function<void(MTL::Texture*)>>;
+using MTLFunctionPtr = std::unique_ptr<MTL::Function, std::function<void(MTL::Function*)>>;
+using MTLBufferPtr = std::unique_ptr<MTL::Buffer, std::function<void(MTL::Buffer*)>>;
+
+namespace NS {
+    class Error;
+} // namespace NS
+
+using NSErrorPtr = std::unique_ptr<NS::Error, std::function<void(NS::Error*)>>;
+
+class MetalBackend final : public ComputeBackend
+{
+public:
+    MetalBackend();
+    ~MetalBackend() override = default;
+
+    const char* name() const override;
+    bool supports(const RenderParams& params) const override;
+    void render(const RenderParams& params, const RenderRegion& region,
+                float* dst, size_t valuesPerRow) override;
+    const ShortcutStats& shortcutStats() const override;
+    const RenderTimings& timings() const override;
+private:
+    void initLibrary();
+    // Kernel instantiated for the formula and its power
+    MTL::ComputePipelineState* pipeline(const Formula& formula);
+    void initCommandQueue();
+    void initBuffersTextures(const Eigen::Vector2i& size);
+
+    void setPositionBuffer(const RenderParams& params, const RenderRegion& region);
+    void setMaxItBuffer(const RenderParams& params);
+    void resetCounters();
+    void executeKernel(MTL::ComputePipelineState* computePipeline, const Eigen::Vector2i& size);
+private:
+    MTLDevicePtr device_;
+    MTLLibraryPtr library_;
+    std::unordered_map<std::string, MTLComputePipelineStatePtr> pipelines_;
+    MTLCommandQueuePtr commandQueue_;
+    MTLTexturePtr texture_;
+    MTLBufferPtr positionBuffer_;
+    MTLBufferPtr maxItBuffer_;
+    MTLBufferPtr countersBuffer_;
+    NSErrorPtr error_;
+    std::atomic_flag condAtomicFlag_;
+    ShortcutStats shortcutStats_;
+    RenderTimings timings_;
+};
@@ -0,0 +1,132 @@
+#include "Palette.hpp"
+#include "ColorMaps.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+    uint32_t packColor(const Eigen::Vector4f& color) {
+        uint8_t bytes[4];
+        ColorMaps::writePixel(color, bytes);
+        uint32_t packed;
+        std::memcpy(&packed, bytes, sizeof(packed));
+        return packed;
+    }
+
+    Eigen::Vector4f rgb(int r, int g, int b) {
+        return {r / 255.0f, g / 255.0f, b / 255.0f, 1.0f};
+    }
+
+    std::vector<Palette> builtInPalettes() {
+        return {
+            Palette::fromColorMap("rainbow", ColorMaps::rainbowColorMap),
+            Palette::fromColorMap("cold", ColorMaps::coldColorMap),
+            Palette::fromColorMap("hot", ColorMaps::hotColorMap),
+            Palette::fromColorMap("green", ColorMaps::greenColorMap),
+            Palette::fromColorMap("simple", ColorMaps::simpleColorMap),
+            Palette::fromColorMap("cubic", ColorMaps::cubicInterpolatedColorMap),
+            Palette::gradient("ultra", {rgb(0, 7, 100), rgb(32, 107, 203), rgb(237, 255, 255),
+                                        rgb(255, 170, 0), rgb(0, 2, 0)}),
+            Palette::gradient("fire", {rgb(0, 0, 0), rgb(128, 0, 0), rgb(255, 80, 0),
+                                       rgb(255, 200, 0), rgb(255, 255, 255)}),
+            Palette::gradient("ocean", {rgb(0, 0, 20), rgb(0, 60, 130), rgb(0, 150, 200),
+                                        rgb(180, 240, 255), rgb(255, 255, 255)}),
+        };
+    }
+
+    const std::vector<Palette>& palettes() {
+        static const std::vector<Palette> all = builtInPalettes();
+        return all;
+    }
+} // namespace
+
+Palette::Palette(std::string name, std::vector<uint32_t> colors)
+    : name_(std::move(name)), colors_(std::move(colors)) {
+}
+
+Palette Palette::fromColorMap(const std::string& name, const std::function<Eigen::Vector4f(float)>& map,
+                              size_t size) {
+    if (size < 2)
+        throw std::invalid_argument("Palette needs at least 2 colors");
+    std::vector<uint32_t> colors(size);
+    for (size_t i = 0; i < size; ++i)
+        colors[i] = packColor(map(static_cast<float>(i) / static_cast<float>(size - 1)));
+    return {name, std::move(colors)};
+}
+
+Palette Palette::gradient(const std::string& name, const std::vector<Eigen::Vector4f>& stops, size_t size) {
+    if (stops.size() < 2)
+        throw std::invalid_argument("Gradient " + name + " needs at least 2 stops");
+    const float segments = static_cast<float>(stops.size() - 1);
+    return fromColorMap(name, [&stops, segments](float value) -> Eigen::Vector4f {
+        const float position = value * segments;
+        const size_t index = std::min(static_cast<size_t>(position), stops.size() - 2);
+        const float t = position - static_cast<float>(index);
+        return stops[index] + (stops[index + 1] - stops[index]) * t;
+    }, size);
+}
+
+Palette Palette::load(const std::string& path) {
+    std::ifstream file(path);
+    if (!file)
+        throw std::runtime_error("Unable to open palette " + path);
+
+    std::vector<Eigen::Vector4f> stops;
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        int r, g, b;
+        if (words >> r >> g >> b)
+            stops.push_back(rgb(r, g, b));
+        else if (line.find_first_not_of(" \t\r") != std::string::npos)
+            throw std::invalid_argument("Malformed palette line: " + line);
+    }
+    return gradient(path, stops);
+}
+
+const std::string& Palette::name() const {
+    return name_;
+}
+
+void Palette::colorize(const float* values, size_t count, unsigned long maxIterations, uint8_t* dst) const {
+    const float last = static_cast<float>(colors_.size() - 1);
+    const float scale = last / static_cast<float>(maxIterations);
+    for (size_t i = 0; i < count; ++i) {
+        const float index = std::clamp(values[i] * scale + 0.5f, 0.0f, last);
+        std::memcpy(dst + i * 4, &colors_[static_cast<size_t>(index)], 4);
+    }
+}
+
+namespace Palettes {
+
+const std::vector<std::string>& names() {
+    static const std::vector<std::string> all = [] {
+        std::vector<std::string> result;
+        for (const Palette& palette : palettes())
+            result.push_back(palette.name());
+        return result;
+    }();
+    return all;
+}
+
+const Palette& byName(const std::string& name) {
+    for (const Palette& palette : palettes()) {
+        if (palette.name() == name)
+            return palette;
+    }
+    throw std::invalid_argument("Unknown palette " + name);
+}
+
+Palette resolve(const std::string& nameOrPath) {
+    const auto& all = names();
+    if (std::find(all.begin(), all.end(), nameOrPath) != all.end())
+        return byName(nameOrPath);
+    return Palette::load(nameOrPath);
+}
+
+} // namespace Palettes
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+
+// Lookup table of RGBA8 colors over normalized iteration values [0, 1].
+// Coloring is one multiply and one table read per pixel, so switching
+// palettes never requires recomputing the orbits.
+class Palette final {
+public:
+    static constexpr size_t defaultSize = 4096;
+
+    // Samples a color map of ColorMaps
+    static Palette fromColorMap(const std::string& name, const std::function<Eigen::Vector4f(float)>& map,
+                                size_t size = defaultSize);
+    // Linear gradient through evenly spaced stops
+    static Palette gradient(const std::string& name, const std::vector<Eigen::Vector4f>& stops,
+                            size_t size = defaultSize);
+    // Text file with one "R G B" stop (0..255) per line, '#' starts a comment
+    static Palette load(const std::string& path);
+
+    const std::string& name() const;
+    // `values` are smooth iteration counts, maxIterations (interior) gets the last color
+    void colorize(const float* values, size_t count, unsigned long maxIterations, uint8_t* dst) const;
+private:
+    Palette(std::string name, std::vector<uint32_t> colors);
+
+    std::string name_;
+    std::vector<uint32_t> colors_; // 4 bytes of RGBA8 each
+};
+
+namespace Palettes {
+
+// Color maps of the original kernel followed by the gradient palettes
+const std::vector<std::string>& names();
+// Throws if there is no built-in palette `name`
+const Palette& byName(const std::string& name);
+// Built-in palette or, failing that, a palette file
+Palette resolve(const std::string& nameOrPath);
+
+} // namespace Palettes
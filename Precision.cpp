@@ -0,0 +1,56 @@
+#include "Precision.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+    // Neighbouring pixels must be this many ulps apart, then rounding moves a pixel by a quarter of it at most
+    constexpr double ulpsPerPixel = 2.0;
+    // Relative ulp of each precision
+    constexpr double floatEpsilon = 0x1p-24;
+    constexpr double doubleEpsilon = 0x1p-53;
+} // namespace
+
+namespace Precisions {
+
+Precision pick(const PrecisePoint& center, double scale, const Eigen::Vector2i& size) {
+    // Orbit steps round at the size of z, which is about 1 next to the set whatever c is, so views close
+    // to the origin don't get finer ulps than that
+    const double magnitude = std::max({1.0, std::abs(static_cast<double>(center.x)),
+                                       std::abs(static_cast<double>(center.y))});
+    const double pixel = scale / std::max({size[0], size[1], 1});
+    if (pixel >= magnitude * floatEpsilon * ulpsPerPixel)
+        return Precision::Float;
+    if (pixel >= magnitude * doubleEpsilon * ulpsPerPixel)
+        return Precision::Double;
+    return Precision::DoubleDouble;
+}
+
+const char* name(Precision precision) {
+    switch (precision) {
+    case Precision::Auto:
+        return "auto";
+    case Precision::Float:
+        return "float";
+    case Precision::Double:
+        return "double";
+    case Precision::DoubleDouble:
+        return "double-double";
+    }
+    return "unknown";
+}
+
+Precision parse(const std::string& name) {
+    if (name == "auto")
+        return Precision::Auto;
+    if (name == "float")
+        return Precision::Float;
+    if (name == "double")
+        return Precision::Double;
+    if (name == "double-double")
+        return Precision::DoubleDouble;
+    throw std::invalid_argument("Unknown precision " + name);
+}
+
+} // namespace Precisions
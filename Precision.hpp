@@ -0,0 +1,27 @@
+#pragma once
+
+#include "DoubleDouble.hpp"
+
+#include <string>
+#include <Eigen/Dense>
+
+// Number type of the escape loop. Every step costs more: float runs 16 lanes per AVX-512 instruction,
+// double 8, double-double is scalar and takes ~20 operations per multiplication.
+enum class Precision {
+    Auto, // the cheapest one which resolves a pixel of the view, see Precisions::pick()
+    Float,
+    Double,
+    DoubleDouble
+};
+
+namespace Precisions {
+
+// A precision resolves the view while neighbouring pixels are a few of its ulps apart. Next to the
+// origin float lasts to ~1e-4 of scale at 1000 pixels, double to ~2e-13, double-double to ~1e-28,
+// below which the view can't be placed more precisely anyway.
+Precision pick(const PrecisePoint& center, double scale, const Eigen::Vector2i& size);
+const char* name(Precision precision);
+// "auto", "float", "double" or "double-double"
+Precision parse(const std::string& name);
+
+} // namespace Precisions
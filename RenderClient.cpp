@@ -0,0 +1,91 @@
+#include "RenderClient.hpp"
+
+#include <cstring>
+#include <utility>
+
+#include <unistd.h>
+
+RenderClient::RenderClient(const std::string& socketPath)
+    : fd_(RenderProtocol::connect(socketPath)) {
+}
+
+RenderClient::~RenderClient() {
+    ::close(fd_);
+}
+
+uint64_t RenderClient::send(const std::vector<std::string>& options, RenderPriority priority) {
+    const uint64_t id = nextId_++;
+    RenderProtocol::send(fd_, RenderProtocol::encodeRequest({id, priority, options}));
+    replies_[id].id = id;
+    return id;
+}
+
+RenderReply RenderClient::receive(const RowsCallback& onRows) {
+    if (replies_.empty())
+        throw std::logic_error("No request is in flight");
+    while (true) {
+        if (!RenderProtocol::read(fd_, message_, RenderProtocol::maxPayload))
+            throw std::runtime_error("Render daemon closed the connection");
+        uint64_t id = 0;
+        switch (message_.type) {
+        case MessageType::Image: {
+            Eigen::Vector2i size;
+            id = RenderProtocol::parseImage(message_, size);
+            const auto found = replies_.find(id);
+            if (found == replies_.end())
+                break;
+            found->second.size = size;
+            found->second.pixels.assign(static_cast<size_t>(size[0]) * size[1] * 4, 0);
+            break;
+        }
+        case MessageType::Rows: {
+            int y;
+            int rows;
+            const uint8_t* rgba;
+            size_t bytes;
+            id = RenderProtocol::parseRows(message_, y, rows, rgba, bytes);
+            const auto found = replies_.find(id);
+            if (found == replies_.end())
+                break;
+            RenderReply& reply = found->second;
+            const size_t bytesPerRow = static_cast<size_t>(reply.size[0]) * 4;
+            if (y < 0 || rows < 0 || y + rows > reply.size[1] || bytes != bytesPerRow * rows)
+                throw std::runtime_error("Malformed rows from the render daemon");
+            std::memcpy(reply.pixels.data() + y * bytesPerRow, rgba, bytes);
+            if (onRows)
+                onRows(id, y, rows, rgba);
+            break;
+        }
+        case MessageType::Done: {
+            const DoneMessage done = RenderProtocol::parseDone(message_);
+            const auto found = replies_.find(done.id);
+            if (found == replies_.end())
+                break;
+            RenderReply reply = std::move(found->second);
+            replies_.erase(found);
+            reply.done = done;
+            return reply;
+        }
+        case MessageType::Error: {
+            std::string what;
+            id = RenderProtocol::parseError(message_, what);
+            replies_.erase(id);
+            throw RenderRequestError(id, what);
+        }
+        default:
+            throw std::runtime_error("Unexpected message from the render daemon");
+        }
+    }
+}
+
+RenderReply RenderClient::render(const std::vector<std::string>& options, RenderPriority priority,
+                                 const RowsCallback& onRows) {
+    if (!replies_.empty())
+        throw std::logic_error("Other requests are in flight");
+    send(options, priority);
+    return receive(onRows);
+}
+
+size_t RenderClient::inFlight() const {
+    return replies_.size();
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "RenderProtocol.hpp"
+
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+
+// The daemon refused or failed a request, the connection stays usable
+class RenderRequestError : public std::runtime_error {
+public:
+    RenderRequestError(uint64_t id, const std::string& what) : std::runtime_error(what), id_(id) {}
+    uint64_t id() const { return id_; }
+private:
+    uint64_t id_;
+};
+
+// Finished image of a request
+struct RenderReply {
+    uint64_t id = 0;
+    Eigen::Vector2i size{0, 0};
+    std::vector<uint8_t> pixels; // RGBA8, packed rows
+    DoneMessage done;
+};
+
+// Connection to a render daemon, see RenderDaemon. Requests are rendered without process startup or
+// backend initialization, identical ones of any clients share a render.
+// Several requests may be in flight, receive() returns them in the order they finish.
+// A client is used by one thread at a time.
+class RenderClient final {
+public:
+    // Called for every band as it arrives, the rows are valid only during the call
+    using RowsCallback = std::function<void(uint64_t id, int y, int rows, const uint8_t* rgba)>;
+
+    explicit RenderClient(const std::string& socketPath = RenderProtocol::defaultSocketPath());
+    ~RenderClient();
+
+    RenderClient(const RenderClient&) = delete;
+    RenderClient& operator=(const RenderClient&) = delete;
+
+    // Sends a request of mandelbrot_batch options (--size, --center, --palette...), returns its id.
+    // Only plain images are rendered: no output files, tiles, pyramids, sequences or snapshots.
+    uint64_t send(const std::vector<std::string>& options, RenderPriority priority = RenderPriority::Interactive);
+    // Waits for the next finished request, throws RenderRequestError for a failed one
+    RenderReply receive(const RowsCallback& onRows = {});
+    // send() and receive() of that request, nothing else may be in flight
+    RenderReply render(const std::vector<std::string>& options, RenderPriority priority = RenderPriority::Interactive,
+                       const RowsCallback& onRows = {});
+    size_t inFlight() const;
+private:
+    int fd_;
+    uint64_t nextId_ = 1;
+    std::map<uint64_t, RenderReply> replies_; // requests in flight, filled as rows arrive
+    Message message_;
+};
@@ -0,0 +1,371 @@
+#include "RenderDaemon.hpp"
+
+#include "Log.hpp"
+
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+    // Options of a request take a few hundred bytes
+    constexpr size_t maxRequestBytes = size_t(64) << 10;
+    // RGBA of 16384x16384 pixels, 1 GB
+    constexpr int64_t maxPixels = int64_t(1) << 28;
+    // serve() looks at stop() this often
+    constexpr int acceptTimeoutMs = 200;
+    // Replies queued for a client that doesn't read them, one message of the largest band
+    constexpr size_t maxOutboxBytes = RenderProtocol::frameHeaderBytes + RenderProtocol::maxPayload;
+
+    // Everything that changes the pixels, requests with the same key share a render
+    std::string keyOf(const RenderJob& job) {
+        return fmt::format("size {}x{} center {:a}{:+a},{:a}{:+a} scale {:a} iterations {}{} precision {} deep {} "
+                           "bulb {} periodicity {} formula {} traced {} aa {} {} {:a} palette {}",
+                           job.size[0], job.size[1], job.center.x.hi, job.center.x.lo, job.center.y.hi, job.center.y.lo,
+                           job.scale, job.maxIterations, job.autoIterations ? " auto" : "",
+                           Precisions::name(job.precision), job.deepZoom, job.bulbCheck, job.periodicityCheck,
+                           Formulas::describe(job.formula), job.boundaryTrace, job.antiAliasing.samples,
+                           AntiAliasings::patternName(job.antiAliasing.pattern), job.antiAliasing.threshold, job.palette);
+    }
+
+    // Files are the client's business, the daemon only streams plain images back
+    void checkSupported(const RenderJob& job) {
+        if (!job.output.empty() || job.tileSize > 0 || !job.tiles.empty() || !job.pyramid.empty() ||
+            !job.sequence.empty() || !job.snapshot.empty() || !job.fromSnapshot.empty())
+            throw std::invalid_argument("Render daemon renders plain images only, without output files, tiles, "
+                                        "pyramids, sequences or snapshots");
+        if (static_cast<int64_t>(job.size[0]) * job.size[1] > maxPixels)
+            throw std::invalid_argument(fmt::format("Image of {}x{} pixels is too large", job.size[0], job.size[1]));
+        if (job.bandRows <= 0)
+            throw std::invalid_argument("Band rows must be positive");
+        // Every band goes out as one Rows message
+        const size_t bandBytes = static_cast<size_t>(job.size[0]) * 4 * std::min(job.bandRows, job.size[1]);
+        if (RenderProtocol::rowsHeaderBytes + bandBytes > RenderProtocol::maxPayload)
+            throw std::invalid_argument(fmt::format("Band of {} rows of {} pixels is over the message limit of {} bytes",
+                                                    job.bandRows, job.size[0], RenderProtocol::maxPayload));
+    }
+
+    double seconds(std::chrono::steady_clock::duration duration) {
+        return std::chrono::duration<double>(duration).count();
+    }
+} // namespace
+
+RenderDaemon::Connection::Connection(int fd)
+    : fd(fd) {
+}
+
+RenderDaemon::Connection::~Connection() {
+    ::close(fd);
+}
+
+bool RenderDaemon::Connection::post(std::vector<uint8_t> message) {
+    std::lock_guard lock(mutex);
+    if (!alive)
+        return false;
+    if (outboxBytes + message.size() > maxOutboxBytes) {
+        alive = false;
+        // Wakes up both threads of the connection
+        ::shutdown(fd, SHUT_RDWR);
+        outboxCv.notify_all();
+        return false;
+    }
+    outboxBytes += message.size();
+    outbox.push_back(std::move(message));
+    outboxCv.notify_all();
+    return true;
+}
+
+RenderDaemon::RenderDaemon(const std::string& socketPath, BackendType backend, unsigned threadCount)
+    : generator_(backend, threadCount), socketPath_(socketPath), listenFd_(RenderProtocol::listen(socketPath)) {
+    worker_ = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+RenderDaemon::~RenderDaemon() {
+    stop();
+    worker_.request_stop();
+    worker_.join();
+    ::close(listenFd_);
+    ::unlink(socketPath_.c_str());
+}
+
+void RenderDaemon::serve() {
+    while (!stopping_) {
+        pollfd listening{listenFd_, POLLIN, 0};
+        const int ready = ::poll(&listening, 1, acceptTimeoutMs);
+        clients_.remove_if([](const Client& client) { return client.connection->finished.load(); });
+        if (ready <= 0)
+            continue;
+        const int fd = ::accept(listenFd_, nullptr, nullptr);
+        if (fd < 0)
+            continue;
+        RenderProtocol::disableSigpipe(fd);
+        auto connection = std::make_shared<Connection>(fd);
+        std::jthread reader([this, connection] { read(connection); });
+        std::jthread writer([connection](std::stop_token stop) { write(*connection, stop); });
+        clients_.push_back({std::move(connection), std::move(reader), std::move(writer)});
+    }
+    // Readers see the end of their streams and quit, renders of their requests are dropped
+    for (const Client& client : clients_)
+        ::shutdown(client.connection->fd, SHUT_RDWR);
+    clients_.clear();
+}
+
+void RenderDaemon::stop() {
+    stopping_ = true;
+}
+
+RenderDaemonStats RenderDaemon::stats() const {
+    std::lock_guard lock(mutex_);
+    return stats_;
+}
+
+const char* RenderDaemon::backendName() const {
+    return generator_.backendName();
+}
+
+void RenderDaemon::read(const std::shared_ptr<Connection>& connection) {
+    try {
+        Message message;
+        while (RenderProtocol::read(connection->fd, message, maxRequestBytes)) {
+            const RequestMessage request = RenderProtocol::parseRequest(message);
+            try {
+                submit(connection, request);
+            } catch (const std::exception& e) {
+                connection->post(RenderProtocol::encodeError(request.id, e.what()));
+            }
+        }
+    } catch (const std::exception& e) {
+        // A client breaking the protocol loses its connection
+        Log::warn("Render daemon client dropped: {}", e.what());
+    }
+    {
+        std::lock_guard lock(connection->mutex);
+        connection->alive = false;
+        connection->outboxCv.notify_all();
+    }
+    connection->finished = true;
+}
+
+void RenderDaemon::write(Connection& connection, std::stop_token stop) {
+    while (true) {
+        std::vector<uint8_t> message;
+        {
+            std::unique_lock lock(connection.mutex);
+            if (!connection.outboxCv.wait(lock, stop, [&] { return !connection.outbox.empty() || !connection.alive; }) ||
+                connection.outbox.empty())
+                return;
+            message = std::move(connection.outbox.front());
+            connection.outbox.pop_front();
+            connection.outboxBytes -= message.size();
+        }
+        try {
+            RenderProtocol::send(connection.fd, message);
+        } catch (const std::exception&) {
+            std::lock_guard lock(connection.mutex);
+            connection.alive = false;
+            return;
+        }
+    }
+}
+
+void RenderDaemon::submit(const std::shared_ptr<Connection>& connection, const RequestMessage& request) {
+    std::vector<std::string> rest;
+    RenderJob job = RenderJobs::parse(request.options, {}, &rest);
+    if (!rest.empty())
+        throw std::invalid_argument("Unknown option " + rest.front());
+    checkSupported(job);
+
+    auto subscriber = std::make_shared<Subscriber>(Subscriber{connection, request.id, Clock::now(), false});
+    std::string key = keyOf(job);
+    std::lock_guard lock(mutex_);
+    ++stats_.requests;
+    const auto found = inFlight_.find(key);
+    if (found != inFlight_.end()) {
+        Render& render = *found->second;
+        subscriber->coalesced = true;
+        render.subscribers.push_back(std::move(subscriber));
+        ++stats_.coalesced;
+        // A waiting batch render moves up, a batch render in progress isn't preempted any more
+        if (request.priority == RenderPriority::Interactive && render.priority == RenderPriority::Batch) {
+            render.priority = RenderPriority::Interactive;
+            if (render.queued) {
+                queues_[static_cast<int>(RenderPriority::Interactive)].push_back(found->second);
+                requestCv_.notify_one();
+            }
+        }
+        return;
+    }
+
+    auto render = std::make_shared<Render>();
+    render->key = key;
+    render->job = std::move(job);
+    render->priority = request.priority;
+    render->subscribers.push_back(std::move(subscriber));
+    inFlight_.emplace(std::move(key), render);
+    queues_[static_cast<int>(request.priority)].push_back(std::move(render));
+    requestCv_.notify_one();
+}
+
+// Entries of a queue go stale when their render moved to the interactive queue or was taken from it
+std::shared_ptr<RenderDaemon::Render> RenderDaemon::next() {
+    for (int priority = 0; priority < 2; ++priority) {
+        auto& queue = queues_[priority];
+        while (!queue.empty()) {
+            std::shared_ptr<Render> render = std::move(queue.front());
+            queue.pop_front();
+            if (render->queued && static_cast<int>(render->priority) == priority) {
+                render->queued = false;
+                return render;
+            }
+        }
+    }
+    return nullptr;
+}
+
+void RenderDaemon::run(std::stop_token stop) {
+    while (true) {
+        std::shared_ptr<Render> render;
+        {
+            std::unique_lock lock(mutex_);
+            if (!requestCv_.wait(lock, stop, [this] { return !queues_[0].empty() || !queues_[1].empty(); }))
+                return;
+            render = next();
+        }
+        if (render == nullptr)
+            continue;
+        try {
+            this->render(render, stop);
+        } catch (const std::exception& e) {
+            fail(render, e.what());
+        }
+    }
+}
+
+void RenderDaemon::configure(Render& render) {
+    const RenderJob& job = render.job;
+    generator_.setSize(job.size);
+    generator_.setPreciseCenter(job.center);
+    generator_.setPreciseScale(job.scale);
+    generator_.setDeepZoom(job.deepZoom);
+    generator_.setBulbCheck(job.bulbCheck);
+    generator_.setPeriodicityCheck(job.periodicityCheck);
+    generator_.setFormula(job.formula);
+    generator_.setPrecision(job.precision);
+    generator_.setRenderStrategy(job.boundaryTrace ? RenderStrategy::BoundaryTrace : RenderStrategy::PerPixel);
+    generator_.setAntiAliasing({});
+    generator_.setPalette(Palettes::resolve(job.palette));
+    generator_.setMaxIterations(job.maxIterations);
+    if (render.maxIterations == 0 && job.autoIterations) {
+        // Picked once on a small preview like mandelbrot_batch does, so the bands of a resumed render match
+        const int width = std::min(job.size[0], 256);
+        const int height = std::max(1, static_cast<int>(static_cast<int64_t>(job.size[1]) * width / job.size[0]));
+        generator_.setSize({width, height});
+        generator_.setAutoIterations(true);
+        generator_.computeIterations();
+        generator_.setAutoIterations(false);
+        generator_.setSize(job.size);
+        render.maxIterations = generator_.maxIterations();
+    } else if (render.maxIterations == 0) {
+        render.maxIterations = job.maxIterations;
+    }
+    generator_.setMaxIterations(render.maxIterations);
+    generator_.setAntiAliasing(job.antiAliasing);
+}
+
+bool RenderDaemon::render(const std::shared_ptr<Render>& render, std::stop_token stop) {
+    const RenderJob& job = render->job;
+    configure(*render);
+    if (!render->started) {
+        render->started = true;
+        render->start = Clock::now();
+        render->pixels.resize(static_cast<size_t>(job.size[0]) * job.size[1] * 4);
+        std::lock_guard lock(mutex_);
+        ++stats_.renders;
+    }
+
+    const size_t bytesPerRow = static_cast<size_t>(job.size[0]) * 4;
+    while (render->rows < job.size[1]) {
+        std::vector<std::shared_ptr<Subscriber>> subscribers;
+        {
+            std::lock_guard lock(mutex_);
+            const bool wanted = std::any_of(render->subscribers.begin(), render->subscribers.end(),
+                                            [](const auto& subscriber) { return subscriber->connection->alive.load(); });
+            if (!wanted || stop.stop_requested()) {
+                inFlight_.erase(render->key);
+                ++stats_.cancelled;
+                return false;
+            }
+            // Preempted between bands, the rows done so far are kept for the rest
+            const auto& interactive = queues_[static_cast<int>(RenderPriority::Interactive)];
+            const bool waiting = std::any_of(interactive.begin(), interactive.end(), [](const auto& queued) {
+                return queued->queued && queued->priority == RenderPriority::Interactive;
+            });
+            if (render->priority == RenderPriority::Batch && waiting) {
+                render->queued = true;
+                queues_[static_cast<int>(RenderPriority::Batch)].push_front(render);
+                ++stats_.preemptions;
+                return false;
+            }
+            subscribers = render->subscribers;
+        }
+        // Subscribers which came while the previous band was rendered get the rows they missed
+        publish(subscribers, *render);
+
+        const int rows = std::min(job.bandRows, job.size[1] - render->rows);
+        generator_.render({{0, render->rows}, {job.size[0], rows}},
+                          render->pixels.data() + render->rows * bytesPerRow, bytesPerRow);
+        render->rows += rows;
+    }
+
+    std::vector<std::shared_ptr<Subscriber>> subscribers;
+    {
+        std::lock_guard lock(mutex_);
+        inFlight_.erase(render->key);
+        subscribers = render->subscribers;
+    }
+    publish(subscribers, *render);
+    const Clock::time_point end = Clock::now();
+    for (const std::shared_ptr<Subscriber>& subscriber : subscribers) {
+        const Clock::time_point start = std::max(render->start, subscriber->received);
+        const DoneMessage done{subscriber->requestId, seconds(start - subscriber->received), seconds(end - start),
+                               subscriber->coalesced};
+        subscriber->connection->post(RenderProtocol::encodeDone(done));
+    }
+    return true;
+}
+
+void RenderDaemon::publish(const std::vector<std::shared_ptr<Subscriber>>& subscribers, const Render& render) {
+    const size_t bytesPerRow = static_cast<size_t>(render.job.size[0]) * 4;
+    for (const std::shared_ptr<Subscriber>& subscriber : subscribers) {
+        Connection& connection = *subscriber->connection;
+        if (!subscriber->imageSent)
+            connection.post(RenderProtocol::encodeImage(subscriber->requestId, render.job.size));
+        subscriber->imageSent = true;
+        // Rows a late subscriber missed go band by band, no message outgrows a band
+        for (int y = subscriber->sentRows; y < render.rows; y += render.job.bandRows) {
+            const int rows = std::min(render.job.bandRows, render.rows - y);
+            if (!connection.post(RenderProtocol::encodeRows(subscriber->requestId, y, rows,
+                                                            render.pixels.data() + y * bytesPerRow,
+                                                            rows * bytesPerRow)))
+                break;
+        }
+        subscriber->sentRows = render.rows;
+    }
+}
+
+void RenderDaemon::fail(const std::shared_ptr<Render>& render, const std::string& what) {
+    std::vector<std::shared_ptr<Subscriber>> subscribers;
+    {
+        std::lock_guard lock(mutex_);
+        inFlight_.erase(render->key);
+        subscribers = render->subscribers;
+        ++stats_.failed;
+    }
+    for (const std::shared_ptr<Subscriber>& subscriber : subscribers)
+        subscriber->connection->post(RenderProtocol::encodeError(subscriber->requestId, what));
+}
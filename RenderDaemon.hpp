@@ -0,0 +1,127 @@
+#pragma once
+
+#include "MandelbrotSetGenerator.hpp"
+#include "RenderJob.hpp"
+#include "RenderProtocol.hpp"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+struct RenderDaemonStats {
+    size_t requests = 0;
+    size_t renders = 0;
+    size_t coalesced = 0;   // requests served by the render of an identical one
+    size_t preemptions = 0; // batch renders paused for interactive requests
+    size_t cancelled = 0;   // renders dropped when all their clients left
+    size_t failed = 0;
+};
+
+// Long-lived renderer behind a Unix domain socket, see RenderProtocol and RenderClient.
+// One warm generator renders every request band by band on a worker thread and streams the bands back,
+// so clients pay neither process startup nor backend initialization. Identical requests in flight are
+// rendered once for all of their clients. Interactive requests go before batch ones and a batch render
+// yields to them after its current band, it's resumed later from the next band.
+class RenderDaemon final {
+public:
+    RenderDaemon(const std::string& socketPath, BackendType backend = BackendType::Default,
+                 unsigned threadCount = std::thread::hardware_concurrency());
+    ~RenderDaemon();
+
+    RenderDaemon(const RenderDaemon&) = delete;
+    RenderDaemon& operator=(const RenderDaemon&) = delete;
+
+    // Accepts connections until stop()
+    void serve();
+    // Safe from signal handlers and other threads, serve() returns soon after
+    void stop();
+    RenderDaemonStats stats() const;
+    const char* backendName() const;
+private:
+    using Clock = std::chrono::steady_clock;
+
+    // Replies are queued and sent by the writer thread of the connection, so a client which doesn't read
+    // holds up neither the worker nor the other clients. Outlives its threads while renders hold it.
+    struct Connection {
+        int fd;
+        std::mutex mutex;
+        std::condition_variable_any outboxCv;
+        std::deque<std::vector<uint8_t>> outbox;
+        size_t outboxBytes = 0;
+        std::atomic<bool> alive{true};
+        std::atomic<bool> finished{false}; // the reader is done
+
+        explicit Connection(int fd);
+        ~Connection();
+        // False when the connection is gone, a client too far behind is dropped
+        bool post(std::vector<uint8_t> message);
+    };
+
+    struct Client {
+        std::shared_ptr<Connection> connection;
+        std::jthread reader;
+        std::jthread writer;
+    };
+
+    struct Subscriber {
+        std::shared_ptr<Connection> connection;
+        uint64_t requestId;
+        Clock::time_point received;
+        bool coalesced;
+        int sentRows = 0; // touched by the worker only
+        bool imageSent = false;
+    };
+
+    // One render shared by the subscribers of identical requests
+    struct Render {
+        std::string key;
+        RenderJob job;
+        RenderPriority priority;
+        std::vector<std::shared_ptr<Subscriber>> subscribers;
+        bool queued = true;
+        // Progress kept while a preempted render waits for its turn
+        bool started = false;
+        Clock::time_point start;
+        unsigned long maxIterations = 0; // picked once in auto mode
+        std::vector<uint8_t> pixels;
+        int rows = 0;
+    };
+
+    void read(const std::shared_ptr<Connection>& connection);
+    static void write(Connection& connection, std::stop_token stop);
+    void submit(const std::shared_ptr<Connection>& connection, const RequestMessage& request);
+    void run(std::stop_token stop);
+    // False when the render yielded to an interactive request or was dropped
+    bool render(const std::shared_ptr<Render>& render, std::stop_token stop);
+    void configure(Render& render);
+    void publish(const std::vector<std::shared_ptr<Subscriber>>& subscribers, const Render& render);
+    void fail(const std::shared_ptr<Render>& render, const std::string& what);
+    std::shared_ptr<Render> next();
+
+    // Warmed up before the socket is listened at, the first client doesn't wait for the backend
+    MandelbrotSetGenerator generator_; // touched by the worker thread only
+
+    std::string socketPath_;
+    int listenFd_;
+    std::atomic<bool> stopping_{false};
+
+    mutable std::mutex mutex_;
+    std::condition_variable_any requestCv_;
+    std::deque<std::shared_ptr<Render>> queues_[2]; // by RenderPriority
+    std::unordered_map<std::string, std::shared_ptr<Render>> inFlight_; // queued and rendering, by key
+    RenderDaemonStats stats_;
+
+    std::list<Client> clients_; // touched by serve() only
+
+    std::jthread worker_; // last member: it's started after everything above is ready
+};
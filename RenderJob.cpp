@@ -0,0 +1,179 @@
+#include "RenderJob.hpp"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+    Eigen::Vector2d parsePair(const std::string& value, char separator, const char* what) {
+        const size_t pos = value.find(separator);
+        if (pos == std::string::npos)
+            throw std::invalid_argument(std::string("Malformed ") + what + ": " + value);
+        try {
+            return {std::stod(value.substr(0, pos)), std::stod(value.substr(pos + 1))};
+        } catch (const std::logic_error&) {
+            throw std::invalid_argument(std::string("Malformed ") + what + ": " + value);
+        }
+    }
+
+    unsigned long parseUnsigned(const std::string& value, const char* what) {
+        try {
+            size_t parsed = 0;
+            const unsigned long result = std::stoul(value, &parsed);
+            if (parsed == value.size() && value[0] != '-')
+                return result;
+        } catch (const std::logic_error&) {
+        }
+        throw std::invalid_argument(std::string("Malformed ") + what + ": " + value);
+    }
+} // namespace
+
+namespace RenderJobs {
+
+Eigen::Vector2i parseSize(const std::string& value) {
+    const Eigen::Vector2d size = parsePair(value, 'x', "size");
+    if ((size.array() < 1.0).any())
+        throw std::invalid_argument("Size must be positive: " + value);
+    return size.cast<int>();
+}
+
+PrecisePoint parsePoint(const std::string& value) {
+    const size_t pos = value.find(',');
+    if (pos == std::string::npos)
+        throw std::invalid_argument("Malformed point: " + value);
+    return {DoubleDouble::fromString(value.substr(0, pos)), DoubleDouble::fromString(value.substr(pos + 1))};
+}
+
+RenderJob parse(const std::vector<std::string>& args, const RenderJob& base,
+                std::vector<std::string>* rest) {
+    RenderJob job = base;
+    for (size_t i = 0; i < args.size(); ++i) {
+        const std::string& option = args[i];
+        auto value = [&]() -> const std::string& {
+            if (i + 1 >= args.size())
+                throw std::invalid_argument("Missing value of " + option);
+            return args[++i];
+        };
+
+        if (option == "--size") {
+            job.size = parseSize(value());
+        } else if (option == "--center") {
+            job.center = parsePoint(value());
+        } else if (option == "--scale") {
+            job.scale = std::stod(value());
+        } else if (option == "--max-iterations") {
+            job.maxIterations = parseUnsigned(value(), "max iterations");
+        } else if (option == "--band-rows") {
+            job.bandRows = static_cast<int>(parseUnsigned(value(), "band rows"));
+        } else if (option == "--tile-size") {
+            job.tileSize = static_cast<int>(parseUnsigned(value(), "tile size"));
+        } else if (option == "--tiles") {
+            job.tiles = value();
+        } else if (option == "--pyramid") {
+            job.pyramid = value();
+        } else if (option == "--cache") {
+            job.cache = value();
+        } else if (option == "--levels") {
+            const std::string& levels = value();
+            const size_t dash = levels.find('-');
+            job.minLevel = static_cast<int>(parseUnsigned(levels.substr(0, dash), "levels"));
+            job.maxLevel = dash == std::string::npos
+                ? job.minLevel
+                : static_cast<int>(parseUnsigned(levels.substr(dash + 1), "levels"));
+        } else if (option == "--sequence") {
+            job.sequence = value();
+        } else if (option == "--fps") {
+            job.fps = std::stod(value());
+        } else if (option == "--reuse-tolerance") {
+            job.reuseTolerance = std::stof(value());
+        } else if (option == "--refresh") {
+            job.refreshInterval = static_cast<int>(parseUnsigned(value(), "refresh interval"));
+        } else if (option == "--antialias") {
+            job.antiAliasing.samples = static_cast<int>(parseUnsigned(value(), "samples per pixel"));
+        } else if (option == "--aa-pattern") {
+            job.antiAliasing.pattern = AntiAliasings::parsePattern(value());
+        } else if (option == "--aa-threshold") {
+            job.antiAliasing.threshold = std::stof(value());
+        } else if (option == "--formula") {
+            job.formula.type = Formulas::parseType(value());
+        } else if (option == "--power") {
+            job.formula.power = static_cast<int>(parseUnsigned(value(), "power"));
+        } else if (option == "--julia") {
+            const Eigen::Vector2d c = parsePair(value(), ',', "julia constant");
+            job.formula.juliaX = static_cast<float>(c[0]);
+            job.formula.juliaY = static_cast<float>(c[1]);
+        } else if (option == "--precision") {
+            job.precision = Precisions::parse(value());
+        } else if (option == "--snapshot") {
+            job.snapshot = value();
+        } else if (option == "--from-snapshot") {
+            job.fromSnapshot = value();
+        } else if (option == "--crop") {
+            const std::string& crop = value();
+            const size_t comma = crop.rfind(',');
+            if (comma == std::string::npos)
+                throw std::invalid_argument("Malformed crop: " + crop);
+            const Eigen::Vector2d origin = parsePair(crop.substr(0, comma), ',', "crop");
+            if ((origin.array() < 0.0).any())
+                throw std::invalid_argument("Crop origin must not be negative: " + crop);
+            job.cropOrigin = origin.cast<int>();
+            job.cropSize = parseSize(crop.substr(comma + 1));
+        } else if (option == "--thumbnail") {
+            job.thumbnailWidth = static_cast<int>(parseUnsigned(value(), "thumbnail width"));
+        } else if (option == "--auto-iterations") {
+            job.autoIterations = true;
+        } else if (option == "--deep-zoom") {
+            job.deepZoom = true;
+        } else if (option == "--bulb-check") {
+            job.bulbCheck = true;
+        } else if (option == "--periodicity-check") {
+            job.periodicityCheck = true;
+        } else if (option == "--boundary-trace") {
+            job.boundaryTrace = true;
+        } else if (option == "--palette") {
+            job.palette = value();
+        } else if (option == "--output") {
+            job.output = value();
+        } else if (rest != nullptr) {
+            rest->push_back(option);
+        } else {
+            throw std::invalid_argument("Unknown option " + option);
+        }
+    }
+    if (job.maxIterations == 0 || job.bandRows <= 0 || job.scale <= 0.0)
+        throw std::invalid_argument("Scale, max iterations and band rows must be positive");
+    if (job.fps <= 0.0 || job.reuseTolerance < 0.0f)
+        throw std::invalid_argument("Frame rate must be positive and reuse tolerance not negative");
+    AntiAliasings::validate(job.antiAliasing);
+    Formulas::validate(job.formula);
+    return job;
+}
+
+std::vector<std::vector<std::string>> readLines(const std::string& path) {
+    std::ifstream file(path);
+    if (!file)
+        throw std::runtime_error("Unable to open job file " + path);
+
+    std::vector<std::vector<std::string>> lines;
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::vector<std::string> args;
+        for (std::string word; words >> word;)
+            args.push_back(word);
+        if (!args.empty())
+            lines.push_back(std::move(args));
+    }
+    return lines;
+}
+
+std::vector<RenderJob> readFile(const std::string& path, const RenderJob& base) {
+    std::vector<RenderJob> jobs;
+    for (const std::vector<std::string>& args : readLines(path))
+        jobs.push_back(parse(args, base));
+    return jobs;
+}
+
+} // namespace RenderJobs
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "AntiAliasing.hpp"
+#include "DoubleDouble.hpp"
+#include "Formula.hpp"
+#include "Precision.hpp"
+
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+
+// One image of the headless renderer: the view, the output file and how to stream it
+struct RenderJob {
+    Eigen::Vector2i size{1920, 1080};
+    PrecisePoint center{-0.5, 0.0};
+    double scale = 3.0;
+    unsigned long maxIterations = 350;
+    bool autoIterations = false; // maxIterations is picked from a preview then
+    Precision precision = Precision::Auto;
+    bool deepZoom = false;
+    bool bulbCheck = false;
+    bool periodicityCheck = false;
+    Formula formula;
+    bool boundaryTrace = false;
+    AntiAliasing antiAliasing; // bands and tiles only
+    int bandRows = 256;
+    // Tiled mode when positive: tiles are rendered into a resumable container first
+    int tileSize = 0;
+    std::string tiles; // container file, output + ".tiles" by default
+    std::string palette = "rainbow";
+    std::string output;
+    // Iteration counts of the image are saved there too, see IterationSnapshot
+    std::string snapshot;
+    // Recolor mode when set: output is colored from the counts of this snapshot, nothing is rendered.
+    // The crop (the whole snapshot when empty) is scaled down to thumbnailWidth pixels if it's given.
+    std::string fromSnapshot;
+    Eigen::Vector2i cropOrigin{0, 0};
+    Eigen::Vector2i cropSize{0, 0};
+    int thumbnailWidth = 0;
+    // Tile pyramid mode when set, see TilePyramid
+    std::string pyramid;
+    std::string cache;
+    int minLevel = 0;
+    int maxLevel = 0;
+    // Zoom video mode when set, see ZoomSequence
+    std::string sequence;
+    double fps = 30.0;
+    float reuseTolerance = 0.1f;
+    int refreshInterval = 30;
+};
+
+namespace RenderJobs {
+
+// Applies "--option value" pairs on top of `base`:
+//   --size WxH, --center X,Y, --scale S, --max-iterations N, --band-rows N, --tile-size N, --tiles FILE,
+//   --palette NAME|FILE, --output FILE, --pyramid DIR, --cache DIR, --levels MIN-MAX,
+//   --sequence FILE, --fps N, --reuse-tolerance T, --refresh N, --antialias N, --aa-pattern NAME, --aa-threshold T,
+//   --formula NAME, --power N, --julia X,Y, --precision NAME, --snapshot FILE, --from-snapshot FILE,
+//   --crop X,Y,WxH, --thumbnail W
+// and the --auto-iterations, --deep-zoom, --bulb-check, --periodicity-check,
+// --boundary-trace flags. The center keeps all digits given, up to double-double precision.
+// Unknown options are returned in `rest` (if given) instead of raising an error.
+RenderJob parse(const std::vector<std::string>& args, const RenderJob& base = {},
+                std::vector<std::string>* rest = nullptr);
+// Job file holds one job per line with the same options as the command line, '#' starts a comment
+std::vector<RenderJob> readFile(const std::string& path, const RenderJob& base = {});
+// Options of every job of the file, unparsed, e.g. to send them to the render daemon
+std::vector<std::vector<std::string>> readLines(const std::string& path);
+
+Eigen::Vector2i parseSize(const std::string& value);
+PrecisePoint parsePoint(const std::string& value);
+
+} // namespace RenderJobs
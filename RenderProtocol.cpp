@@ -0,0 +1,294 @@
+#include "RenderProtocol.hpp"
+
+#include <fmt/format.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <initializer_list>
+#include <stdexcept>
+
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    struct FrameHeader {
+        uint32_t bytes; // of the payload
+        uint8_t type;
+        uint8_t reserved[3];
+    };
+
+    struct RequestHeader {
+        uint64_t id;
+        uint8_t priority;
+        uint8_t reserved[7];
+    };
+
+    struct ImagePayload {
+        uint64_t id;
+        int32_t width;
+        int32_t height;
+    };
+
+    struct RowsHeader {
+        uint64_t id;
+        int32_t y;
+        int32_t rows;
+    };
+
+    struct DonePayload {
+        uint64_t id;
+        double queuedSeconds;
+        double renderSeconds;
+        uint8_t coalesced;
+        uint8_t reserved[7];
+    };
+
+    struct ErrorHeader {
+        uint64_t id;
+    };
+
+    static_assert(sizeof(FrameHeader) == RenderProtocol::frameHeaderBytes);
+    static_assert(sizeof(RowsHeader) == RenderProtocol::rowsHeaderBytes);
+
+    // Linux has no SO_NOSIGPIPE, the flag of every send does the same there
+#ifdef MSG_NOSIGNAL
+    constexpr int sendFlags = MSG_NOSIGNAL;
+#else
+    constexpr int sendFlags = 0;
+#endif
+
+    std::runtime_error socketError(const std::string& what) {
+        const std::string reason = std::strerror(errno);
+        return std::runtime_error(what + ": " + reason);
+    }
+
+    sockaddr_un addressOf(const std::string& path) {
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(address.sun_path))
+            throw std::invalid_argument("Socket path is too long: " + path);
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+        return address;
+    }
+
+    struct Part {
+        const void* data;
+        size_t bytes;
+    };
+
+    // Frame header followed by the parts
+    std::vector<uint8_t> encode(MessageType type, std::initializer_list<Part> parts) {
+        size_t bytes = 0;
+        for (const Part& part : parts)
+            bytes += part.bytes;
+        if (bytes > UINT32_MAX)
+            throw std::invalid_argument("Message is too large");
+        const FrameHeader header{static_cast<uint32_t>(bytes), static_cast<uint8_t>(type), {}};
+        std::vector<uint8_t> message(sizeof(header) + bytes);
+        std::memcpy(message.data(), &header, sizeof(header));
+        uint8_t* out = message.data() + sizeof(header);
+        for (const Part& part : parts) {
+            if (part.bytes > 0)
+                std::memcpy(out, part.data, part.bytes);
+            out += part.bytes;
+        }
+        return message;
+    }
+
+    // False on the end of the stream before the first byte
+    bool receive(int fd, void* dst, size_t bytes) {
+        uint8_t* out = static_cast<uint8_t*>(dst);
+        size_t done = 0;
+        while (done < bytes) {
+            const ssize_t received = ::recv(fd, out + done, bytes - done, 0);
+            if (received < 0 && errno == EINTR)
+                continue;
+            if (received < 0)
+                throw socketError("Unable to receive");
+            if (received == 0) {
+                if (done == 0)
+                    return false;
+                throw std::runtime_error("Connection closed in the middle of a message");
+            }
+            done += static_cast<size_t>(received);
+        }
+        return true;
+    }
+
+    template<typename T>
+    T fixedPart(const Message& message, MessageType type) {
+        if (message.type != type || message.payload.size() < sizeof(T))
+            throw std::runtime_error("Malformed message");
+        T value;
+        std::memcpy(&value, message.payload.data(), sizeof(value));
+        return value;
+    }
+} // namespace
+
+namespace RenderProtocol {
+
+std::string defaultSocketPath() {
+    if (const char* runtime = std::getenv("XDG_RUNTIME_DIR"); runtime != nullptr && *runtime != '\0')
+        return std::string(runtime) + "/mandelbrot.sock";
+    return fmt::format("/tmp/mandelbrot-{}.sock", ::getuid());
+}
+
+int listen(const std::string& path) {
+    const sockaddr_un address = addressOf(path);
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw socketError("Unable to create a socket");
+    // A socket file nobody accepts on is left from a crashed daemon, one of a running daemon is kept.
+    // Anything but a socket is never removed.
+    struct stat status;
+    if (::lstat(path.c_str(), &status) == 0) {
+        if (!S_ISSOCK(status.st_mode)) {
+            ::close(fd);
+            throw std::runtime_error(path + " exists and isn't a socket");
+        }
+        const int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        if (probe >= 0) {
+            const bool running = ::connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+            ::close(probe);
+            if (running) {
+                ::close(fd);
+                throw std::runtime_error("A daemon already listens at " + path);
+            }
+        }
+        ::unlink(path.c_str());
+    }
+    if (::bind(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 || ::listen(fd, 64) != 0) {
+        const std::runtime_error error = socketError("Unable to listen at " + path);
+        ::close(fd);
+        throw error;
+    }
+    return fd;
+}
+
+int connect(const std::string& path) {
+    const sockaddr_un address = addressOf(path);
+    const int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0)
+        throw socketError("Unable to create a socket");
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        const std::runtime_error error = socketError("No render daemon at " + path);
+        ::close(fd);
+        throw error;
+    }
+    disableSigpipe(fd);
+    return fd;
+}
+
+void disableSigpipe([[maybe_unused]] int fd) {
+#ifdef SO_NOSIGPIPE
+    const int on = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &on, sizeof(on));
+#endif
+}
+
+void send(int fd, const std::vector<uint8_t>& message) {
+    size_t done = 0;
+    while (done < message.size()) {
+        const ssize_t sent = ::send(fd, message.data() + done, message.size() - done, sendFlags);
+        if (sent < 0 && errno == EINTR)
+            continue;
+        if (sent < 0)
+            throw socketError("Unable to send");
+        done += static_cast<size_t>(sent);
+    }
+}
+
+bool read(int fd, Message& message, size_t maxPayload) {
+    FrameHeader header;
+    if (!receive(fd, &header, sizeof(header)))
+        return false;
+    if (header.bytes > maxPayload)
+        throw std::runtime_error(fmt::format("Message of {} bytes is over the limit of {}", header.bytes, maxPayload));
+    message.type = static_cast<MessageType>(header.type);
+    message.payload.resize(header.bytes);
+    if (header.bytes > 0 && !receive(fd, message.payload.data(), header.bytes))
+        throw std::runtime_error("Connection closed in the middle of a message");
+    return true;
+}
+
+std::vector<uint8_t> encodeRequest(const RequestMessage& request) {
+    const RequestHeader header{request.id, static_cast<uint8_t>(request.priority), {}};
+    std::string options;
+    for (const std::string& option : request.options) {
+        options += option;
+        options += '\0';
+    }
+    return encode(MessageType::Request, {{&header, sizeof(header)}, {options.data(), options.size()}});
+}
+
+std::vector<uint8_t> encodeImage(uint64_t id, const Eigen::Vector2i& size) {
+    const ImagePayload payload{id, size[0], size[1]};
+    return encode(MessageType::Image, {{&payload, sizeof(payload)}});
+}
+
+std::vector<uint8_t> encodeRows(uint64_t id, int y, int rows, const uint8_t* rgba, size_t bytes) {
+    const RowsHeader header{id, y, rows};
+    return encode(MessageType::Rows, {{&header, sizeof(header)}, {rgba, bytes}});
+}
+
+std::vector<uint8_t> encodeDone(const DoneMessage& done) {
+    const DonePayload payload{done.id, done.queuedSeconds, done.renderSeconds, done.coalesced, {}};
+    return encode(MessageType::Done, {{&payload, sizeof(payload)}});
+}
+
+std::vector<uint8_t> encodeError(uint64_t id, const std::string& what) {
+    const ErrorHeader header{id};
+    return encode(MessageType::Error, {{&header, sizeof(header)}, {what.data(), what.size()}});
+}
+
+RequestMessage parseRequest(const Message& message) {
+    const RequestHeader header = fixedPart<RequestHeader>(message, MessageType::Request);
+    if (header.priority > static_cast<uint8_t>(RenderPriority::Batch))
+        throw std::runtime_error("Unknown request priority");
+    RequestMessage request{header.id, static_cast<RenderPriority>(header.priority), {}};
+    const char* begin = reinterpret_cast<const char*>(message.payload.data()) + sizeof(header);
+    const char* end = reinterpret_cast<const char*>(message.payload.data()) + message.payload.size();
+    while (begin < end) {
+        const char* terminator = std::find(begin, end, '\0');
+        if (terminator == end)
+            throw std::runtime_error("Unterminated request option");
+        request.options.emplace_back(begin, terminator);
+        begin = terminator + 1;
+    }
+    return request;
+}
+
+uint64_t parseImage(const Message& message, Eigen::Vector2i& size) {
+    const ImagePayload payload = fixedPart<ImagePayload>(message, MessageType::Image);
+    if (payload.width <= 0 || payload.height <= 0)
+        throw std::runtime_error("Malformed image size");
+    size = {payload.width, payload.height};
+    return payload.id;
+}
+
+uint64_t parseRows(const Message& message, int& y, int& rows, const uint8_t*& rgba, size_t& bytes) {
+    const RowsHeader header = fixedPart<RowsHeader>(message, MessageType::Rows);
+    y = header.y;
+    rows = header.rows;
+    rgba = message.payload.data() + sizeof(header);
+    bytes = message.payload.size() - sizeof(header);
+    return header.id;
+}
+
+DoneMessage parseDone(const Message& message) {
+    const DonePayload payload = fixedPart<DonePayload>(message, MessageType::Done);
+    return {payload.id, payload.queuedSeconds, payload.renderSeconds, payload.coalesced != 0};
+}
+
+uint64_t parseError(const Message& message, std::string& what) {
+    const ErrorHeader header = fixedPart<ErrorHeader>(message, MessageType::Error);
+    what.assign(reinterpret_cast<const char*>(message.payload.data()) + sizeof(header),
+                message.payload.size() - sizeof(header));
+    return header.id;
+}
+
+} // namespace RenderProtocol
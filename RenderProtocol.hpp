@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+
+// Framed messages between the render daemon and its clients over a Unix domain socket.
+// A message is a header of the payload size and the type followed by the payload, fields in host byte
+// order like the other files of the project, the socket never leaves the machine.
+//   client: Request  id, priority, options of mandelbrot_batch separated by '\0'
+//   daemon: Image    id, size                   before the first rows of a request
+//           Rows     id, first row, row count, RGBA8 rows of the image width
+//           Done     id, timings, whether the render was shared with other requests
+//           Error    id, message                instead of Done, rows sent before it are void
+// Replies to different requests of a connection may interleave, ids tell them apart.
+
+enum class MessageType : uint8_t {
+    Request = 1,
+    Image,
+    Rows,
+    Done,
+    Error,
+};
+
+// Interactive requests are rendered before any batch one and preempt a batch render between bands
+enum class RenderPriority : uint8_t {
+    Interactive,
+    Batch,
+};
+
+struct Message {
+    MessageType type = MessageType::Request;
+    std::vector<uint8_t> payload;
+};
+
+struct RequestMessage {
+    uint64_t id = 0;
+    RenderPriority priority = RenderPriority::Batch;
+    std::vector<std::string> options;
+};
+
+struct DoneMessage {
+    uint64_t id = 0;
+    double queuedSeconds = 0.0; // from the request to the start of its render
+    double renderSeconds = 0.0; // from the start of the render to the last rows
+    bool coalesced = false;     // joined a render of an identical request
+};
+
+namespace RenderProtocol {
+
+// Largest payload either end accepts, a Rows message carries a band of rows at most this large
+constexpr size_t maxPayload = size_t(1) << 30;
+// Frame header of every message and the fields of a Rows payload before its pixels
+constexpr size_t frameHeaderBytes = 8;
+constexpr size_t rowsHeaderBytes = 16;
+
+// Daemon socket when none is given: $XDG_RUNTIME_DIR/mandelbrot.sock or /tmp/mandelbrot-UID.sock
+std::string defaultSocketPath();
+// Listening socket at `path`, a stale socket file left by a crashed daemon is replaced, other files are refused
+int listen(const std::string& path);
+// Connected socket, throws std::runtime_error when no daemon listens at `path`
+int connect(const std::string& path);
+// Sockets of both ends never raise SIGPIPE, writes to a closed peer throw instead
+void disableSigpipe(int fd);
+
+// Whole messages, to be sent or queued for a writer thread
+std::vector<uint8_t> encodeRequest(const RequestMessage& request);
+std::vector<uint8_t> encodeImage(uint64_t id, const Eigen::Vector2i& size);
+// `rows` packed rows of `bytes` in total
+std::vector<uint8_t> encodeRows(uint64_t id, int y, int rows, const uint8_t* rgba, size_t bytes);
+std::vector<uint8_t> encodeDone(const DoneMessage& done);
+std::vector<uint8_t> encodeError(uint64_t id, const std::string& what);
+
+// Sends the whole message, throws std::runtime_error when the peer is gone
+void send(int fd, const std::vector<uint8_t>& message);
+// False when the peer closed the connection between messages, throws on errors and on payloads over maxPayload
+bool read(int fd, Message& message, size_t maxPayload);
+
+// Payload decoders, they throw std::runtime_error on malformed payloads
+RequestMessage parseRequest(const Message& message);
+uint64_t parseImage(const Message& message, Eigen::Vector2i& size);
+// Points `rgba` into the payload, `bytes` long
+uint64_t parseRows(const Message& message, int& y, int& rows, const uint8_t*& rgba, size_t& bytes);
+DoneMessage parseDone(const Message& message);
+uint64_t parseError(const Message& message, std::string& what);
+
+} // namespace RenderProtocol
@@ -0,0 +1,154 @@
+#include "RenderService.hpp"
+
+#include "Log.hpp"
+
+#include <algorithm>
+#include <utility>
+
+namespace {
+    // Everything but the palette, which only needs recoloring
+    bool sameView(const RenderRequest& a, const RenderRequest& b) {
+        return a.size == b.size && a.center == b.center && a.scale == b.scale &&
+               a.autoIterations == b.autoIterations && (a.autoIterations || a.maxIterations == b.maxIterations) &&
+               a.precision == b.precision && a.deepZoom == b.deepZoom &&
+               a.bulbCheck == b.bulbCheck && a.periodicityCheck == b.periodicityCheck && a.formula == b.formula &&
+               a.boundaryTrace == b.boundaryTrace && a.antiAliasing == b.antiAliasing;
+    }
+} // namespace
+
+void RenderRequest::pan(const Eigen::Vector2i& pixels) {
+    center.x = center.x + DoubleDouble(scale) * static_cast<double>(pixels[0]) / static_cast<double>(size[0]);
+    center.y = center.y + DoubleDouble(scale) * static_cast<double>(pixels[1]) / static_cast<double>(size[1]);
+}
+
+RenderService::RenderService(BackendType backend, unsigned threadCount, size_t tileCacheBytes)
+    : generator_(backend, threadCount) {
+    generator_.setIncremental(true);
+    generator_.setTileCacheCapacity(tileCacheBytes);
+    worker_ = std::jthread([this](std::stop_token stop) { run(stop); });
+}
+
+RenderService::~RenderService() {
+    {
+        std::lock_guard lock(requestMutex_);
+        cancel_.request_stop();
+    }
+    worker_.request_stop();
+    worker_.join();
+}
+
+uint64_t RenderService::post(const RenderRequest& request) {
+    std::lock_guard lock(requestMutex_);
+    pending_ = request;
+    cancel_.request_stop();
+    requestCv_.notify_one();
+    return ++lastId_;
+}
+
+const RenderFrame* RenderService::latestFrame() {
+    std::lock_guard lock(frameMutex_);
+    if (!fresh_)
+        return nullptr;
+    std::swap(front_, ready_);
+    fresh_ = false;
+    return &frames_[front_];
+}
+
+const char* RenderService::backendName() const {
+    return generator_.backendName();
+}
+
+void RenderService::run(std::stop_token stop) {
+    while (true) {
+        RenderRequest request;
+        uint64_t id;
+        std::stop_token cancel;
+        {
+            std::unique_lock lock(requestMutex_);
+            if (!requestCv_.wait(lock, stop, [this] { return pending_.has_value(); }))
+                return;
+            request = std::move(*pending_);
+            pending_.reset();
+            id = lastId_;
+            cancel_ = std::stop_source();
+            cancel = cancel_.get_token();
+        }
+        try {
+            render(request, id, cancel);
+        } catch (const RenderCancelled&) {
+            // Superseded by a newer request, it's already pending
+        } catch (const std::exception& e) {
+            Log::error("Render of request {} failed: {}", id, e.what());
+        }
+    }
+}
+
+void RenderService::render(const RenderRequest& request, uint64_t id, std::stop_token cancel) {
+    generator_.setStopToken(cancel);
+    if (request.palette != generator_.palette().name())
+        generator_.setPalette(Palettes::byName(request.palette));
+    generator_.resetMetrics();
+
+    auto publishPass = [&](int step) {
+        RenderFrame& frame = backFrame();
+        // The buffers keep their capacity, frames of an unchanged size allocate nothing
+        frame.pixels.resize(static_cast<size_t>(request.size.prod()) * 4);
+        generator_.colorize(frame.pixels.data(), static_cast<size_t>(request.size[0]) * 4);
+        frame.size = request.size;
+        frame.requestId = id;
+        frame.step = step;
+        frame.maxIterations = generator_.iterationsLimit();
+        frame.precision = generator_.renderPrecision();
+        frame.shortcutStats = generator_.shortcutStats();
+        frame.tileCacheStats = generator_.tileCacheStats();
+        frame.metrics = generator_.metrics();
+        frame.metrics.frame = id;
+        frame.metrics.step = step;
+        generator_.resetMetrics();
+        publish();
+    };
+
+    // Cancelled renders drop the iterations, so kept ones are always complete
+    const bool complete = !generator_.iterations().empty() && generator_.refinementStep() == 0;
+    if (complete && sameView(request, applied_)) {
+        publishPass(1);
+        applied_ = request;
+        return;
+    }
+
+    generator_.setSize(request.size);
+    generator_.setPreciseCenter(request.center);
+    generator_.setPreciseScale(request.scale);
+    // In auto mode the generator keeps the limit it picked, the requested one only starts it
+    if (!request.autoIterations || !generator_.autoIterations())
+        generator_.setMaxIterations(request.maxIterations);
+    generator_.setAutoIterations(request.autoIterations);
+    generator_.setPrecision(request.precision);
+    generator_.setDeepZoom(request.deepZoom);
+    generator_.setBulbCheck(request.bulbCheck);
+    generator_.setPeriodicityCheck(request.periodicityCheck);
+    generator_.setFormula(request.formula);
+    generator_.setRenderStrategy(request.boundaryTrace ? RenderStrategy::BoundaryTrace : RenderStrategy::PerPixel);
+    generator_.setAntiAliasing(request.antiAliasing);
+    generator_.resetShortcutStats();
+
+    generator_.startRefinement();
+    bool more = true;
+    while (more) {
+        const int step = std::max(generator_.refinementStep(), 1);
+        more = generator_.refine();
+        publishPass(step);
+    }
+    applied_ = request;
+}
+
+RenderFrame& RenderService::backFrame() {
+    // back_ is swapped by the worker only, no lock is needed to read it here
+    return frames_[back_];
+}
+
+void RenderService::publish() {
+    std::lock_guard lock(frameMutex_);
+    std::swap(back_, ready_);
+    fresh_ = true;
+}
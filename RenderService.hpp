@@ -0,0 +1,100 @@
+#pragma once
+
+#include "MandelbrotSetGenerator.hpp"
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <stop_token>
+#include <string>
+#include <thread>
+#include <vector>
+#include <Eigen/Dense>
+
+// Everything the UI asks the render service for
+struct RenderRequest {
+    Eigen::Vector2i size{0, 0};
+    PrecisePoint center{-0.5, 0.0};
+    double scale = 3.0;
+    unsigned long maxIterations = 350;
+    // maxIterations is only the starting point of the generator's auto mode then
+    bool autoIterations = false;
+    Precision precision = Precision::Auto;
+    bool deepZoom = false;
+    bool bulbCheck = false;
+    bool periodicityCheck = false;
+    Formula formula;
+    // Mariani-Silver tracing instead of computing every pixel, see MandelbrotSetGenerator::setRenderStrategy()
+    bool boundaryTrace = false;
+    AntiAliasing antiAliasing;
+    std::string palette = "rainbow";
+
+    // Moves the center by whole pixels, see MandelbrotSetGenerator::pan()
+    void pan(const Eigen::Vector2i& pixels);
+};
+
+// RGBA8 image published by the render service
+struct RenderFrame {
+    std::vector<uint8_t> pixels;
+    Eigen::Vector2i size{0, 0};
+    uint64_t requestId = 0;
+    // Pixel step of the progressive pass, 1 for the final image
+    int step = 1;
+    // Iteration limit of the pass, the one picked by the generator in auto mode
+    unsigned long maxIterations = 0;
+    // Precision the pass was computed in, the one picked by the generator in auto mode
+    Precision precision = Precision::Float;
+    ShortcutStats shortcutStats;
+    TileCacheStats tileCacheStats;
+    // Render side of the pass: backend stages, colorize and pixel counts, the viewer adds upload and present
+    FrameMetrics metrics;
+};
+
+// Renders on a background thread so the UI never waits for the compute backend.
+// post() replaces whatever view is pending and cancels the one being rendered,
+// the worker publishes every progressive pass into a triple buffer and the UI
+// picks the newest complete frame with latestFrame().
+class RenderService final {
+public:
+    // Iterations of the views seen recently are kept in a tile cache of tileCacheBytes
+    explicit RenderService(BackendType backend = BackendType::Default,
+                           unsigned threadCount = std::thread::hardware_concurrency(),
+                           size_t tileCacheBytes = size_t(256) << 20);
+    ~RenderService();
+
+    RenderService(const RenderService&) = delete;
+    RenderService& operator=(const RenderService&) = delete;
+
+    // Returns the id of the request, frames carry it back
+    uint64_t post(const RenderRequest& request);
+    // Newest frame published since the last call or nullptr. The frame stays valid
+    // and untouched by the worker until the next call.
+    const RenderFrame* latestFrame();
+    const char* backendName() const;
+private:
+    void run(std::stop_token stop);
+    void render(const RenderRequest& request, uint64_t id, std::stop_token cancel);
+    RenderFrame& backFrame();
+    void publish();
+
+    MandelbrotSetGenerator generator_; // touched by the worker thread only
+    RenderRequest applied_;            // view the generator has iterations for
+
+    std::mutex requestMutex_;
+    std::condition_variable_any requestCv_;
+    std::optional<RenderRequest> pending_;
+    uint64_t lastId_ = 0;
+    std::stop_source cancel_; // of the request being rendered
+
+    // Triple buffer: the worker writes back_, ready_ is the newest complete frame, front_ belongs to the UI
+    std::mutex frameMutex_;
+    std::array<RenderFrame, 3> frames_;
+    int back_ = 0;
+    int ready_ = 1;
+    int front_ = 2;
+    bool fresh_ = false;
+
+    std::jthread worker_; // last member: it's started after everything above is ready
+};
@@ -1,8 +1,9 @@
 #include "SDLApp.hpp"
 
+#include <cstring>
+
 SDLApp::SDLApp()
-    : surface_(nullptr, SDL_FreeSurface),
-      texture_(nullptr, SDL_DestroyTexture),
+    : texture_(nullptr, SDL_DestroyTexture),
       done_(false),
       fullScreen_(false)
 {
@@ -14,14 +15,10 @@ SDLApp::SDLApp()
 
     initWindow();
     initRenderer();
-    initMandelbrotGenerator();
-
-    rawImage_ = drawer_.getImage();
-
-    initSurface();
-    initTexture();
+    initView();
     destRect_ = getDestinationRect();
     initImGui();
+    service_.post(view_);
 }
 
 SDLApp::~SDLApp() {
@@ -84,37 +81,78 @@ void SDLApp::updateRendererScale() {
                 rendererScale_[0], rendererScale_[1]);
 }
 
-void SDLApp::initMandelbrotGenerator() {
-    const float scale(1/6.290223e+3);
-    const float centerX(-1.186592e+0);
-    const float centerY(-1.901211e-1);
+void SDLApp::initView() {
+    const double scale(1/6.290223e+3);
+    const double centerX(-1.186592e+0);
+    const double centerY(-1.901211e-1);
     const unsigned long maxIt(350);
 
-    drawer_.setSize({rendererRect_.w, rendererRect_.h});
-    drawer_.setCenter({centerX, centerY});
-    drawer_.setScale(scale);
-    drawer_.setMaxIterations(maxIt);
-}
-
-void SDLApp::initSurface() {
-    surface_.reset(SDL_CreateRGBSurfaceFrom(rawImage_.get(),
-                                            rendererRect_.w,
-                                            rendererRect_.h,
-                                            32, 0,
-                                            0xFF000000, 0x00FF0000, 0x0000FF00, 0x000000FF));
+    view_.size = {rendererRect_.w, rendererRect_.h};
+    view_.center = {centerX, centerY};
+    view_.scale = scale;
+    view_.maxIterations = maxIt;
 }
 
-void SDLApp::initTexture() {
-    texture_.reset(SDL_CreateTextureFromSurface(renderer_.get(), surface_.get()));
-    SDL_UpdateTexture(texture_.get(), NULL, rawImage_.get(), rendererRect_.w * 4);
+// Streaming texture of the frame size, frames are RGBA8 in memory order
+void SDLApp::initTexture(const Eigen::Vector2i& size) {
+    texture_.reset(SDL_CreateTexture(renderer_.get(),
+                                     SDL_PIXELFORMAT_RGBA32,
+                                     SDL_TEXTUREACCESS_STREAMING,
+                                     size[0], size[1]));
+    textureSize_ = size;
 }
 
 void SDLApp::initImGui() {
     gui_.reset(new ImGuiHandler(window_, renderer_));
     gui_->setSize({windowRect_.w, windowRect_.h});
-    gui_->setScale(drawer_.scale());
-    gui_->setCenter(drawer_.center());
-    gui_->setMaxIterations(drawer_.maxIterations());
+    gui_->setScale(view_.scale);
+    gui_->setCenter({static_cast<double>(view_.center.x), static_cast<double>(view_.center.y)});
+    gui_->setMaxIterations(view_.maxIterations);
+    gui_->setAutoIterations(view_.autoIterations);
+    gui_->setBulbCheck(view_.bulbCheck);
+    gui_->setPeriodicityCheck(view_.periodicityCheck);
+    gui_->setFormula(view_.formula);
+    gui_->setPrecision(view_.precision);
+    gui_->setBoundaryTrace(view_.boundaryTrace);
+    gui_->setAntiAliasing(view_.antiAliasing);
+    gui_->setPalette(view_.palette);
+}
+
+// Rendering happens on the service's thread, the UI only copies the newest finished pass
+void SDLApp::uploadLatestFrame() {
+    const RenderFrame* frame = service_.latestFrame();
+    if (frame == nullptr)
+        return;
+    const double uploadStart = Metrics::nowUs();
+    if (frame->size != textureSize_)
+        initTexture(frame->size);
+
+    // One copy straight into the memory of the streaming texture
+    void* pixels;
+    int pitch;
+    if (SDL_LockTexture(texture_.get(), nullptr, &pixels, &pitch) != 0) {
+        SDL_LogError(SDL_LOG_CATEGORY_RENDER, "Unable to lock texture: %s", SDL_GetError());
+        return;
+    }
+    const size_t rowBytes = static_cast<size_t>(frame->size[0]) * 4;
+    if (static_cast<size_t>(pitch) == rowBytes) {
+        std::memcpy(pixels, frame->pixels.data(), frame->pixels.size());
+    } else {
+        for (int y = 0; y < frame->size[1]; ++y)
+            std::memcpy(static_cast<uint8_t*>(pixels) + y * pitch, frame->pixels.data() + y * rowBytes, rowBytes);
+    }
+    SDL_UnlockTexture(texture_.get());
+    shownMetrics_ = frame->metrics;
+    shownMetrics_.addSpan(FrameStage::Upload, uploadStart, Metrics::nowUs() - uploadStart);
+    presentPending_ = true;
+    if (frame->step == 1) {
+        gui_->setShortcutStats(frame->shortcutStats);
+        // The panel shows the limit auto mode settled on
+        if (view_.autoIterations)
+            gui_->setMaxIterations(frame->maxIterations);
+    }
+    gui_->setTileCacheStats(frame->tileCacheStats);
+    gui_->setFramePrecision(frame->precision);
 }
 
 SDL_Rect SDLApp::getDestinationRect() {
@@ -131,28 +169,44 @@ void SDLApp::exec() {
     while (!done_) {
         pollEvent();
 
-        if (drawer_.scale() != gui_->scale()) {
-            drawer_.setScale(gui_->scale());
-        }
-        if (drawer_.center() != gui_->center()) {
-            drawer_.setCenter(gui_->center());
+        // A new palette only recolors the kept iteration counts
+        if (view_.palette != gui_->palette() && !gui_->updateRequested()) {
+            view_.palette = gui_->palette();
+            service_.post(view_);
         }
-        if (drawer_.maxIterations() != gui_->maxIterations()) {
-            drawer_.setMaxIterations(gui_->maxIterations());
+        // Dragging moves the view by whole pixels, so only the exposed strips are computed
+        const Eigen::Vector2i dragStep = dragPixels_.array().round().cast<int>();
+        if (!dragStep.isZero() && !gui_->updateRequested()) {
+            dragPixels_ -= dragStep.cast<float>();
+            view_.pan(-dragStep);
+            gui_->setCenter({static_cast<double>(view_.center.x), static_cast<double>(view_.center.y)});
+            service_.post(view_);
         }
         if (gui_->updateRequested()) {
-            rawImage_ = drawer_.getImage();
+            // The panel shows doubles, untouched fields keep the double-double values of the view
+            if (gui_->scale() != view_.scale)
+                view_.scale = gui_->scale();
+            if (gui_->center() != Eigen::Vector2d(static_cast<double>(view_.center.x), static_cast<double>(view_.center.y)))
+                view_.center = {gui_->center()[0], gui_->center()[1]};
+            view_.maxIterations = gui_->maxIterations();
+            view_.autoIterations = gui_->autoIterations();
+            view_.bulbCheck = gui_->bulbCheck();
+            view_.periodicityCheck = gui_->periodicityCheck();
+            view_.formula = gui_->formula();
+            view_.precision = gui_->precision();
+            view_.boundaryTrace = gui_->boundaryTrace();
+            view_.antiAliasing = gui_->antiAliasing();
+            view_.palette = gui_->palette();
+            service_.post(view_);
             gui_->resetUpdate();
-
-            initSurface();
-            //SDL_UpdateTexture(texture_.get(), NULL, surface_->pixels, surface_->pitch);
-            SDL_UpdateTexture(texture_.get(), NULL, rawImage_.get(), rendererRect_.w * 4);
             destRect_ = getDestinationRect();
         }
+        uploadLatestFrame();
         gui_->render();
 
         SDL_RenderSetScale(renderer_.get(), rendererScale_[0], rendererScale_[1]);
         //SDL_RenderSetScale(renderer_.get(), io_.DisplayFramebufferScale.x, io_.DisplayFramebufferScale.y);
+        const double presentStart = Metrics::nowUs();
 
         SDL_SetRenderDrawColor(renderer_.get(),
                                static_cast<Uint8>(bgColor_[0]),
@@ -164,6 +218,22 @@ void SDLApp::exec() {
 
         gui_->draw();
         SDL_RenderPresent(renderer_.get());
+        if (presentPending_) {
+            shownMetrics_.addSpan(FrameStage::Present, presentStart, Metrics::nowUs() - presentStart);
+            trace_.record(shownMetrics_);
+            gui_->setFrameMetrics(shownMetrics_);
+            presentPending_ = false;
+        }
+        if (gui_->traceRequested()) {
+            const char* path = "mandelbrot_trace.json";
+            try {
+                trace_.writeChromeTrace(path);
+                SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Trace of %zu frames saved to %s", trace_.frames().size(), path);
+            } catch (const std::exception& e) {
+                SDL_LogError(SDL_LOG_CATEGORY_APPLICATION, "%s", e.what());
+            }
+            gui_->resetTraceRequest();
+        }
 
         if (fullScreen_ != gui_->fullScreen()) {
             if (gui_->fullScreen()) {
@@ -193,18 +263,19 @@ void SDLApp::pollEvent() {
                 windowRect_.h = event.window.data2;
                 rendererRect_ = getRendererRect();
 
-                drawer_.setSize({rendererRect_.w, rendererRect_.h});
+                view_.size = {rendererRect_.w, rendererRect_.h};
                 gui_->setSize({windowRect_.w, windowRect_.h});
                 SDL_LogInfo(SDL_LOG_CATEGORY_APPLICATION, "Size changed to %dx%d", windowRect_.w, windowRect_.h);
 
-                rawImage_ = drawer_.getImage();
-
-                initSurface();
-                //SDL_UpdateTexture(texture_.get(), NULL, surface_->pixels, surface_->pitch);
-                SDL_UpdateTexture(texture_.get(), NULL, rawImage_.get(), rendererRect_.w * 4);
+                service_.post(view_);
                 destRect_ = getDestinationRect();
             }
         }
+        if (event.type == SDL_MOUSEMOTION && (event.motion.state & SDL_BUTTON_LMASK) && !gui_->wantsMouse()) {
+            // Window units to image pixels, the image is drawn scaled into destRect_
+            const float pixelsPerUnit = static_cast<float>(rendererRect_.w) / destRect_.w;
+            dragPixels_ += Eigen::Vector2f(event.motion.xrel, event.motion.yrel) * pixelsPerUnit;
+        }
         if (event.type == SDL_KEYDOWN) {
             if (event.key.keysym.sym == SDLK_LCTRL || event.key.keysym.sym == SDLK_RCTRL) {
                 controlMode_ = true;
@@ -1,7 +1,8 @@
 #pragma once
 #include "SDLTypes.hpp"
+#include "FrameMetrics.hpp"
 #include "ImGuiHandler.hpp"
-#include "MandelbrotSetGenerator.hpp"
+#include "RenderService.hpp"
 
 class SDLApp final {
 public:
@@ -14,10 +15,10 @@ private:
     SDL_Rect getRendererRect();
     Eigen::Vector2f getRendererScale();
     void updateRendererScale();
-    void initMandelbrotGenerator();
-    void initSurface();
-    void initTexture();
+    void initView();
+    void initTexture(const Eigen::Vector2i& size);
     void initImGui();
+    void uploadLatestFrame();
 
     void pollEvent();
 
@@ -28,15 +29,19 @@ private:
     SDL_Rect rendererRect_;
     SDLRendererPtr renderer_;
     Eigen::Vector2f rendererScale_;
-    MandelbrotSetGenerator drawer_;
-    RawBufferPtr rawImage_;
-    SDLSurfacePtr surface_;
+    RenderService service_;
+    RenderRequest view_; // last view posted to service_
     SDLTexturePtr texture_;
+    Eigen::Vector2i textureSize_{0, 0};
     SDL_Rect destRect_;
     std::unique_ptr<ImGuiHandler> gui_;
+    FrameTrace trace_;
+    FrameMetrics shownMetrics_; // of the last uploaded frame, present is added once it's on screen
+    bool presentPending_ = false;
     bool done_;
     bool fullScreen_;
     bool controlMode_;
+    Eigen::Vector2f dragPixels_{0.0f, 0.0f}; // drag distance not applied to the view yet
 
     const Eigen::Vector4i bgColor_{115, 140, 153, 255};
 };
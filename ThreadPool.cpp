@@ -0,0 +1,103 @@
+#include "ThreadPool.hpp"
+
+#include <utility>
+
+namespace {
+    thread_local bool insideTask = false;
+
+    struct TaskScope {
+        TaskScope() : previous(insideTask) { insideTask = true; }
+        ~TaskScope() { insideTask = previous; }
+        bool previous;
+    };
+} // namespace
+
+ThreadPool::ThreadPool(unsigned concurrency)
+    : task_(nullptr), count_(0), next_(0), pending_(0),
+      generation_(0), stop_(false) {
+    if (concurrency == 0)
+        concurrency = 1;
+    workers_.reserve(concurrency - 1);
+    for (unsigned i = 1; i < concurrency; ++i)
+        workers_.emplace_back(&ThreadPool::workerLoop, this);
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wakeCv_.notify_all();
+    for (auto& worker : workers_)
+        worker.join();
+}
+
+unsigned ThreadPool::size() const {
+    return static_cast<unsigned>(workers_.size()) + 1;
+}
+
+void ThreadPool::parallelFor(size_t count, const Task& task) {
+    if (count == 0)
+        return;
+    if (insideTask || workers_.empty() || count == 1) {
+        TaskScope scope;
+        for (size_t i = 0; i < count; ++i)
+            task(i);
+        return;
+    }
+
+    std::lock_guard<std::mutex> job(jobMutex_);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        task_ = &task;
+        count_ = count;
+        next_ = 0;
+        pending_ = count;
+        error_ = nullptr;
+        ++generation_;
+    }
+    wakeCv_.notify_all();
+
+    runTasks();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    doneCv_.wait(lock, [this] { return pending_ == 0; });
+    task_ = nullptr;
+    if (error_)
+        std::rethrow_exception(std::exchange(error_, nullptr));
+}
+
+void ThreadPool::workerLoop() {
+    unsigned long seen = 0;
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wakeCv_.wait(lock, [this, seen] { return stop_ || generation_ != seen; });
+            if (stop_)
+                return;
+            seen = generation_;
+        }
+        runTasks();
+    }
+}
+
+void ThreadPool::runTasks() {
+    TaskScope scope;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (task_ != nullptr && next_ < count_) {
+        const Task* task = task_;
+        size_t index = next_++;
+        lock.unlock();
+        try {
+            (*task)(index);
+        } catch (...) {
+            lock.lock();
+            if (!error_)
+                error_ = std::current_exception();
+            lock.unlock();
+        }
+        lock.lock();
+        if (--pending_ == 0)
+            doneCv_.notify_all();
+    }
+}
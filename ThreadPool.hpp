@@ -0,0 +1,42 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads executing index ranges.
+// The calling thread takes part in the work, so a pool of size N spawns N - 1 threads.
+class ThreadPool final {
+public:
+    using Task = std::function<void(size_t index)>;
+
+    explicit ThreadPool(unsigned concurrency = std::thread::hardware_concurrency());
+    ~ThreadPool();
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const;
+    // Runs task(index) for every index in [0, count) and waits for completion.
+    // Nested calls from inside a task are executed inline by the calling worker.
+    void parallelFor(size_t count, const Task& task);
+private:
+    void workerLoop();
+    void runTasks();
+private:
+    std::vector<std::thread> workers_;
+    std::mutex jobMutex_;
+    std::mutex mutex_;
+    std::condition_variable wakeCv_;
+    std::condition_variable doneCv_;
+    const Task* task_;
+    size_t count_;
+    size_t next_;
+    size_t pending_;
+    unsigned long generation_;
+    std::exception_ptr error_;
+    bool stop_;
+};
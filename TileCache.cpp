@@ -0,0 +1,130 @@
+#include "TileCache.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+bool TileCache::Key::operator==(const Key& other) const {
+    return lattice == other.lattice && tile == other.tile;
+}
+
+bool TileCache::Rect::contains(const Rect& other) const {
+    return (origin.array() <= other.origin.array()).all() &&
+           (origin + size).cwiseMax(other.origin + other.size) == origin + size;
+}
+
+TileCache::Rect TileCache::bounds(const Rect& a, const Rect& b) {
+    const Eigen::Vector2i origin = a.origin.cwiseMin(b.origin);
+    return {origin, (a.origin + a.size).cwiseMax(b.origin + b.size) - origin};
+}
+
+size_t TileCache::KeyHash::operator()(const Key& key) const {
+    size_t hash = std::hash<uint64_t>()(key.lattice);
+    hash = hash * 31 + std::hash<int>()(key.tile[0]);
+    hash = hash * 31 + std::hash<int>()(key.tile[1]);
+    return hash;
+}
+
+TileCache::TileCache(int tileSize, size_t capacityBytes)
+    : tileSize_(tileSize), capacity_(capacityBytes) {
+    if (tileSize <= 0)
+        throw std::invalid_argument("Tile size must be positive");
+}
+
+int TileCache::tileSize() const {
+    return tileSize_;
+}
+
+size_t TileCache::capacity() const {
+    return capacity_;
+}
+
+void TileCache::setCapacity(size_t bytes) {
+    capacity_ = bytes;
+    evict();
+}
+
+bool TileCache::find(const Key& key, const Rect& needed, float* dst, size_t valuesPerRow) {
+    const auto found = index_.find(key);
+    if (found == index_.end() || !found->second->rect.contains(needed)) {
+        ++stats_.misses;
+        return false;
+    }
+    ++stats_.hits;
+    entries_.splice(entries_.begin(), entries_, found->second);
+    scratch_.resize(static_cast<size_t>(tileSize_) * needed.size[1]);
+    found->second->values.decodeRows(needed.origin[1], needed.size[1], scratch_.data(), tileSize_);
+    for (int y = 0; y < needed.size[1]; ++y)
+        std::copy_n(scratch_.data() + static_cast<size_t>(y) * tileSize_ + needed.origin[0], needed.size[0],
+                    dst + y * valuesPerRow);
+    return true;
+}
+
+void TileCache::insert(const Key& key, const Rect& rect, const float* values, unsigned long maxIterations) {
+    const Eigen::Vector2i size(tileSize_, tileSize_);
+    const auto found = index_.find(key);
+    if (found != index_.end()) {
+        entries_.splice(entries_.begin(), entries_, found->second);
+        Entry& entry = *found->second;
+        if (entry.rect.contains(rect))
+            return;
+        // Parts of a border tile seen from different views are merged while they add up to a rectangle
+        const Rect merged = bounds(entry.rect, rect);
+        const Eigen::Vector2i overlap = ((entry.rect.origin + entry.rect.size).cwiseMin(rect.origin + rect.size) -
+                                         entry.rect.origin.cwiseMax(rect.origin)).cwiseMax(0);
+        const int area = rect.size.prod() + entry.rect.size.prod() - overlap.prod();
+        CompressedIterations updated;
+        if (rect.contains(entry.rect) || merged.size.prod() != area) {
+            if (rect.size.prod() < entry.rect.size.prod())
+                return;
+            entry.rect = rect;
+            updated = CompressedIterations(values, size, tileSize_, maxIterations);
+        } else {
+            scratch_.resize(static_cast<size_t>(tileSize_) * tileSize_);
+            entry.values.decodeRows(0, tileSize_, scratch_.data(), tileSize_);
+            for (int y = rect.origin[1]; y < rect.origin[1] + rect.size[1]; ++y) {
+                const size_t row = static_cast<size_t>(y) * tileSize_ + rect.origin[0];
+                std::copy_n(values + row, rect.size[0], scratch_.begin() + row);
+            }
+            entry.rect = merged;
+            updated = CompressedIterations(scratch_.data(), size, tileSize_, maxIterations);
+        }
+        stats_.bytes = stats_.bytes - entry.values.bytes() + updated.bytes();
+        entry.values = std::move(updated);
+        evict();
+        return;
+    }
+
+    entries_.push_front({key, rect, CompressedIterations(values, size, tileSize_, maxIterations)});
+    index_.emplace(key, entries_.begin());
+    ++stats_.tiles;
+    stats_.bytes += entries_.front().values.bytes();
+    evict();
+}
+
+void TileCache::clear() {
+    entries_.clear();
+    index_.clear();
+    stats_.tiles = 0;
+    stats_.bytes = 0;
+}
+
+const TileCacheStats& TileCache::stats() const {
+    return stats_;
+}
+
+void TileCache::resetStats() {
+    stats_.hits = 0;
+    stats_.misses = 0;
+    stats_.evictions = 0;
+}
+
+void TileCache::evict() {
+    while (stats_.bytes > capacity_ && !entries_.empty()) {
+        index_.erase(entries_.back().key);
+        stats_.bytes -= entries_.back().values.bytes();
+        entries_.pop_back();
+        --stats_.tiles;
+        ++stats_.evictions;
+    }
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "CompressedIterations.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <Eigen/Dense>
+
+struct TileCacheStats {
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t evictions = 0;
+    size_t tiles = 0;
+    size_t bytes = 0;
+};
+
+// Least recently used tiles of iteration counts within a byte budget.
+// A tile is a tileSize x tileSize square of a pixel lattice, tiles on the border of a view
+// are computed only partly, `rect` tells which part is valid. Tiles are held compressed, so the budget
+// takes several times more of them than of float tiles.
+class TileCache final {
+public:
+    struct Key {
+        uint64_t lattice; // identifies the pixel grid together with the iteration limit and mode
+        Eigen::Vector2i tile;
+
+        bool operator==(const Key& other) const;
+    };
+
+    struct Rect {
+        Eigen::Vector2i origin{0, 0};
+        Eigen::Vector2i size{0, 0};
+
+        bool contains(const Rect& other) const;
+    };
+
+    TileCache(int tileSize, size_t capacityBytes);
+
+    int tileSize() const;
+    size_t capacity() const;
+    void setCapacity(size_t bytes);
+
+    // Decodes the `needed` part of the tile to `dst`, false when the cached part doesn't cover it
+    bool find(const Key& key, const Rect& needed, float* dst, size_t valuesPerRow);
+    // `values` hold tileSize^2 counts of which `rect` is valid. An entry covering it already is kept.
+    void insert(const Key& key, const Rect& rect, const float* values, unsigned long maxIterations);
+    void clear();
+    const TileCacheStats& stats() const;
+    void resetStats();
+private:
+    struct KeyHash {
+        size_t operator()(const Key& key) const;
+    };
+    struct Entry {
+        Key key;
+        Rect rect;
+        CompressedIterations values;
+    };
+
+    static Rect bounds(const Rect& a, const Rect& b);
+    void evict();
+
+    int tileSize_;
+    size_t capacity_;
+    std::list<Entry> entries_; // most recently used first
+    std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+    TileCacheStats stats_;
+    std::vector<float> scratch_; // decoded rows of a tile
+};
@@ -0,0 +1,271 @@
+#include "TileContainer.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+
+#include <fmt/format.h>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+    constexpr char magic[8] = {'M', 'B', 'T', 'I', 'L', 'E', 'S', '1'};
+    // Tile slots start at a page boundary
+    constexpr uint64_t dataAlignment = 4096;
+
+    // Host byte order, containers aren't meant to move between machines before they're exported
+    struct Header {
+        char magic[8];
+        uint32_t width;
+        uint32_t height;
+        uint32_t tileSize;
+        uint32_t descriptionSize;
+    };
+
+    std::runtime_error systemError(const std::string& what, const std::string& path) {
+        const std::string reason = std::strerror(errno);
+        return std::runtime_error(what + " " + path + ": " + reason);
+    }
+} // namespace
+
+TileContainer::TileContainer(const std::string& path, const Eigen::Vector2i& size, int tileSize,
+                             const std::string& description)
+    : path_(path), fd_(-1), size_(size), tileSize_(tileSize) {
+    if ((size.array() <= 0).any() || tileSize <= 0)
+        throw std::invalid_argument("Tile container needs positive image and tile sizes");
+    tileCount_ = (size.array() + tileSize - 1) / tileSize;
+    done_.assign(static_cast<size_t>(tileCount_[0]) * tileCount_[1], 0);
+    tableOffset_ = sizeof(Header) + description.size();
+    dataOffset_ = (tableOffset_ + done_.size() + dataAlignment - 1) / dataAlignment * dataAlignment;
+
+    const std::vector<uint8_t> head = preamble(description);
+    fd_ = ::open(path.c_str(), O_RDWR);
+    if (fd_ < 0 && errno != ENOENT)
+        throw systemError("Unable to open", path);
+    if (fd_ >= 0 && !torn(head)) {
+        open(description);
+        return;
+    }
+    // Missing, or left torn by a crash of a version that built containers in place
+    const bool replace = fd_ >= 0;
+    if (replace) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+    if (create(head, replace))
+        return;
+    // Another job created it meanwhile
+    fd_ = ::open(path.c_str(), O_RDWR);
+    if (fd_ < 0)
+        throw systemError("Unable to open", path);
+    open(description);
+}
+
+TileContainer::~TileContainer() {
+    if (fd_ >= 0)
+        ::close(fd_);
+}
+
+std::vector<uint8_t> TileContainer::preamble(const std::string& description) const {
+    Header header{};
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.width = static_cast<uint32_t>(size_[0]);
+    header.height = static_cast<uint32_t>(size_[1]);
+    header.tileSize = static_cast<uint32_t>(tileSize_);
+    header.descriptionSize = static_cast<uint32_t>(description.size());
+    std::vector<uint8_t> head(tableOffset_ + done_.size(), 0);
+    std::memcpy(head.data(), &header, sizeof(header));
+    std::memcpy(head.data() + sizeof(header), description.data(), description.size());
+    return head;
+}
+
+bool TileContainer::torn(const std::vector<uint8_t>& head) const {
+    struct stat status;
+    if (::fstat(fd_, &status) != 0)
+        throw systemError("Unable to open", path_);
+    // A whole container is never shorter than its slots, a torn one is a part of the preamble
+    const uint64_t bytes = static_cast<uint64_t>(status.st_size);
+    if (bytes >= totalBytes() || bytes > head.size())
+        return false;
+    std::vector<uint8_t> stored(bytes);
+    readAt(stored.data(), stored.size(), 0);
+    if (std::equal(stored.begin(), stored.end(), head.begin()))
+        return true;
+    if (bytes < sizeof(Header))
+        throw std::runtime_error(path_ + " isn't a tile container");
+    return false;
+}
+
+bool TileContainer::create(const std::vector<uint8_t>& head, bool replace) {
+    // Built aside and put in place whole, a crash never leaves a torn container at path_
+    const std::string temporary = path_ + fmt::format(".{}.tmp", ::getpid());
+    fd_ = ::open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd_ < 0)
+        throw systemError("Unable to create", temporary);
+    try {
+        writeAt(head.data(), head.size(), 0);
+        // Sparse where the file system allows it, slots are filled as tiles complete
+        if (::ftruncate(fd_, static_cast<off_t>(totalBytes())) != 0)
+            throw systemError("Unable to allocate", temporary);
+        if (::fsync(fd_) != 0)
+            throw systemError("Unable to sync", temporary);
+        // link() keeps a container another job created meanwhile, rename() replaces a torn one
+        if (replace ? std::rename(temporary.c_str(), path_.c_str()) != 0 : ::link(temporary.c_str(), path_.c_str()) != 0) {
+            if (replace || errno != EEXIST)
+                throw systemError("Unable to create", path_);
+            ::close(fd_);
+            fd_ = -1;
+        }
+    } catch (...) {
+        ::close(fd_);
+        fd_ = -1;
+        ::unlink(temporary.c_str());
+        throw;
+    }
+    if (!replace)
+        ::unlink(temporary.c_str());
+    return fd_ >= 0;
+}
+
+void TileContainer::open(const std::string& description) {
+    Header header;
+    readAt(&header, sizeof(header), 0);
+    if (std::memcmp(header.magic, magic, sizeof(magic)) != 0)
+        throw std::runtime_error(path_ + " isn't a tile container");
+    std::string stored(header.descriptionSize, '\0');
+    readAt(stored.data(), stored.size(), sizeof(header));
+    if (header.width != static_cast<uint32_t>(size_[0]) || header.height != static_cast<uint32_t>(size_[1]) ||
+        header.tileSize != static_cast<uint32_t>(tileSize_) || stored != description)
+        throw std::runtime_error(path_ + " holds another image: " + stored + ", remove it to start over");
+    readAt(done_.data(), done_.size(), tableOffset_);
+}
+
+Eigen::Vector2i TileContainer::size() const {
+    return size_;
+}
+
+int TileContainer::tileSize() const {
+    return tileSize_;
+}
+
+Eigen::Vector2i TileContainer::tileCount() const {
+    return tileCount_;
+}
+
+size_t TileContainer::completedTiles() const {
+    return static_cast<size_t>(std::count(done_.begin(), done_.end(), 1));
+}
+
+bool TileContainer::completed() const {
+    return completedTiles() == done_.size();
+}
+
+bool TileContainer::hasTile(const Eigen::Vector2i& tile) const {
+    return done_[tileIndex(tile)] == 1;
+}
+
+Eigen::Vector2i TileContainer::tileExtent(const Eigen::Vector2i& tile) const {
+    return (size_ - tile * tileSize_).cwiseMin(tileSize_);
+}
+
+void TileContainer::writeTile(const Eigen::Vector2i& tile, const uint8_t* rgba, size_t bytesPerRow) {
+    const Eigen::Vector2i extent = tileExtent(tile);
+    const size_t slotRow = static_cast<size_t>(tileSize_) * 4;
+    scratch_.assign(slotRow * tileSize_, 0);
+    for (int y = 0; y < extent[1]; ++y)
+        std::memcpy(scratch_.data() + y * slotRow, rgba + y * bytesPerRow, static_cast<size_t>(extent[0]) * 4);
+    const size_t index = tileIndex(tile);
+    writeAt(scratch_.data(), scratch_.size(), tileOffset(index));
+    written_.push_back(index);
+}
+
+void TileContainer::commit() {
+    if (written_.empty())
+        return;
+    // Pixels first: a completion byte may reach the disk only after its tile did
+    if (::fsync(fd_) != 0)
+        throw systemError("Unable to sync", path_);
+    const uint8_t completed = 1;
+    for (size_t index : written_) {
+        writeAt(&completed, 1, tableOffset_ + index);
+        done_[index] = 1;
+    }
+    written_.clear();
+}
+
+void TileContainer::readRows(int y, int rows, uint8_t* dst, size_t bytesPerRow) {
+    if (y < 0 || rows < 0 || y + rows > size_[1])
+        throw std::out_of_range("Rows are out of the image");
+    const size_t slotRow = static_cast<size_t>(tileSize_) * 4;
+    while (rows > 0) {
+        // Rows of one tile row are contiguous in every slot of it, one read per tile
+        const int tileY = y / tileSize_;
+        const int firstRow = y % tileSize_;
+        const int count = std::min(rows, tileSize_ - firstRow);
+        scratch_.resize(slotRow * count);
+        for (int tileX = 0; tileX < tileCount_[0]; ++tileX) {
+            const size_t index = tileIndex({tileX, tileY});
+            if (done_[index] != 1)
+                throw std::runtime_error("Tile " + std::to_string(tileX) + "," + std::to_string(tileY) +
+                                         " of " + path_ + " isn't rendered");
+            readAt(scratch_.data(), scratch_.size(), tileOffset(index) + firstRow * slotRow);
+            const size_t width = static_cast<size_t>(tileExtent({tileX, tileY})[0]) * 4;
+            for (int row = 0; row < count; ++row)
+                std::memcpy(dst + row * bytesPerRow + static_cast<size_t>(tileX) * slotRow,
+                            scratch_.data() + row * slotRow, width);
+        }
+        dst += count * bytesPerRow;
+        y += count;
+        rows -= count;
+    }
+}
+
+size_t TileContainer::tileIndex(const Eigen::Vector2i& tile) const {
+    if ((tile.array() < 0).any() || (tile.array() >= tileCount_.array()).any())
+        throw std::out_of_range("Tile is out of the image");
+    return static_cast<size_t>(tile[1]) * tileCount_[0] + tile[0];
+}
+
+uint64_t TileContainer::tileOffset(size_t index) const {
+    return dataOffset_ + static_cast<uint64_t>(tileSize_) * tileSize_ * 4 * index;
+}
+
+uint64_t TileContainer::totalBytes() const {
+    return tileOffset(done_.size());
+}
+
+void TileContainer::readAt(void* dst, size_t bytes, uint64_t offset) const {
+    uint8_t* out = static_cast<uint8_t*>(dst);
+    while (bytes > 0) {
+        const ssize_t done = ::pread(fd_, out, bytes, static_cast<off_t>(offset));
+        if (done < 0 && errno == EINTR)
+            continue;
+        if (done < 0)
+            throw systemError("Unable to read", path_);
+        if (done == 0)
+            throw std::runtime_error(path_ + " is a truncated tile container, remove it to start over");
+        out += done;
+        offset += static_cast<uint64_t>(done);
+        bytes -= static_cast<size_t>(done);
+    }
+}
+
+void TileContainer::writeAt(const void* src, size_t bytes, uint64_t offset) const {
+    const uint8_t* in = static_cast<const uint8_t*>(src);
+    while (bytes > 0) {
+        const ssize_t done = ::pwrite(fd_, in, bytes, static_cast<off_t>(offset));
+        if (done < 0 && errno == EINTR)
+            continue;
+        if (done < 0)
+            throw systemError("Unable to write", path_);
+        if (done == 0)
+            throw std::runtime_error("Unable to write " + path_ + ": nothing was written");
+        in += done;
+        offset += static_cast<uint64_t>(done);
+        bytes -= static_cast<size_t>(done);
+    }
+}
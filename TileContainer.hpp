@@ -0,0 +1,64 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+
+// File of fixed-size RGBA8 tiles of one image, written in any order with bounded memory.
+// Layout: header, description of the image, one completion byte per tile, then tile slots
+// of tileSize^2 * 4 bytes in row-major tile order (edge tiles are padded).
+// A tile is marked completed only after its pixels were synced to disk, so a job
+// interrupted at any moment resumes by opening the same file and rendering what's missing.
+class TileContainer final {
+public:
+    // Opens `path` if it holds the same image, creates it otherwise.
+    // A file of another image (size, tile size or description differ) is an error, it's never overwritten.
+    TileContainer(const std::string& path, const Eigen::Vector2i& size, int tileSize,
+                  const std::string& description);
+    ~TileContainer();
+
+    TileContainer(const TileContainer&) = delete;
+    TileContainer& operator=(const TileContainer&) = delete;
+
+    Eigen::Vector2i size() const;
+    int tileSize() const;
+    Eigen::Vector2i tileCount() const;
+    size_t completedTiles() const;
+    bool completed() const;
+    bool hasTile(const Eigen::Vector2i& tile) const;
+    // Pixel size of the tile, the last column and row of tiles are cropped to the image
+    Eigen::Vector2i tileExtent(const Eigen::Vector2i& tile) const;
+
+    // Pixels of tileExtent(tile), they count as completed after the next commit()
+    void writeTile(const Eigen::Vector2i& tile, const uint8_t* rgba, size_t bytesPerRow);
+    // Syncs the written tiles and marks them completed
+    void commit();
+    // Full width image rows [y, y + rows), all tiles they cross must be completed
+    void readRows(int y, int rows, uint8_t* dst, size_t bytesPerRow);
+private:
+    // Header, description and an empty completion table
+    std::vector<uint8_t> preamble(const std::string& description) const;
+    // A file cut short while it was created, nothing but a part of `head`
+    bool torn(const std::vector<uint8_t>& head) const;
+    // False when another job created the container first, a torn one is replaced
+    bool create(const std::vector<uint8_t>& head, bool replace);
+    void open(const std::string& description);
+    size_t tileIndex(const Eigen::Vector2i& tile) const;
+    uint64_t tileOffset(size_t index) const;
+    uint64_t totalBytes() const;
+    void readAt(void* dst, size_t bytes, uint64_t offset) const;
+    void writeAt(const void* src, size_t bytes, uint64_t offset) const;
+private:
+    std::string path_;
+    int fd_;
+    Eigen::Vector2i size_;
+    int tileSize_;
+    Eigen::Vector2i tileCount_;
+    uint64_t tableOffset_;      // completion bytes
+    uint64_t dataOffset_;       // first tile slot
+    std::vector<uint8_t> done_; // mirror of the completion bytes
+    std::vector<size_t> written_; // tiles written since the last commit
+    std::vector<uint8_t> scratch_;
+};
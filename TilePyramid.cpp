@@ -0,0 +1,172 @@
+#include "TilePyramid.hpp"
+
+#include "ImageWriter.hpp"
+#include "Log.hpp"
+#include "ThreadPool.hpp"
+
+#include <fmt/core.h>
+
+#include <atomic>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace {
+    // Deeper levels can't be addressed by the double tile offsets
+    constexpr int maxLevel = 48;
+    constexpr int defaultTileSize = 256;
+
+#ifdef MANDELBROT_WITH_PNG
+    const char* imageExtension = ".png";
+#else
+    const char* imageExtension = ".ppm";
+#endif
+
+    std::string readFile(const std::filesystem::path& path) {
+        std::ifstream file(path);
+        std::stringstream text;
+        text << file.rdbuf();
+        return text.str();
+    }
+} // namespace
+
+TilePyramid::TilePyramid(const RenderJob& job, BackendType backend, unsigned threadCount)
+    : job_(job), backend_(backend), threadCount_(threadCount),
+      tileSize_(job.tileSize > 0 ? job.tileSize : defaultTileSize),
+      directory_(job.pyramid), extension_(imageExtension),
+      palette_(Palettes::resolve(job.palette)),
+      cache_(job.cache.empty() ? directory_ / "cache" : std::filesystem::path(job.cache)) {
+    if (job.pyramid.empty())
+        throw std::invalid_argument("Pyramid directory isn't specified");
+    if (job.minLevel < 0 || job.maxLevel < job.minLevel || job.maxLevel > maxLevel)
+        throw std::invalid_argument(fmt::format("Pyramid levels must be within 0-{}", maxLevel));
+    // Palette files are named by their file name without the extension
+    imageDirectory_ = directory_ / std::filesystem::path(palette_.name()).stem();
+}
+
+PrecisePoint TilePyramid::tileCenter(const PyramidTile& tile) const {
+    const double tiles = std::ldexp(1.0, tile.z);
+    const double dx = job_.scale * ((tile.x + 0.5) / tiles - 0.5);
+    const double dy = job_.scale * ((tile.y + 0.5) / tiles - 0.5);
+    return {job_.center.x + DoubleDouble(dx), job_.center.y + DoubleDouble(dy)};
+}
+
+double TilePyramid::tileScale(int level) const {
+    return std::ldexp(job_.scale, -level);
+}
+
+std::filesystem::path TilePyramid::tilePath(const PyramidTile& tile) const {
+    return imageDirectory_ / std::to_string(tile.z) / std::to_string(tile.x) / (std::to_string(tile.y) + extension_);
+}
+
+// Empty for z^2 + c at the automatic precision, so pyramids made before formulas existed stay valid
+std::string TilePyramid::optionSuffix() const {
+    std::string suffix = job_.formula == Formula{} ? "" : " formula " + Formulas::describe(job_.formula);
+    if (job_.precision != Precision::Auto)
+        suffix += fmt::format(" precision {}", Precisions::name(job_.precision));
+    return suffix;
+}
+
+// Everything the counts of a tile depend on, the palette isn't a part of it
+std::string TilePyramid::tileDescription(const PyramidTile& tile, const char* backend, Precision precision) const {
+    const PrecisePoint center = tileCenter(tile);
+    return fmt::format("tile {} center {:a}{:+a},{:a}{:+a} scale {:a} iterations {} precision {} backend {} version {}{}",
+                       tileSize_, center.x.hi, center.x.lo, center.y.hi, center.y.lo, tileScale(tile.z),
+                       job_.maxIterations, Precisions::name(precision), backend, iterationsVersion, optionSuffix());
+}
+
+// Images of a directory are trusted only if they were made for the same root view
+void TilePyramid::checkManifest() const {
+    const std::string manifest = fmt::format("center {:a}{:+a},{:a}{:+a} scale {:a} tile {} iterations {} deep {}{}\n",
+                                             job_.center.x.hi, job_.center.x.lo, job_.center.y.hi, job_.center.y.lo,
+                                             job_.scale, tileSize_, job_.maxIterations, job_.deepZoom, optionSuffix());
+    const std::filesystem::path path = directory_ / "pyramid.txt";
+    if (std::filesystem::exists(path)) {
+        const std::string stored = readFile(path);
+        if (stored != manifest)
+            throw std::runtime_error(directory_.string() + " holds another pyramid: " +
+                                     stored.substr(0, stored.find('\n')));
+        return;
+    }
+    std::filesystem::create_directories(directory_);
+    std::ofstream file(path);
+    if (!(file << manifest))
+        throw std::runtime_error("Unable to write " + path.string());
+}
+
+PyramidStats TilePyramid::render() {
+    checkManifest();
+
+    // Tiles of all levels are numbered level by level, row by row
+    std::vector<size_t> levelStart;
+    size_t total = 0;
+    for (int z = job_.minLevel; z <= job_.maxLevel; ++z) {
+        levelStart.push_back(total);
+        total += size_t(1) << (2 * z);
+    }
+    auto locate = [&](size_t index) {
+        int level = static_cast<int>(levelStart.size()) - 1;
+        while (levelStart[level] > index)
+            --level;
+        const int z = job_.minLevel + level;
+        const size_t offset = index - levelStart[level];
+        return PyramidTile{z, static_cast<int>(offset & ((size_t(1) << z) - 1)), static_cast<int>(offset >> z)};
+    };
+
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> present{0};
+    std::atomic<size_t> recolored{0};
+    std::atomic<size_t> rendered{0};
+    ThreadPool pool(threadCount_);
+    pool.parallelFor(pool.size(), [&](size_t) {
+        MandelbrotSetGenerator generator(backend_, 1);
+        generator.setSize({tileSize_, tileSize_});
+        generator.setMaxIterations(job_.maxIterations);
+        generator.setBulbCheck(job_.bulbCheck);
+        generator.setPeriodicityCheck(job_.periodicityCheck);
+        generator.setFormula(job_.formula);
+        generator.setDeepZoom(job_.deepZoom);
+        generator.setPrecision(job_.precision);
+        const size_t pixels = static_cast<size_t>(tileSize_) * tileSize_;
+        std::vector<float> values(pixels);
+        std::vector<uint8_t> rgba(pixels * 4);
+
+        for (size_t index = next++; index < total; index = next++) {
+            const PyramidTile tile = locate(index);
+            const std::filesystem::path path = tilePath(tile);
+            if (std::filesystem::exists(path)) {
+                ++present;
+                continue;
+            }
+
+            // Deeper levels move to finer precisions, the counts depend on the one picked
+            generator.setPreciseCenter(tileCenter(tile));
+            generator.setPreciseScale(tileScale(tile.z));
+            const std::string description = tileDescription(tile, generator.backendName(), generator.renderPrecision());
+            if (cache_.load(description, values)) {
+                ++recolored;
+            } else {
+                generator.computeIterations();
+                values = generator.iterations();
+                cache_.store(description, values, job_.maxIterations);
+                ++rendered;
+            }
+
+            // Written aside and renamed, a present image is always a complete one
+            palette_.colorize(values.data(), values.size(), job_.maxIterations, rgba.data());
+            std::filesystem::create_directories(path.parent_path());
+            const std::filesystem::path temporary = path.parent_path() / fmt::format(".{}", path.filename().string());
+            auto writer = ImageWriter::create(temporary.string(), {tileSize_, tileSize_});
+            writer->writeRows(rgba.data(), static_cast<size_t>(tileSize_) * 4, tileSize_);
+            writer->finish();
+            writer.reset();
+            std::filesystem::rename(temporary, path);
+
+            if ((index + 1) % 1024 == 0)
+                Log::info("{}: {} of {} tiles", directory_.string(), index + 1, total);
+        }
+    });
+    return {present, recolored, rendered};
+}
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "IterationCache.hpp"
+#include "MandelbrotSetGenerator.hpp"
+#include "RenderJob.hpp"
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+
+struct PyramidTile {
+    int z;
+    int x;
+    int y;
+};
+
+struct PyramidStats {
+    size_t present = 0;   // image was already there
+    size_t recolored = 0; // counts came from the cache
+    size_t rendered = 0;
+};
+
+// Slippy map style z/x/y quadtree of square tiles under a root view: level z splits the
+// root square (job center, job scale wide) into 2^z x 2^z tiles of tileSize pixels.
+// Images go to DIRECTORY/PALETTE/z/x/y.EXT, their iteration counts to a content-addressed
+// IterationCache, so a new palette only recolors and an interrupted run skips finished images.
+class TilePyramid final {
+public:
+    // Uses job.pyramid, job.cache (DIRECTORY/cache by default), job.tileSize (256 by default)
+    // and job.minLevel..job.maxLevel, size and output of the job are ignored
+    TilePyramid(const RenderJob& job, BackendType backend, unsigned threadCount);
+
+    PrecisePoint tileCenter(const PyramidTile& tile) const;
+    double tileScale(int level) const;
+    std::filesystem::path tilePath(const PyramidTile& tile) const;
+
+    // Tiles are spread over threadCount workers, each with a single threaded generator
+    PyramidStats render();
+private:
+    void checkManifest() const;
+    std::string optionSuffix() const;
+    std::string tileDescription(const PyramidTile& tile, const char* backend, Precision precision) const;
+private:
+    RenderJob job_;
+    BackendType backend_;
+    unsigned threadCount_;
+    int tileSize_;
+    std::filesystem::path directory_;
+    std::filesystem::path imageDirectory_;
+    std::string extension_;
+    Palette palette_;
+    IterationCache cache_;
+};
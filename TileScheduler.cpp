@@ -0,0 +1,123 @@
+#include "TileScheduler.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <numeric>
+#include <stdexcept>
+
+namespace {
+    using Clock = std::chrono::steady_clock;
+
+    double millisecondsBetween(Clock::time_point from, Clock::time_point to) {
+        return std::chrono::duration<double, std::milli>(to - from).count();
+    }
+} // namespace
+
+double SchedulerStats::imbalance() const {
+    if (workerBusyMs.empty())
+        return 1.0;
+    const double total = std::accumulate(workerBusyMs.begin(), workerBusyMs.end(), 0.0);
+    const double busiest = *std::max_element(workerBusyMs.begin(), workerBusyMs.end());
+    return total > 0.0 ? busiest * workerBusyMs.size() / total : 1.0;
+}
+
+TileScheduler::TileScheduler(ThreadPool& pool, int tileSize)
+    : pool_(pool), tileSize_(0) {
+    setTileSize(tileSize);
+    queues_.reserve(pool_.size());
+    for (unsigned i = 0; i < pool_.size(); ++i)
+        queues_.push_back(std::make_unique<WorkerQueue>());
+}
+
+int TileScheduler::tileSize() const {
+    return tileSize_;
+}
+
+void TileScheduler::setTileSize(int tileSize) {
+    if (tileSize <= 0)
+        throw std::invalid_argument("Tile size must be positive");
+    tileSize_ = tileSize;
+}
+
+const SchedulerStats& TileScheduler::lastStats() const {
+    return stats_;
+}
+
+void TileScheduler::run(const Eigen::Vector2i& size, const TileFunc& func) {
+    const int tilesX = (size[0] + tileSize_ - 1) / tileSize_;
+    const int tilesY = (size[1] + tileSize_ - 1) / tileSize_;
+    const size_t tileCount = static_cast<size_t>(tilesX) * tilesY;
+    const unsigned workers = static_cast<unsigned>(queues_.size());
+
+    stats_.tiles.assign(tileCount, TileTiming{});
+    stats_.workerBusyMs.assign(workers, 0.0);
+    stats_.steals = 0;
+
+    // Contiguous blocks of tiles per worker, the same split a static scheduler would do
+    for (unsigned w = 0; w < workers; ++w) {
+        const size_t begin = tileCount * w / workers;
+        const size_t end = tileCount * (w + 1) / workers;
+        std::lock_guard<std::mutex> lock(queues_[w]->mutex);
+        queues_[w]->tiles.clear();
+        for (size_t tile = begin; tile < end; ++tile)
+            queues_[w]->tiles.push_back(tile);
+    }
+
+    std::atomic<size_t> steals{0};
+    const Clock::time_point runStart = Clock::now();
+    pool_.parallelFor(workers, [&](size_t index) {
+        const unsigned worker = static_cast<unsigned>(index);
+        double busyMs = 0.0;
+        size_t tile;
+        while (true) {
+            bool stolen = false;
+            if (!popOwn(worker, tile)) {
+                if (!steal(worker, tile))
+                    break;
+                stolen = true;
+                steals.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            const Eigen::Vector2i origin(static_cast<int>(tile % tilesX) * tileSize_,
+                                         static_cast<int>(tile / tilesX) * tileSize_);
+            const Eigen::Vector2i tileExtent(std::min(tileSize_, size[0] - origin[0]),
+                                             std::min(tileSize_, size[1] - origin[1]));
+            const Clock::time_point start = Clock::now();
+            func(origin, tileExtent);
+            const Clock::time_point end = Clock::now();
+
+            const double durationMs = millisecondsBetween(start, end);
+            busyMs += durationMs;
+            stats_.tiles[tile] = {origin, tileExtent, worker, stolen,
+                                  millisecondsBetween(runStart, start), durationMs};
+        }
+        stats_.workerBusyMs[worker] = busyMs;
+    });
+    stats_.wallMs = millisecondsBetween(runStart, Clock::now());
+    stats_.steals = steals.load();
+}
+
+bool TileScheduler::popOwn(unsigned worker, size_t& tile) {
+    WorkerQueue& queue = *queues_[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.tiles.empty())
+        return false;
+    tile = queue.tiles.front();
+    queue.tiles.pop_front();
+    return true;
+}
+
+bool TileScheduler::steal(unsigned worker, size_t& tile) {
+    const unsigned workers = static_cast<unsigned>(queues_.size());
+    for (unsigned offset = 1; offset < workers; ++offset) {
+        WorkerQueue& victim = *queues_[(worker + offset) % workers];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.tiles.empty())
+            continue;
+        tile = victim.tiles.back();
+        victim.tiles.pop_back();
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,58 @@
+#pragma once
+
+#include "ThreadPool.hpp"
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <Eigen/Dense>
+
+struct TileTiming {
+    Eigen::Vector2i origin;
+    Eigen::Vector2i size;
+    unsigned worker;
+    bool stolen;
+    double startMs; // since the beginning of the run
+    double durationMs;
+};
+
+struct SchedulerStats {
+    std::vector<TileTiming> tiles;
+    std::vector<double> workerBusyMs;
+    size_t steals = 0;
+    double wallMs = 0.0;
+
+    // Busiest worker time divided by the average one, 1.0 means perfect balance
+    double imbalance() const;
+};
+
+// Splits an image into tiles and runs them on the pool.
+// Every worker starts with a contiguous block of tiles in its own deque and
+// steals from the back of other deques once its own is empty, so workers which
+// got the cheap exterior tiles help the ones stuck inside the set.
+class TileScheduler final {
+public:
+    using TileFunc = std::function<void(const Eigen::Vector2i& origin, const Eigen::Vector2i& size)>;
+
+    explicit TileScheduler(ThreadPool& pool, int tileSize = 64);
+
+    int tileSize() const;
+    void setTileSize(int tileSize);
+    void run(const Eigen::Vector2i& size, const TileFunc& func);
+    const SchedulerStats& lastStats() const;
+private:
+    struct alignas(64) WorkerQueue {
+        std::mutex mutex;
+        std::deque<size_t> tiles;
+    };
+
+    bool popOwn(unsigned worker, size_t& tile);
+    bool steal(unsigned worker, size_t& tile);
+private:
+    ThreadPool& pool_;
+    int tileSize_;
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    SchedulerStats stats_;
+};
@@ -0,0 +1,45 @@
+#include "Y4mWriter.hpp"
+
+#include <cmath>
+#include <stdexcept>
+
+Y4mWriter::Y4mWriter(const std::string& path, const Eigen::Vector2i& size, double fps)
+    : size_(size), planes_(static_cast<size_t>(size[0]) * size[1] * 3) {
+    if (path == "-")
+        file_ = {stdout, [](FILE*) {}};
+    else
+        file_ = {std::fopen(path.c_str(), "wb"), [](FILE* f) { if (f != nullptr) std::fclose(f); }};
+    if (file_ == nullptr)
+        throw std::runtime_error("Unable to open " + path + " for writing");
+
+    // Frame rate is a fraction, three decimals of fps are kept
+    const long long rate = std::llround(fps * 1000.0);
+    if (std::fprintf(file_.get(), "YUV4MPEG2 W%d H%d F%lld:1000 Ip A1:1 C444\n", size[0], size[1], rate) < 0)
+        throw std::runtime_error("Unable to write Y4M header");
+}
+
+void Y4mWriter::writeFrame(const uint8_t* rgba, size_t bytesPerRow) {
+    const size_t pixels = static_cast<size_t>(size_[0]) * size_[1];
+    uint8_t* y = planes_.data();
+    uint8_t* u = y + pixels;
+    uint8_t* v = u + pixels;
+    for (int row = 0; row < size_[1]; ++row) {
+        const uint8_t* src = rgba + row * bytesPerRow;
+        for (int x = 0; x < size_[0]; ++x, ++y, ++u, ++v) {
+            const int r = src[x * 4 + 0];
+            const int g = src[x * 4 + 1];
+            const int b = src[x * 4 + 2];
+            *y = static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+            *u = static_cast<uint8_t>(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+            *v = static_cast<uint8_t>(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+        }
+    }
+    if (std::fputs("FRAME\n", file_.get()) < 0 ||
+        std::fwrite(planes_.data(), 1, planes_.size(), file_.get()) != planes_.size())
+        throw std::runtime_error("Unable to write Y4M frame");
+}
+
+void Y4mWriter::finish() {
+    if (std::fflush(file_.get()) != 0)
+        throw std::runtime_error("Unable to flush Y4M stream");
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+#include <Eigen/Dense>
+
+// Streams RGBA8 frames as YUV4MPEG2 (4:4:4, BT.601 limited range), the raw video format ffmpeg and
+// most encoders read from a pipe: mandelbrot_batch ... --output - | ffmpeg -i - zoom.mp4
+class Y4mWriter final {
+public:
+    // "-" writes to stdout
+    Y4mWriter(const std::string& path, const Eigen::Vector2i& size, double fps);
+
+    void writeFrame(const uint8_t* rgba, size_t bytesPerRow);
+    void finish();
+private:
+    std::unique_ptr<FILE, std::function<void(FILE*)>> file_;
+    Eigen::Vector2i size_;
+    std::vector<uint8_t> planes_;
+};
@@ -0,0 +1,206 @@
+#include "ZoomSequence.hpp"
+
+#include "RenderJob.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <utility>
+
+namespace {
+    // Pixels are reused in blocks, a block with one uncertain pixel is recomputed as a whole
+    constexpr int blockSize = 16;
+    // Zoom between two frames beyond which nothing is reused
+    constexpr double maxReuseRatio = 2.0;
+
+    // Interpolates `current` from `previous` where it's safe and recomputes the rest, returns computed pixels
+    size_t reuseFrame(MandelbrotSetGenerator& generator, const Keyframe& before, const Keyframe& frame,
+                      const std::vector<float>& previous, std::vector<float>& current, float tolerance) {
+        const int width = generator.size()[0];
+        const int height = generator.size()[1];
+        // Pixel x of the frame is at x * ratio + shift in pixels of the previous one, the same for y
+        const double ratio = frame.scale / before.scale;
+        const double shiftX = static_cast<double>(frame.center.x - before.center.x) * width / before.scale +
+                              (1.0 - ratio) * width / 2.0;
+        const double shiftY = static_cast<double>(frame.center.y - before.center.y) * height / before.scale +
+                              (1.0 - ratio) * height / 2.0;
+        const float beforeMaxIt = static_cast<float>(before.maxIterations);
+        // A higher limit may let interior points escape, a lower one is never reused
+        const bool interiorKept = frame.maxIterations == before.maxIterations;
+
+        auto sample = [&](int x, int y, float& value) {
+            const double qx = x * ratio + shiftX;
+            const double qy = y * ratio + shiftY;
+            const int x0 = static_cast<int>(std::floor(qx));
+            const int y0 = static_cast<int>(std::floor(qy));
+            if (x0 < 0 || y0 < 0 || x0 + 1 >= width || y0 + 1 >= height)
+                return false;
+            const float* top = previous.data() + static_cast<size_t>(y0) * width + x0;
+            const float* bottom = top + width;
+            const float low = std::min({top[0], top[1], bottom[0], bottom[1]});
+            const float high = std::max({top[0], top[1], bottom[0], bottom[1]});
+            if (low >= beforeMaxIt) {
+                value = static_cast<float>(frame.maxIterations);
+                return interiorKept;
+            }
+            if (high >= beforeMaxIt || high - low > tolerance)
+                return false;
+            const float fx = static_cast<float>(qx - x0);
+            const float fy = static_cast<float>(qy - y0);
+            const float upper = top[0] + (top[1] - top[0]) * fx;
+            const float lower = bottom[0] + (bottom[1] - bottom[0]) * fx;
+            value = upper + (lower - upper) * fy;
+            return true;
+        };
+
+        size_t computed = 0;
+        for (int by = 0; by < height; by += blockSize) {
+            const int rows = std::min(blockSize, height - by);
+            // Uncertain blocks next to each other are computed as one region
+            auto compute = [&](int x0, int x1) {
+                const RenderRegion region{{x0, by}, {x1 - x0, rows}};
+                generator.renderIterations(region, current.data() + static_cast<size_t>(by) * width + x0, width);
+                computed += static_cast<size_t>(x1 - x0) * rows;
+            };
+            int runStart = -1; // first column of the run of uncertain blocks
+            for (int bx = 0; bx < width; bx += blockSize) {
+                bool certain = true;
+                const int columns = std::min(blockSize, width - bx);
+                for (int y = by; certain && y < by + rows; ++y) {
+                    float* dst = current.data() + static_cast<size_t>(y) * width;
+                    for (int x = bx; certain && x < bx + columns; ++x)
+                        certain = sample(x, y, dst[x]);
+                }
+                if (!certain && runStart < 0) {
+                    runStart = bx;
+                } else if (certain && runStart >= 0) {
+                    compute(runStart, bx);
+                    runStart = -1;
+                }
+            }
+            if (runStart >= 0)
+                compute(runStart, width);
+        }
+        return computed;
+    }
+} // namespace
+
+ZoomSequence::ZoomSequence(std::vector<Keyframe> keyframes)
+    : keyframes_(std::move(keyframes)) {
+    if (keyframes_.empty())
+        throw std::invalid_argument("Zoom sequence needs at least one keyframe");
+    for (size_t i = 0; i < keyframes_.size(); ++i) {
+        if (keyframes_[i].scale <= 0.0 || keyframes_[i].maxIterations == 0)
+            throw std::invalid_argument("Keyframe scale and max iterations must be positive");
+        if (i > 0 && keyframes_[i].time <= keyframes_[i - 1].time)
+            throw std::invalid_argument("Keyframe times must increase");
+    }
+}
+
+Keyframe ZoomSequence::at(double time) const {
+    if (time <= keyframes_.front().time)
+        return keyframes_.front();
+    if (time >= keyframes_.back().time)
+        return keyframes_.back();
+    const auto next = std::upper_bound(keyframes_.begin(), keyframes_.end(), time,
+                                       [](double t, const Keyframe& keyframe) { return t < keyframe.time; });
+    const Keyframe& a = *(next - 1);
+    const Keyframe& b = *next;
+    const double u = (time - a.time) / (b.time - a.time);
+
+    Keyframe frame;
+    frame.time = time;
+    frame.scale = a.scale * std::pow(b.scale / a.scale, u);
+    // The point which is at the same place of both views stays there all the way:
+    // center - point shrinks together with the scale
+    const double weight = std::abs(a.scale - b.scale) > 1e-12 * a.scale
+        ? (a.scale - frame.scale) / (a.scale - b.scale)
+        : u;
+    frame.center.x = a.center.x + DoubleDouble(static_cast<double>(b.center.x - a.center.x) * weight);
+    frame.center.y = a.center.y + DoubleDouble(static_cast<double>(b.center.y - a.center.y) * weight);
+    frame.maxIterations = static_cast<unsigned long>(std::llround(
+        static_cast<double>(a.maxIterations) + (static_cast<double>(b.maxIterations) - a.maxIterations) * u));
+    return frame;
+}
+
+size_t ZoomSequence::frameCount(double fps) const {
+    return static_cast<size_t>(std::floor((keyframes_.back().time - keyframes_.front().time) * fps)) + 1;
+}
+
+SequenceStats ZoomSequence::render(MandelbrotSetGenerator& generator, const SequenceOptions& options,
+                                   const FrameSink& sink) const {
+    if (options.fps <= 0.0)
+        throw std::invalid_argument("Frame rate must be positive");
+    const Eigen::Vector2i size = generator.size();
+    const size_t pixels = static_cast<size_t>(size[0]) * size[1];
+    std::vector<float> previous(pixels);
+    std::vector<float> current(pixels);
+    std::vector<uint8_t> rgba(pixels * 4);
+
+    SequenceStats stats;
+    Keyframe before{};
+    Precision beforePrecision = Precision::Auto;
+    const size_t frames = frameCount(options.fps);
+    for (size_t i = 0; i < frames; ++i) {
+        const Keyframe frame = at(keyframes_.front().time + static_cast<double>(i) / options.fps);
+        generator.setPreciseCenter(frame.center);
+        generator.setPreciseScale(frame.scale);
+        generator.setMaxIterations(frame.maxIterations);
+        generator.setDeepZoom(options.deepZoom);
+        // The generator moves to a finer precision as the frames narrow, the first frame of a new one
+        // is rendered in full, its counts differ from the coarser ones slightly
+        const Precision precision = generator.renderPrecision();
+
+        const double ratio = frame.scale / before.scale;
+        const bool reuse = i > 0 && options.reuseTolerance > 0.0f && precision == beforePrecision &&
+                           (options.refreshInterval <= 0 || i % options.refreshInterval != 0) &&
+                           frame.maxIterations >= before.maxIterations &&
+                           ratio <= maxReuseRatio && ratio >= 1.0 / maxReuseRatio;
+        if (reuse) {
+            stats.computedPixels += reuseFrame(generator, before, frame, previous, current, options.reuseTolerance);
+        } else {
+            generator.renderIterations({{0, 0}, size}, current.data(), size[0]);
+            stats.computedPixels += pixels;
+        }
+
+        generator.palette().colorize(current.data(), pixels, frame.maxIterations, rgba.data());
+        sink(rgba.data(), static_cast<size_t>(size[0]) * 4);
+        std::swap(previous, current);
+        before = frame;
+        beforePrecision = precision;
+        ++stats.frames;
+        stats.pixels += pixels;
+    }
+    return stats;
+}
+
+namespace ZoomSequences {
+
+std::vector<Keyframe> readFile(const std::string& path) {
+    std::ifstream file(path);
+    if (!file)
+        throw std::runtime_error("Unable to open keyframe file " + path);
+
+    std::vector<Keyframe> keyframes;
+    std::string line;
+    while (std::getline(file, line)) {
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string time, center, scale, maxIterations;
+        if (!(words >> time))
+            continue;
+        if (!(words >> center >> scale >> maxIterations))
+            throw std::invalid_argument("Malformed keyframe: " + line);
+        try {
+            keyframes.push_back({std::stod(time), RenderJobs::parsePoint(center), std::stod(scale),
+                                 std::stoul(maxIterations)});
+        } catch (const std::logic_error&) {
+            throw std::invalid_argument("Malformed keyframe: " + line);
+        }
+    }
+    return keyframes;
+}
+
+} // namespace ZoomSequences
@@ -0,0 +1,59 @@
+#pragma once
+
+#include "MandelbrotSetGenerator.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct Keyframe {
+    double time; // seconds
+    PrecisePoint center;
+    double scale;
+    unsigned long maxIterations;
+};
+
+struct SequenceOptions {
+    double fps = 30.0;
+    // Largest spread of the 4 previous frame counts a pixel is interpolated from, 0 disables the reuse
+    float reuseTolerance = 0.1f;
+    // Every n-th frame is rendered in full, so interpolation errors don't pile up
+    int refreshInterval = 30;
+    // Deep zoom for every frame, otherwise the generator picks the precision per frame
+    bool deepZoom = false;
+};
+
+struct SequenceStats {
+    size_t frames = 0;
+    size_t pixels = 0;
+    size_t computedPixels = 0;
+};
+
+// Zoom video along keyframes. Between two keyframes the scale changes geometrically and the center
+// moves so that one point of the plane stays in place on the screen, like a camera zooming into it.
+// Frame n + 1 reuses the counts of frame n: a pixel is interpolated from the 4 pixels around its
+// position in the previous frame when they all escaped and agree within the tolerance, blocks with
+// any other pixel are recomputed.
+class ZoomSequence final {
+public:
+    explicit ZoomSequence(std::vector<Keyframe> keyframes);
+
+    Keyframe at(double time) const;
+    size_t frameCount(double fps) const;
+
+    using FrameSink = std::function<void(const uint8_t* rgba, size_t bytesPerRow)>;
+    // Frames are computed by `generator` (its size, palette and shortcuts are used) one after another,
+    // each one on all threads of the generator
+    SequenceStats render(MandelbrotSetGenerator& generator, const SequenceOptions& options, const FrameSink& sink) const;
+private:
+    std::vector<Keyframe> keyframes_;
+};
+
+namespace ZoomSequences {
+
+// One "TIME X,Y SCALE MAX_ITERATIONS" keyframe per line, times increase, '#' starts a comment
+std::vector<Keyframe> readFile(const std::string& path);
+
+} // namespace ZoomSequences
@@ -2,120 +2,124 @@
 
 using namespace metal;
 
-float4 coldColorMap(float value)
-{
-    return float4(min(3.0 * value, 1.0),
-                 min(3.0 * value - 1.0, 1.0),
-                 min(3.0 * value - 2.0, 1.0),
-                 1.0);
-}
+// Bits of ViewParams::flags
+constant uint bulbCheckFlag = 1;
+constant uint periodicityCheckFlag = 2;
 
-float4 hotColorMap(float value)
-{
-    return float4(min(3.0 * value - 2.0, 1.0),
-                 min(3.0 * value - 1.0, 1.0),
-                 min(3.0 * value, 1.0),
-                 1.0);
-}
+// Squared distance of orbit points taken for the same point of a cycle
+constant float periodicityEpsilon = 1e-12;
 
-float4 greenColorMap(float value)
-{
-    return float4(min(3.0 * value - 1.0, 1.0),
-                 min(3.0 * value, 1.0),
-                 min(3.0 * value - 2.0, 1.0),
-                 1.0);
-}
+// Values of the Formula template parameter, same as FormulaType on the CPU
+constant uint mandelbrotFormula = 0;
+constant uint juliaFormula = 1;
+constant uint burningShipFormula = 2;
 
-float4 simpleColorMap(float value)
-{
-    return float4(value, value, value, 1.0);
-}
+// The grid covers samples of a region of the image which starts at `origin` and takes
+// every `step`-th pixel, `size` is the whole image. `julia` is the constant c of Julia sets.
+struct ViewParams {
+    float2 center;
+    float scale;
+    uint flags;
+    uint2 origin;
+    uint2 size;
+    uint step;
+    float2 julia;
+};
 
-float3 hsvToRgb(float3 hsv)
+// Main cardioid or period-2 bulb
+bool insideBulb(float2 c)
 {
-    float h60 = hsv.x / 60.0;
-    int hmod6 = int(h60) % 6;
-    float f = h60 - floor(h60);
-    float3 pqt(hsv.z * (1 - hsv.y),
-               hsv.z * (1 - f * hsv.y),
-               hsv.z * (1 - (1 - f) * hsv.y));
-    float3 rgb(0.0, 0.0, 0.0);
-    if (hmod6 == 0)
-        rgb = float3(hsv.z, pqt.z, pqt.x); // V T P
-    else if (hmod6 == 1)
-        rgb = float3(pqt.y, hsv.z, pqt.x); // Q V P
-    else if (hmod6 == 2)
-        rgb = float3(pqt.x, hsv.z, pqt.z); // P V T
-    else if (hmod6 == 3)
-        rgb = float3(pqt.x, pqt.y, hsv.z); // P Q V
-    else if (hmod6 == 4)
-        rgb = float3(pqt.z, pqt.x, hsv.z); // T P V
-    else if (hmod6 == 5)
-        rgb = float3(hsv.z, pqt.x, pqt.y); // V P Q
-    return rgb;
+    const float xq = c.x - 0.25;
+    const float y2 = c.y * c.y;
+    const float q = xq * xq + y2;
+    return q * (q + xq) <= 0.25 * y2 || (c.x + 1.0) * (c.x + 1.0) + y2 <= 0.0625;
 }
 
-float4 rainbowColorMap(float value)
+// z^Power, unrolled at compile time by squaring and multiplying
+template<uint Power>
+float2 complexPower(float2 z)
 {
-    float hue = value * 360.0;
-    float3 rgb = hsvToRgb(float3(hue, 1.0, 1.0));
-    return float4(rgb.x, rgb.y, rgb.z, 1.0);
+    if (Power == 2)
+        return float2(z.x * z.x - z.y * z.y, 2.0 * z.x * z.y);
+    const float2 h = complexPower<Power / 2>(z);
+    const float2 h2 = float2(h.x * h.x - h.y * h.y, 2.0 * h.x * h.y);
+    if (Power % 2 == 0)
+        return h2;
+    return float2(h2.x * z.x - h2.y * z.y, h2.x * z.y + h2.y * z.x);
 }
 
-float4 cubicInterpolation(float value, float4 c1, float4 c2)
+template<>
+float2 complexPower<1>(float2 z)
 {
-    float coef = (1.0 - pow((1.0 - value), 3.0));
-    return c1 + (c2 - c1) * coef;
+    return z;
 }
 
-float4 cubicInterpolatedColorMap(float value)
+// counters[0] - pixels inside of a bulb, counters[1] - pixels stopped by the periodicity check
+// Writes the smooth iteration count of every pixel, coloring is done on the CPU by a palette lookup.
+// Every formula and power is its own kernel, "<formula>_<power>" instantiated below.
+template<uint Formula, uint Power>
+kernel void escape(texture2d<float, access::write> image [[texture(0)]],
+                   device ViewParams *view [[buffer(0)]],
+                   device uint64_t *maxIterations [[buffer(1)]],
+                   device atomic_uint *counters [[buffer(2)]],
+                   uint2 index [[thread_position_in_grid]])
 {
-    float4 red(1.0, 0.0, 0.0, 0.0);
-    float4 green(0.0, 1.0, 0.0, 0.0);
-    float4 blue(0.0, 0.0, 1.0, 0.0);
-    if (value < 0.5)
-        return cubicInterpolation(2.0 * value, red, green);
-    //else if (value > 0.33 && value < 0.66)
-    //    return cubicInterpolation(3.0 * (value - 0.33), green, blue);
-    return cubicInterpolation(2.0 * (value - 0.5), green, blue);
+    const float scale(view->scale);
+    const float2 center(view->center);
+    const float width = view->size.x;
+    const float height = view->size.y;
+    const float x = index.x * view->step + view->origin.x;
+    const float y = index.y * view->step + view->origin.y;
 
-}
+    const float2 pixel = float2(scale * (x - width / 2.0) / width + center.x,
+                                scale * (y - height / 2.0) / height + center.y);
+    const float2 c = Formula == juliaFormula ? view->julia : pixel;
 
-uint floatColorToInt(float value) {
-    return uint(clamp(value, 0.0, 1.0) * 255.0);
-}
-
-kernel void mandelbrot(texture2d<uint, access::write> image [[texture(0)]],
-                       device float3 *position [[buffer(0)]],
-                       device uint64_t *maxIterations [[buffer(1)]],
-                       uint2 index [[thread_position_in_grid]],
-                       uint2 gridSize [[threads_per_grid]])
-{
-    const float scale(position->z);
-    const float2 center(position->x, position->y);
-    const float width = gridSize.x;
-    const float height = gridSize.y;
-    const float x = index.x;
-    const float y = index.y;
-
-    const float2 c = float2(scale * (x - width / 2.0) / width + center.x,
-                            scale * (y - height / 2.0) / height + center.y);
-
-    float2 z = c;
-    uint64_t i;
-    for (i = 0; i < *maxIterations; ++i) {
-        float2 zSquared = float2(z.x * z.x - z.y * z.y, 2.0 * z.x * z.y);
-        z = zSquared + c;
+    float2 z = pixel;
+    uint64_t i = 0;
+    bool interior = false;
+    if (Formula == mandelbrotFormula && Power == 2 && (view->flags & bulbCheckFlag) && insideBulb(c)) {
+        interior = true;
+        atomic_fetch_add_explicit(&counters[0], 1, memory_order_relaxed);
+    }
+    // Brent: z is compared with the point saved at the last power of two
+    const bool periodicity = view->flags & periodicityCheckFlag;
+    float2 saved = z;
+    uint64_t saveAt = 1;
+    for (; !interior && i < *maxIterations; ++i) {
+        z = complexPower<Power>(Formula == burningShipFormula ? abs(z) : z) + c;
         if (length(z) > 2.0) {
             break;
         }
+        if (periodicity) {
+            const float2 d = z - saved;
+            if (dot(d, d) <= periodicityEpsilon) {
+                interior = true;
+                atomic_fetch_add_explicit(&counters[1], 1, memory_order_relaxed);
+                break;
+            }
+            if (i + 1 == saveAt) {
+                saveAt *= 2;
+                saved = z;
+            }
+        }
     }
     float colorfulValue = *maxIterations;
     float lengthZ = length(z);
-    if (lengthZ > 1 && i < *maxIterations)
-        colorfulValue = i + 1.0 - log(log2(lengthZ));
-    colorfulValue /= *maxIterations; // normalization;
-    float4 pixel = rainbowColorMap(colorfulValue);
-    uint4 px = uint4(clamp(pixel, 0.0, 1.0) * 255.0);
-    image.write(px, index);
+    if (!interior && lengthZ > 1 && i < *maxIterations)
+        colorfulValue = i + 1.0 - log(log2(lengthZ)) / log2(float(Power));
+    image.write(float4(colorfulValue, 0.0, 0.0, 0.0), index);
 }
+
+#define ESCAPE_KERNEL(formula, name, power) \
+    template [[host_name(#name "_" #power)]] [[kernel]] decltype(escape<formula, power>) escape<formula, power>;
+
+#define ESCAPE_KERNELS(formula, name) \
+    ESCAPE_KERNEL(formula, name, 2) ESCAPE_KERNEL(formula, name, 3) ESCAPE_KERNEL(formula, name, 4) \
+    ESCAPE_KERNEL(formula, name, 5) ESCAPE_KERNEL(formula, name, 6) ESCAPE_KERNEL(formula, name, 7) \
+    ESCAPE_KERNEL(formula, name, 8)
+
+// Powers 2...Formula::maxPower
+ESCAPE_KERNELS(mandelbrotFormula, mandelbrot)
+ESCAPE_KERNELS(juliaFormula, julia)
+ESCAPE_KERNELS(burningShipFormula, burning_ship)
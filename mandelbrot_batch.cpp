@@ -0,0 +1,376 @@
+// Headless renderer: no window, no SDL, images are streamed to disk band by band
+
+#include "FrameMetrics.hpp"
+#include "ImageWriter.hpp"
+#include "IterationSnapshot.hpp"
+#include "Log.hpp"
+#include "MandelbrotSetGenerator.hpp"
+#include "RenderJob.hpp"
+#include "TileContainer.hpp"
+#include "TilePyramid.hpp"
+#include "Y4mWriter.hpp"
+#include "ZoomSequence.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fmt/core.h>
+#include <optional>
+
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    const char* usage =
+        "Usage: mandelbrot_batch [options]\n"
+        "  --size WxH              image size in pixels (1920x1080)\n"
+        "  --center X,Y            center of the view (-0.5,0)\n"
+        "  --scale S               width of the view in the complex plane (3)\n"
+        "  --max-iterations N      iteration limit (350)\n"
+        "  --auto-iterations       pick the iteration limit from the escape times of a preview, N is the start\n"
+        "  --formula NAME          mandelbrot, multibrot, julia or burning-ship (mandelbrot)\n"
+        "  --power N               exponent of z, 2 to 8 (2)\n"
+        "  --julia X,Y             constant c of the julia set (-0.8,0.156)\n"
+        "  --precision NAME        auto, float, double or double-double, auto picks the cheapest one which\n"
+        "                          resolves the pixels (auto)\n"
+        "  --deep-zoom             perturbation rendering at any scale, z^2 mandelbrot only\n"
+        "  --bulb-check            skip points of the main cardioid and the period-2 bulb\n"
+        "  --periodicity-check     stop orbits which are detected to cycle\n"
+        "  --boundary-trace        compute rectangle borders only, fill the uniform ones (not in pyramids)\n"
+        "  --antialias N           up to N samples (4, 9, 16...) for pixels next to sharp changes (1, off)\n"
+        "  --aa-pattern NAME       jittered or stratified samples (jittered)\n"
+        "  --aa-threshold T        supersample where neighbours differ by T of the iteration limit (0.0039)\n"
+        "  --palette NAME|FILE     built-in palette or a file of \"R G B\" lines (rainbow)\n"
+        "  --output FILE           .png or .ppm file\n"
+        "  --band-rows N           rows rendered and written at once (256)\n"
+        "  --snapshot FILE         also save the iteration counts and the view, to recolor them later (not in tiles)\n"
+        "  --from-snapshot FILE    color the counts of a snapshot into OUTPUT with --palette instead of rendering\n"
+        "  --crop X,Y,WxH          pixels of the snapshot to color (all)\n"
+        "  --thumbnail W           scale the crop to W pixels wide, taking the nearest counts\n"
+        "  --tile-size N           render N x N tiles into a resumable container first\n"
+        "  --tiles FILE            tile container, rerun the same job to resume it (OUTPUT.tiles)\n"
+        "  --pyramid DIR           render a z/x/y tile pyramid under the view instead of an image\n"
+        "  --levels MIN-MAX        pyramid levels (0)\n"
+        "  --cache DIR             iteration cache of the pyramid (DIR/cache)\n"
+        "  --sequence FILE         render a zoom video along the keyframes of FILE to a .y4m OUTPUT, - is stdout\n"
+        "  --fps N                 frames per second of the video (30)\n"
+        "  --reuse-tolerance T     interpolate pixels from the previous frame within T iterations, 0 disables (0.1)\n"
+        "  --refresh N             render every N-th frame in full (30)\n"
+        "  --jobs FILE             render every line of FILE, lines hold the options above\n"
+        "  --backend cpu|metal     compute backend (default one of the build)\n"
+        "  --threads N             CPU backend threads (all cores)\n"
+        "  --trace FILE            save stage timings of every job as a Chrome trace (chrome://tracing)\n";
+
+    // Everything that changes the pixels, a container is resumed only by the job it was started with
+    std::string describe(const RenderJob& job) {
+        const Precision precision = job.precision == Precision::Auto
+            ? Precisions::pick(job.center, job.scale, job.size) : job.precision;
+        return fmt::format("center {:a}{:+a},{:a}{:+a} scale {:a} iterations {} deep {} palette {}{}{}{}{}",
+                           job.center.x.hi, job.center.x.lo, job.center.y.hi, job.center.y.lo,
+                           job.scale, job.maxIterations, job.deepZoom, job.palette,
+                           job.formula == Formula{} ? "" : " formula " + Formulas::describe(job.formula),
+                           precision == Precision::Float ? "" : fmt::format(" precision {}", Precisions::name(precision)),
+                           job.boundaryTrace ? " traced" : "",
+                           job.antiAliasing.enabled()
+                               ? fmt::format(" aa {} {} {:a}", job.antiAliasing.samples,
+                                             AntiAliasings::patternName(job.antiAliasing.pattern), job.antiAliasing.threshold)
+                               : "");
+    }
+
+    // Tiles are committed in groups, every commit syncs the container once
+    constexpr size_t tilesPerCommit = 64;
+
+    void renderTiles(MandelbrotSetGenerator& generator, const RenderJob& job) {
+        const std::string path = job.tiles.empty() ? job.output + ".tiles" : job.tiles;
+        TileContainer container(path, job.size, job.tileSize, describe(job));
+        const Eigen::Vector2i count = container.tileCount();
+        const size_t total = static_cast<size_t>(count[0]) * count[1];
+        const size_t resumed = container.completedTiles();
+        if (resumed > 0)
+            Log::info("{}: resuming with {} of {} tiles done", path, resumed, total);
+
+        const size_t bytesPerRow = static_cast<size_t>(job.tileSize) * 4;
+        std::vector<uint8_t> tile(bytesPerRow * job.tileSize);
+        size_t rendered = 0;
+        for (int y = 0; y < count[1]; ++y) {
+            for (int x = 0; x < count[0]; ++x) {
+                if (container.hasTile({x, y}))
+                    continue;
+                const Eigen::Vector2i extent = container.tileExtent({x, y});
+                generator.render({{x * job.tileSize, y * job.tileSize}, extent}, tile.data(), bytesPerRow);
+                container.writeTile({x, y}, tile.data(), bytesPerRow);
+                if (++rendered % tilesPerCommit == 0) {
+                    container.commit();
+                    Log::info("{}: {} of {} tiles", path, resumed + rendered, total);
+                }
+            }
+        }
+        container.commit();
+
+        if (job.output.empty())
+            return;
+        auto writer = ImageWriter::create(job.output, job.size);
+        const size_t imageBytesPerRow = static_cast<size_t>(job.size[0]) * 4;
+        std::vector<uint8_t> band(imageBytesPerRow * std::min(job.bandRows, job.size[1]));
+        for (int y = 0; y < job.size[1]; y += job.bandRows) {
+            const int rows = std::min(job.bandRows, job.size[1] - y);
+            container.readRows(y, rows, band.data(), imageBytesPerRow);
+            writer->writeRows(band.data(), imageBytesPerRow, rows);
+        }
+        writer->finish();
+    }
+
+    void renderBands(MandelbrotSetGenerator& generator, const RenderJob& job) {
+        auto writer = ImageWriter::create(job.output, job.size);
+        std::optional<SnapshotWriter> snapshot;
+        if (!job.snapshot.empty())
+            snapshot.emplace(job.snapshot, generator.snapshotView());
+        const size_t width = static_cast<size_t>(job.size[0]);
+        const size_t bytesPerRow = width * 4;
+        std::vector<uint8_t> band(bytesPerRow * std::min(job.bandRows, job.size[1]));
+        std::vector<float> values(snapshot ? width * std::min(job.bandRows, job.size[1]) : 0);
+        for (int y = 0; y < job.size[1]; y += job.bandRows) {
+            const int rows = std::min(job.bandRows, job.size[1] - y);
+            if (snapshot) {
+                // The counts are colored here, so they are at hand for the snapshot
+                generator.renderIterations({{0, y}, {job.size[0], rows}}, values.data(), width);
+                snapshot->writeRows(values.data(), width, rows);
+                generator.palette().colorize(values.data(), width * rows, job.maxIterations, band.data());
+            } else {
+                generator.render({{0, y}, {job.size[0], rows}}, band.data(), bytesPerRow);
+            }
+            writer->writeRows(band.data(), bytesPerRow, rows);
+        }
+        writer->finish();
+        if (snapshot)
+            snapshot->finish();
+    }
+
+    // Nothing is rendered: the crop is colored from the mapped counts, so only the rows (and with a
+    // thumbnail only the pages) under the sampled pixels are read from the file
+    void recolorSnapshot(const RenderJob& job) {
+        if (job.output.empty())
+            throw std::invalid_argument("Output file isn't specified");
+        const auto start = std::chrono::steady_clock::now();
+        const IterationSnapshot snapshot(job.fromSnapshot);
+        const SnapshotView& view = snapshot.view();
+        const Eigen::Vector2i crop = job.cropSize.isZero() ? view.size : job.cropSize;
+        if (((job.cropOrigin + crop).array() > view.size.array()).any())
+            throw std::out_of_range(fmt::format("Crop is out of the {}x{} snapshot", view.size[0], view.size[1]));
+        const Eigen::Vector2i size = job.thumbnailWidth > 0
+            ? Eigen::Vector2i(job.thumbnailWidth,
+                              std::max(1, static_cast<int>(static_cast<int64_t>(crop[1]) * job.thumbnailWidth / crop[0])))
+            : crop;
+
+        // Nearest count to the center of every output pixel
+        auto source = [](int i, int from, int count, int to) {
+            return from + static_cast<int>((2 * static_cast<int64_t>(i) + 1) * count / (2 * static_cast<int64_t>(to)));
+        };
+        std::vector<int> columns(size[0]);
+        for (int x = 0; x < size[0]; ++x)
+            columns[x] = source(x, job.cropOrigin[0], crop[0], size[0]);
+
+        const Palette palette = Palettes::resolve(job.palette);
+        auto writer = ImageWriter::create(job.output, size);
+        const size_t bytesPerRow = static_cast<size_t>(size[0]) * 4;
+        std::vector<uint8_t> band(bytesPerRow * std::min(job.bandRows, size[1]));
+        std::vector<float> values(size[0]);
+        for (int y = 0; y < size[1]; y += job.bandRows) {
+            const int rows = std::min(job.bandRows, size[1] - y);
+            for (int row = 0; row < rows; ++row) {
+                const float* counts = snapshot.row(source(y + row, job.cropOrigin[1], crop[1], size[1]));
+                if (size[0] == crop[0]) {
+                    palette.colorize(counts + job.cropOrigin[0], values.size(), view.maxIterations,
+                                     band.data() + row * bytesPerRow);
+                    continue;
+                }
+                for (int x = 0; x < size[0]; ++x)
+                    values[x] = counts[columns[x]];
+                palette.colorize(values.data(), values.size(), view.maxIterations, band.data() + row * bytesPerRow);
+            }
+            writer->writeRows(band.data(), bytesPerRow, rows);
+        }
+        writer->finish();
+
+        const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        Log::info("{}: {}x{} from the {}x{} snapshot {} in {:.3f}s", job.output, size[0], size[1],
+                  view.size[0], view.size[1], job.fromSnapshot, elapsed);
+    }
+
+    void renderSequence(MandelbrotSetGenerator& generator, const RenderJob& job) {
+        if (job.output.empty())
+            throw std::invalid_argument("Output file isn't specified");
+        const ZoomSequence sequence(ZoomSequences::readFile(job.sequence));
+        const auto start = std::chrono::steady_clock::now();
+        generator.setSize(job.size);
+        generator.setBulbCheck(job.bulbCheck);
+        generator.setPeriodicityCheck(job.periodicityCheck);
+        generator.setFormula(job.formula);
+        generator.setPrecision(job.precision);
+        generator.setRenderStrategy(job.boundaryTrace ? RenderStrategy::BoundaryTrace : RenderStrategy::PerPixel);
+        generator.setAntiAliasing({});
+        generator.setPalette(Palettes::resolve(job.palette));
+
+        Y4mWriter writer(job.output, job.size, job.fps);
+        const SequenceOptions options{job.fps, job.reuseTolerance, job.refreshInterval, job.deepZoom};
+        const SequenceStats stats = sequence.render(generator, options, [&](const uint8_t* rgba, size_t bytesPerRow) {
+            writer.writeFrame(rgba, bytesPerRow);
+        });
+        writer.finish();
+
+        const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        Log::info("{}: {} frames {}x{} in {:.2f}s ({:.1f} fps), {:.1f}% of pixels reused", job.output, stats.frames,
+                  job.size[0], job.size[1], elapsed, static_cast<double>(stats.frames) / elapsed,
+                  100.0 - 100.0 * static_cast<double>(stats.computedPixels) / static_cast<double>(stats.pixels));
+    }
+
+    // The limit is picked once on a small preview of the view, so every band and tile uses the same one
+    unsigned long pickIterations(MandelbrotSetGenerator& generator, const RenderJob& job) {
+        const int width = std::min(job.size[0], 256);
+        const int height = std::max(1, static_cast<int>(static_cast<int64_t>(job.size[1]) * width / job.size[0]));
+        generator.setSize({width, height});
+        generator.setAutoIterations(true);
+        generator.computeIterations();
+        generator.setAutoIterations(false);
+        generator.setSize(job.size);
+        return generator.maxIterations();
+    }
+
+    void renderJob(MandelbrotSetGenerator& generator, const RenderJob& job) {
+        if (job.output.empty() && (job.tileSize == 0 || job.tiles.empty()))
+            throw std::invalid_argument("Output file isn't specified");
+        // A snapshot keeps one count per pixel, supersamples are colors and tiles come in any order
+        if (!job.snapshot.empty() && (job.tileSize > 0 || job.antiAliasing.enabled()))
+            throw std::invalid_argument("Snapshots can't be saved with tiles or anti-aliasing");
+
+        const auto start = std::chrono::steady_clock::now();
+        generator.setSize(job.size);
+        generator.setPreciseCenter(job.center);
+        generator.setPreciseScale(job.scale);
+        generator.setDeepZoom(job.deepZoom);
+        generator.setBulbCheck(job.bulbCheck);
+        generator.setPeriodicityCheck(job.periodicityCheck);
+        generator.setFormula(job.formula);
+        generator.setPrecision(job.precision);
+        generator.setRenderStrategy(job.boundaryTrace ? RenderStrategy::BoundaryTrace : RenderStrategy::PerPixel);
+        generator.setAntiAliasing({});
+        generator.resetShortcutStats();
+        generator.setMaxIterations(job.maxIterations);
+        generator.setPalette(Palettes::resolve(job.palette));
+
+        RenderJob resolved = job;
+        if (job.autoIterations) {
+            resolved.maxIterations = pickIterations(generator, job);
+            generator.setMaxIterations(resolved.maxIterations);
+            Log::info("{}: {} iterations", job.output.empty() ? job.tiles : job.output, resolved.maxIterations);
+        }
+        // After the preview, which needs no supersampling
+        generator.setAntiAliasing(job.antiAliasing);
+        if (job.tileSize > 0)
+            renderTiles(generator, resolved);
+        else
+            renderBands(generator, resolved);
+
+        const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        Log::info("{}: {}x{} in {:.2f}s ({:.1f} Mpx/s)", job.output.empty() ? job.tiles : job.output, job.size[0], job.size[1], elapsed,
+                  static_cast<double>(job.size[0]) * job.size[1] / elapsed / 1e6);
+        if (job.bulbCheck || job.periodicityCheck) {
+            const ShortcutStats& stats = generator.shortcutStats();
+            Log::info("Shortcuts: {} of {} pixels in bulbs, {} periodic", stats.bulbs, stats.pixels, stats.periodic);
+        }
+        if (job.antiAliasing.enabled())
+            Log::info("Anti-aliasing: {} pixels supersampled", generator.metrics().supersampledPixels);
+        if (job.boundaryTrace) {
+            const ShortcutStats& stats = generator.shortcutStats();
+            Log::info("Boundary tracing filled {} of {} pixels", stats.filled, stats.pixels);
+        }
+        const Precision precision = generator.renderPrecision();
+        if (precision != Precision::Float)
+            Log::info("Precision: {}", Precisions::name(precision));
+        if (precision == Precision::DoubleDouble && job.formula.quadraticMandelbrot() && generator.cpuBackend() != nullptr) {
+            const DeepZoomStats& stats = generator.cpuBackend()->deepZoomStats();
+            Log::info("Reference orbit: {} points, {} rebases", stats.referenceLength, stats.rebases);
+        }
+    }
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        std::vector<std::string> args(argv + 1, argv + argc);
+        std::vector<std::string> rest;
+        const RenderJob cliJob = RenderJobs::parse(args, {}, &rest);
+
+        BackendType backend = BackendType::Default;
+        unsigned threads = std::thread::hardware_concurrency();
+        std::string jobFile;
+        std::string tracePath;
+        for (size_t i = 0; i < rest.size(); ++i) {
+            const bool hasValue = i + 1 < rest.size();
+            if (rest[i] == "--help" || rest[i] == "-h") {
+                std::fputs(usage, stdout);
+                std::fputs("Palettes:", stdout);
+                for (const std::string& name : Palettes::names())
+                    std::printf(" %s", name.c_str());
+                std::fputs("\n", stdout);
+                return 0;
+            } else if (rest[i] == "--jobs" && hasValue) {
+                jobFile = rest[++i];
+            } else if (rest[i] == "--backend" && hasValue) {
+                const std::string name = rest[++i];
+                if (name == "cpu")
+                    backend = BackendType::Cpu;
+                else if (name == "metal")
+                    backend = BackendType::Metal;
+                else
+                    throw std::invalid_argument("Unknown backend " + name);
+            } else if (rest[i] == "--trace" && hasValue) {
+                tracePath = rest[++i];
+            } else if (rest[i] == "--threads" && hasValue) {
+                threads = static_cast<unsigned>(std::stoul(rest[++i]));
+            } else {
+                throw std::invalid_argument("Unknown option " + rest[i] + "\n" + usage);
+            }
+        }
+
+        // The options of the command line are defaults for every line of the job file
+        const std::vector<RenderJob> jobs = jobFile.empty()
+            ? std::vector<RenderJob>{cliJob}
+            : RenderJobs::readFile(jobFile, cliJob);
+
+        MandelbrotSetGenerator generator(backend, threads);
+        FrameTrace trace(std::max<size_t>(jobs.size(), 1));
+        for (size_t i = 0; i < jobs.size(); ++i) {
+            const RenderJob& job = jobs[i];
+            if (!job.fromSnapshot.empty()) {
+                recolorSnapshot(job);
+                continue;
+            }
+            if (job.pyramid.empty()) {
+                generator.resetMetrics();
+                if (job.sequence.empty())
+                    renderJob(generator, job);
+                else
+                    renderSequence(generator, job);
+                FrameMetrics metrics = generator.metrics();
+                metrics.frame = i;
+                trace.record(metrics);
+                continue;
+            }
+            const auto start = std::chrono::steady_clock::now();
+            const PyramidStats stats = TilePyramid(job, backend, threads).render();
+            const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            Log::info("{}: {} tiles rendered, {} recolored from the cache, {} present in {:.2f}s",
+                      job.pyramid, stats.rendered, stats.recolored, stats.present, elapsed);
+        }
+        if (!tracePath.empty()) {
+            trace.writeChromeTrace(tracePath);
+            Log::info("Trace of {} jobs saved to {}", trace.frames().size(), tracePath);
+        }
+    }
+    catch (const std::exception& e) {
+        Log::error("{}", e.what());
+        return 1;
+    }
+    return 0;
+}
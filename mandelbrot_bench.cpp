@@ -0,0 +1,242 @@
+// Benchmarks of the compute core: render throughput per view, backend, escape kernel, formula and thread count,
+// coloring, and the frame handoff of getImage(). Results are tracked over time as JSON:
+//   mandelbrot_bench --benchmark_out=bench.json --benchmark_out_format=json
+
+#include "EscapeKernel.hpp"
+#include "MandelbrotSetGenerator.hpp"
+
+#include <benchmark/benchmark.h>
+#include <fmt/core.h>
+
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    // Fixed views, so numbers of different builds are comparable
+    struct Scenario {
+        const char* name;
+        PrecisePoint center;
+        double scale;
+        unsigned long maxIterations;
+    };
+
+    const Scenario scenarios[] = {
+        // The whole set, a mix of fast escapes and interior
+        {"full_set", {-0.75, 0.0}, 3.0, 350},
+        // Start view of the viewer, see SDLApp::initView()
+        {"default_view", {-1.186592e+0, -1.901211e-1}, 1 / 6.290223e+3, 350},
+        // Inside the main cardioid, every pixel runs up to the limit
+        {"interior", {-0.1, 0.0}, 0.05, 350},
+        // Seahorse valley with a high limit, long orbits next to the boundary
+        {"boundary", {-0.743643887037151, 0.131825904205330}, 1e-4, 10000},
+    };
+
+    // Every formula has its own compiled loop, iterations/s shows what a step of each one costs
+    struct FormulaCase {
+        const char* name;
+        Formula formula;
+    };
+
+    const FormulaCase formulaCases[] = {
+        {"mandelbrot", {}},
+        {"multibrot3", {FormulaType::Mandelbrot, 3}},
+        {"multibrot8", {FormulaType::Mandelbrot, 8}},
+        {"julia", {FormulaType::Julia, 2}},
+        {"burning_ship", {FormulaType::BurningShip, 2}},
+    };
+
+    const Eigen::Vector2i imageSize{640, 360};
+
+    void setView(MandelbrotSetGenerator& generator, const Scenario& scenario) {
+        generator.setSize(imageSize);
+        generator.setPreciseCenter(scenario.center);
+        generator.setPreciseScale(scenario.scale);
+        generator.setMaxIterations(scenario.maxIterations);
+    }
+
+    // Orbit steps of the last render, taken from the smooth counts, so it's approximate within a step per pixel
+    double iterationCount(const MandelbrotSetGenerator& generator) {
+        double sum = 0.0;
+        for (float value : generator.iterations())
+            sum += value;
+        return sum;
+    }
+
+    void setRenderCounters(benchmark::State& state, const MandelbrotSetGenerator& generator) {
+        const double pixels = static_cast<double>(imageSize[0]) * imageSize[1];
+        state.counters["pixels/s"] = benchmark::Counter(pixels, benchmark::Counter::kIsIterationInvariantRate);
+        state.counters["iterations/s"] = benchmark::Counter(iterationCount(generator),
+                                                            benchmark::Counter::kIsIterationInvariantRate);
+    }
+
+    void renderBenchmark(benchmark::State& state, const Scenario& scenario, BackendType backend,
+                         RenderStrategy strategy) {
+        MandelbrotSetGenerator generator(backend, static_cast<unsigned>(state.range(0)));
+        setView(generator, scenario);
+        generator.setRenderStrategy(strategy);
+        for (auto _ : state) {
+            generator.computeIterations();
+            benchmark::DoNotOptimize(generator.iterations().data());
+        }
+        setRenderCounters(state, generator);
+    }
+
+    // One CPU thread with the given escape kernel, compares the instruction sets
+    void kernelBenchmark(benchmark::State& state, const Scenario& scenario, const EscapeKernel* kernel) {
+        MandelbrotSetGenerator generator(BackendType::Cpu, 1);
+        setView(generator, scenario);
+        generator.computeIterations();
+        generator.cpuBackend()->setKernel(*kernel);
+        for (auto _ : state) {
+            generator.computeIterations();
+            benchmark::DoNotOptimize(generator.iterations().data());
+        }
+        setRenderCounters(state, generator);
+    }
+
+    // Best kernel on one thread, the whole plane around the origin fits every formula
+    void formulaBenchmark(benchmark::State& state, const Formula& formula) {
+        MandelbrotSetGenerator generator(BackendType::Cpu, 1);
+        setView(generator, {"", {-0.25, 0.0}, 3.5, 1000});
+        generator.setFormula(formula);
+        for (auto _ : state) {
+            generator.computeIterations();
+            benchmark::DoNotOptimize(generator.iterations().data());
+        }
+        setRenderCounters(state, generator);
+    }
+
+    // One view in each precision on all cores, shows what the finer tiers cost where float would still do
+    void precisionBenchmark(benchmark::State& state, Precision precision) {
+        MandelbrotSetGenerator generator(BackendType::Cpu);
+        setView(generator, scenarios[3]);
+        generator.setPrecision(precision);
+        for (auto _ : state) {
+            generator.computeIterations();
+            benchmark::DoNotOptimize(generator.iterations().data());
+        }
+        setRenderCounters(state, generator);
+    }
+
+    void colorizeBenchmark(benchmark::State& state, const std::string& palette) {
+        MandelbrotSetGenerator generator(BackendType::Cpu);
+        setView(generator, scenarios[1]);
+        generator.setPalette(Palettes::byName(palette));
+        generator.computeIterations();
+        const size_t bytesPerRow = static_cast<size_t>(imageSize[0]) * 4;
+        std::vector<uint8_t> image(bytesPerRow * imageSize[1]);
+        for (auto _ : state) {
+            generator.colorize(image.data(), bytesPerRow);
+            benchmark::ClobberMemory();
+        }
+        state.SetItemsProcessed(state.iterations() * imageSize[0] * imageSize[1]);
+    }
+
+    // getImage() of an unchanged view in incremental mode keeps the iterations, what's left is coloring
+    // and the handoff: a new buffer per frame, or caller's memory with padded rows like a locked texture
+    void getImageBenchmark(benchmark::State& state, bool callerMemory) {
+        MandelbrotSetGenerator generator(BackendType::Cpu);
+        setView(generator, scenarios[1]);
+        generator.setIncremental(true);
+        generator.computeIterations();
+        const size_t bytesPerRow = static_cast<size_t>(imageSize[0]) * 4 + 64;
+        std::vector<uint8_t> texture(bytesPerRow * imageSize[1]);
+        for (auto _ : state) {
+            if (callerMemory) {
+                generator.getImage(texture.data(), bytesPerRow);
+                benchmark::ClobberMemory();
+            } else {
+                RawBufferPtr image = generator.getImage();
+                benchmark::DoNotOptimize(image.get());
+            }
+        }
+        state.SetBytesProcessed(state.iterations() * imageSize[0] * imageSize[1] * 4);
+    }
+
+    // Encoding or decoding CompressedIterations of a scenario, ratio is float bytes per compressed byte
+    void compressionBenchmark(benchmark::State& state, const Scenario& scenario, bool decode) {
+        MandelbrotSetGenerator generator(BackendType::Cpu);
+        setView(generator, scenario);
+        generator.computeIterations();
+        const CompressedIterations compressed = generator.compressedIterations();
+        std::vector<float> values(generator.iterations().size());
+        for (auto _ : state) {
+            if (decode) {
+                compressed.decodeRows(0, imageSize[1], values.data(), imageSize[0]);
+                benchmark::ClobberMemory();
+            } else {
+                benchmark::DoNotOptimize(generator.compressedIterations().bytes());
+            }
+        }
+        state.SetItemsProcessed(state.iterations() * imageSize[0] * imageSize[1]);
+        state.counters["ratio"] = static_cast<double>(values.size() * sizeof(float)) / compressed.bytes();
+    }
+
+    void registerBenchmarks() {
+        // Thread scaling curve in powers of two up to all cores
+        const int cores = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+        std::vector<int64_t> threads;
+        for (int count = 1; count < cores; count *= 2)
+            threads.push_back(count);
+        threads.push_back(cores);
+
+        for (const Scenario& scenario : scenarios) {
+            auto* cpu = benchmark::RegisterBenchmark(fmt::format("Render/{}/cpu", scenario.name).c_str(),
+                                                     renderBenchmark, scenario, BackendType::Cpu, RenderStrategy::PerPixel);
+            for (int64_t count : threads)
+                cpu->Arg(count);
+            cpu->ArgName("threads")->UseRealTime()->Unit(benchmark::kMillisecond);
+            // Same on all cores with the boundary tracer, pixels/s counts the filled pixels too
+            benchmark::RegisterBenchmark(fmt::format("Render/{}/cpu_traced", scenario.name).c_str(),
+                                         renderBenchmark, scenario, BackendType::Cpu, RenderStrategy::BoundaryTrace)
+                ->Arg(cores)->ArgName("threads")->UseRealTime()->Unit(benchmark::kMillisecond);
+#ifdef MANDELBROT_WITH_METAL
+            benchmark::RegisterBenchmark(fmt::format("Render/{}/metal", scenario.name).c_str(),
+                                         renderBenchmark, scenario, BackendType::Metal, RenderStrategy::PerPixel)
+                ->Arg(cores)->ArgName("threads")->UseRealTime()->Unit(benchmark::kMillisecond);
+#endif
+            benchmark::RegisterBenchmark(fmt::format("Compression/{}/encode", scenario.name).c_str(),
+                                         compressionBenchmark, scenario, false)
+                ->UseRealTime()->Unit(benchmark::kMicrosecond);
+            benchmark::RegisterBenchmark(fmt::format("Compression/{}/decode", scenario.name).c_str(),
+                                         compressionBenchmark, scenario, true)
+                ->UseRealTime()->Unit(benchmark::kMicrosecond);
+            for (const EscapeKernel* kernel : EscapeKernels::available()) {
+                benchmark::RegisterBenchmark(fmt::format("Kernel/{}/{}", scenario.name, kernel->name).c_str(),
+                                             kernelBenchmark, scenario, kernel)
+                    ->UseRealTime()->Unit(benchmark::kMillisecond);
+            }
+        }
+        for (const FormulaCase& formulaCase : formulaCases)
+            benchmark::RegisterBenchmark(fmt::format("Formula/{}", formulaCase.name).c_str(),
+                                         formulaBenchmark, formulaCase.formula)
+                ->UseRealTime()->Unit(benchmark::kMillisecond);
+        for (Precision precision : {Precision::Float, Precision::Double, Precision::DoubleDouble})
+            benchmark::RegisterBenchmark(fmt::format("Precision/{}", Precisions::name(precision)).c_str(),
+                                         precisionBenchmark, precision)
+                ->UseRealTime()->Unit(benchmark::kMillisecond);
+        for (const std::string& palette : Palettes::names())
+            benchmark::RegisterBenchmark(fmt::format("Colorize/{}", palette).c_str(), colorizeBenchmark, palette)
+                ->UseRealTime()->Unit(benchmark::kMicrosecond);
+        benchmark::RegisterBenchmark("GetImage/new_buffer", getImageBenchmark, false)
+            ->UseRealTime()->Unit(benchmark::kMicrosecond);
+        benchmark::RegisterBenchmark("GetImage/caller_memory", getImageBenchmark, true)
+            ->UseRealTime()->Unit(benchmark::kMicrosecond);
+
+        benchmark::AddCustomContext("image_size", fmt::format("{}x{}", imageSize[0], imageSize[1]));
+        benchmark::AddCustomContext("escape_kernel", EscapeKernels::best().name);
+    }
+} // namespace
+
+int main(int argc, char* argv[]) {
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    registerBenchmarks();
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
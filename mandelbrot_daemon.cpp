@@ -0,0 +1,73 @@
+// Render daemon: one warm generator serving render requests of local clients over a Unix domain socket
+
+#include "Log.hpp"
+#include "RenderDaemon.hpp"
+
+#include <csignal>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    const char* usage =
+        "Usage: mandelbrot_daemon [options]\n"
+        "  --socket PATH           socket to listen at ($XDG_RUNTIME_DIR/mandelbrot.sock or /tmp/mandelbrot-UID.sock)\n"
+        "  --backend cpu|metal     compute backend (default one of the build)\n"
+        "  --threads N             CPU backend threads (all cores)\n"
+        "Requests hold mandelbrot_batch options of plain images, see RenderClient and mandelbrot_load.\n";
+
+    RenderDaemon* running = nullptr;
+
+    void stopRunning(int) {
+        if (running != nullptr)
+            running->stop();
+    }
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        const std::vector<std::string> args(argv + 1, argv + argc);
+        std::string socketPath = RenderProtocol::defaultSocketPath();
+        BackendType backend = BackendType::Default;
+        unsigned threads = std::thread::hardware_concurrency();
+        for (size_t i = 0; i < args.size(); ++i) {
+            const bool hasValue = i + 1 < args.size();
+            if (args[i] == "--help" || args[i] == "-h") {
+                std::fputs(usage, stdout);
+                return 0;
+            } else if (args[i] == "--socket" && hasValue) {
+                socketPath = args[++i];
+            } else if (args[i] == "--backend" && hasValue) {
+                const std::string name = args[++i];
+                if (name == "cpu")
+                    backend = BackendType::Cpu;
+                else if (name == "metal")
+                    backend = BackendType::Metal;
+                else
+                    throw std::invalid_argument("Unknown backend " + name);
+            } else if (args[i] == "--threads" && hasValue) {
+                threads = static_cast<unsigned>(std::stoul(args[++i]));
+            } else {
+                throw std::invalid_argument("Unknown option " + args[i] + "\n" + usage);
+            }
+        }
+
+        RenderDaemon daemon(socketPath, backend, threads);
+        running = &daemon;
+        std::signal(SIGINT, stopRunning);
+        std::signal(SIGTERM, stopRunning);
+        Log::info("Render daemon on {} backend listens at {}", daemon.backendName(), socketPath);
+        daemon.serve();
+        running = nullptr;
+
+        const RenderDaemonStats stats = daemon.stats();
+        Log::info("{} requests, {} renders, {} coalesced, {} preemptions, {} cancelled, {} failed", stats.requests,
+                  stats.renders, stats.coalesced, stats.preemptions, stats.cancelled, stats.failed);
+    }
+    catch (const std::exception& e) {
+        Log::error("{}", e.what());
+        return 1;
+    }
+    return 0;
+}
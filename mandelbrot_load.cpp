@@ -0,0 +1,188 @@
+// Load generator of the render daemon: throughput and latency percentiles of a request mix
+
+#include "Log.hpp"
+#include "RenderClient.hpp"
+#include "RenderJob.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+    const char* usage =
+        "Usage: mandelbrot_load [options] [request options]\n"
+        "  --socket PATH           socket of the daemon ($XDG_RUNTIME_DIR/mandelbrot.sock or /tmp/mandelbrot-UID.sock)\n"
+        "  --connections N         clients sending requests at the same time (4)\n"
+        "  --requests N            requests in total (100)\n"
+        "  --depth N               requests in flight per client (1)\n"
+        "  --interactive F         fraction of interactive requests, the rest are batch ones (0.5)\n"
+        "  --jobs FILE             requests cycle through the lines of FILE, mandelbrot_batch options each\n"
+        "Other options make up the request when there is no job file, e.g. --size 640x360 --scale 0.01.\n";
+
+    using Clock = std::chrono::steady_clock;
+
+    struct Sample {
+        RenderPriority priority;
+        double latency; // seconds from sending to the last rows
+        bool coalesced;
+        size_t pixels;
+    };
+
+    double percentile(std::vector<double> values, double fraction) {
+        if (values.empty())
+            return 0.0;
+        std::sort(values.begin(), values.end());
+        const size_t rank = static_cast<size_t>(std::ceil(fraction * static_cast<double>(values.size())));
+        return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+    }
+
+    void report(const char* name, const std::vector<Sample>& samples, RenderPriority priority) {
+        std::vector<double> latencies;
+        for (const Sample& sample : samples) {
+            if (sample.priority == priority)
+                latencies.push_back(sample.latency * 1e3);
+        }
+        if (latencies.empty())
+            return;
+        Log::info("{}: {} requests, latency p50 {:.1f} ms, p90 {:.1f} ms, p99 {:.1f} ms, max {:.1f} ms", name,
+                  latencies.size(), percentile(latencies, 0.5), percentile(latencies, 0.9),
+                  percentile(latencies, 0.99), percentile(latencies, 1.0));
+    }
+
+    // Spreads the interactive ones evenly over the requests
+    RenderPriority priorityOf(size_t index, double interactive) {
+        const double before = std::floor(static_cast<double>(index) * interactive);
+        const double after = std::floor(static_cast<double>(index + 1) * interactive);
+        return after > before ? RenderPriority::Interactive : RenderPriority::Batch;
+    }
+    // Shared by the client threads
+    struct Load {
+        std::string socketPath;
+        std::vector<std::vector<std::string>> jobs;
+        size_t requests = 0;
+        size_t depth = 1;
+        double interactive = 0.0;
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> failed{0};
+        std::mutex samplesMutex;
+        std::vector<Sample> samples;
+    };
+
+    // Keeps `depth` requests in flight until all of them are sent, latency counts from sending to the last rows
+    void runClient(Load& load) {
+        try {
+            RenderClient client(load.socketPath);
+            struct Sent {
+                uint64_t id;
+                Clock::time_point time;
+                RenderPriority priority;
+            };
+            std::vector<Sent> sent;
+            auto fill = [&] {
+                while (client.inFlight() < load.depth) {
+                    const size_t index = load.next++;
+                    if (index >= load.requests)
+                        return;
+                    const RenderPriority priority = priorityOf(index, load.interactive);
+                    const Clock::time_point time = Clock::now();
+                    sent.push_back({client.send(load.jobs[index % load.jobs.size()], priority), time, priority});
+                }
+            };
+            for (fill(); client.inFlight() > 0; fill()) {
+                try {
+                    const RenderReply reply = client.receive();
+                    const auto found = std::find_if(sent.begin(), sent.end(),
+                                                    [&](const Sent& request) { return request.id == reply.id; });
+                    const Sample sample{found->priority, std::chrono::duration<double>(Clock::now() - found->time).count(),
+                                        reply.done.coalesced, static_cast<size_t>(reply.size[0]) * reply.size[1]};
+                    sent.erase(found);
+                    std::lock_guard lock(load.samplesMutex);
+                    load.samples.push_back(sample);
+                } catch (const RenderRequestError& e) {
+                    std::erase_if(sent, [&](const Sent& request) { return request.id == e.id(); });
+                    if (load.failed++ == 0)
+                        Log::error("Request failed: {}", e.what());
+                }
+            }
+        } catch (const std::exception& e) {
+            // The rest of the requests of a lost connection are never sent
+            ++load.failed;
+            Log::error("{}", e.what());
+        }
+    }
+} // namespace
+
+int main(int argc, char* argv[]) {
+    try {
+        const std::vector<std::string> args(argv + 1, argv + argc);
+        std::string socketPath = RenderProtocol::defaultSocketPath();
+        int connections = 4;
+        size_t requests = 100;
+        size_t depth = 1;
+        double interactive = 0.5;
+        std::string jobFile;
+        std::vector<std::string> options;
+        for (size_t i = 0; i < args.size(); ++i) {
+            const bool hasValue = i + 1 < args.size();
+            if (args[i] == "--help" || args[i] == "-h") {
+                std::fputs(usage, stdout);
+                return 0;
+            } else if (args[i] == "--socket" && hasValue) {
+                socketPath = args[++i];
+            } else if (args[i] == "--connections" && hasValue) {
+                connections = std::max(1, std::stoi(args[++i]));
+            } else if (args[i] == "--requests" && hasValue) {
+                requests = std::stoul(args[++i]);
+            } else if (args[i] == "--depth" && hasValue) {
+                depth = std::max<size_t>(1, std::stoul(args[++i]));
+            } else if (args[i] == "--interactive" && hasValue) {
+                interactive = std::clamp(std::stod(args[++i]), 0.0, 1.0);
+            } else if (args[i] == "--jobs" && hasValue) {
+                jobFile = args[++i];
+            } else {
+                options.push_back(args[i]);
+            }
+        }
+        const std::vector<std::vector<std::string>> jobs = jobFile.empty()
+            ? std::vector<std::vector<std::string>>{options}
+            : RenderJobs::readLines(jobFile);
+        if (jobs.empty())
+            throw std::invalid_argument("Job file " + jobFile + " has no jobs");
+
+        Load load;
+        load.socketPath = socketPath;
+        load.jobs = jobs;
+        load.requests = requests;
+        load.depth = depth;
+        load.interactive = interactive;
+        const auto start = Clock::now();
+        std::vector<std::jthread> clients;
+        for (int c = 0; c < connections; ++c)
+            clients.emplace_back([&load] { runClient(load); });
+        clients.clear();
+        const double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+        size_t pixels = 0;
+        size_t coalesced = 0;
+        for (const Sample& sample : load.samples) {
+            pixels += sample.pixels;
+            coalesced += sample.coalesced ? 1 : 0;
+        }
+        Log::info("{} requests on {} connections in {:.2f}s: {:.1f} requests/s, {:.1f} Mpx/s, {} coalesced, {} failed",
+                  load.samples.size(), connections, elapsed, static_cast<double>(load.samples.size()) / elapsed,
+                  static_cast<double>(pixels) / elapsed / 1e6, coalesced, load.failed.load());
+        report("Interactive", load.samples, RenderPriority::Interactive);
+        report("Batch", load.samples, RenderPriority::Batch);
+        return load.failed > 0 ? 1 : 0;
+    }
+    catch (const std::exception& e) {
+        Log::error("{}", e.what());
+        return 1;
+    }
+}